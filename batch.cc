@@ -0,0 +1,294 @@
+/*
+
+   nsjail - BATCH mode job queue
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+/*
+ * Jobs are started in the manifest's order, whenever fewer than batch_parallelism of them are
+ * running. Each one gets a copy of the prepared configuration with its own limits (see
+ * subproc::copyConf()), nothing is parsed or compiled per job. The jails are reaped by the main
+ * loop (see nsjail.cc) as in the other modes
+ */
+
+#include "batch.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/text_format.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config.pb.h"
+#include "events.h"
+#include "logs.h"
+#include "sandbox.h"
+#include "util.h"
+
+namespace batch {
+
+enum state_t {
+	JOB_QUEUED = 0,
+	JOB_RUNNING,
+	JOB_EXITED,
+	/* Its files couldn't be opened, or the jail couldn't be created */
+	JOB_FAILED,
+};
+
+struct job_t {
+	const nsjail::BatchJob* spec;
+	std::string name;
+	state_t state;
+	pid_t pid;
+	int status;
+	struct rusage ru;
+	uint64_t run_us;
+};
+
+/* The jobs keep pointers to its messages */
+static nsjail::BatchManifest manifest;
+static std::vector<job_t> jobs;
+/* The queue: jobs[nextJob...] are yet to be started */
+static size_t nextJob = 0;
+/* pid -> index in jobs */
+static std::map<pid_t, size_t> running;
+static size_t parallelism = 1;
+static uint64_t startUs = 0;
+
+bool init(nsjconf_t* nsjconf) {
+	if (nsjconf->batch_manifest.empty()) {
+		LOG_E("MODE_STANDALONE_BATCH needs a job manifest (batch_manifest)");
+		return false;
+	}
+	int fd = TEMP_FAILURE_RETRY(open(nsjconf->batch_manifest.c_str(), O_RDONLY | O_CLOEXEC));
+	if (fd == -1) {
+		PLOG_E("Couldn't open the job manifest '%s'", nsjconf->batch_manifest.c_str());
+		return false;
+	}
+	google::protobuf::io::FileInputStream input(fd);
+	input.SetCloseOnDelete(true);
+	if (!google::protobuf::TextFormat::Parser().Parse(&input, &manifest)) {
+		LOG_E("Couldn't parse the job manifest '%s'", nsjconf->batch_manifest.c_str());
+		return false;
+	}
+
+	for (int i = 0; i < manifest.job_size(); i++) {
+		const nsjail::BatchJob& spec = manifest.job(i);
+		job_t job = {};
+		job.spec = &spec;
+		job.name = spec.has_name() ? spec.name() : std::to_string(i);
+		job.state = JOB_QUEUED;
+		job.pid = -1;
+		if (spec.arg_size() == 0 && nsjconf->argv.empty()) {
+			LOG_E("Job '%s' has no command (arg), and there's no default one",
+			    job.name.c_str());
+			return false;
+		}
+		if (spec.has_seccomp_policy_name() && !spec.seccomp_policy_name().empty() &&
+		    !sandbox::hasPolicy(nsjconf, spec.seccomp_policy_name())) {
+			LOG_E("Job '%s' uses an undefined seccomp policy '%s'", job.name.c_str(),
+			    spec.seccomp_policy_name().c_str());
+			return false;
+		}
+		jobs.push_back(job);
+	}
+
+	parallelism = nsjconf->batch_parallelism;
+	if (parallelism == 0) {
+		parallelism = nsjconf->num_cpus > 0 ? nsjconf->num_cpus : 1;
+	}
+	startUs = events::nowUs();
+	LOG_I("Running %zu jobs from '%s', %zu at a time", jobs.size(),
+	    nsjconf->batch_manifest.c_str(), parallelism);
+	return true;
+}
+
+/* Empty path means /dev/null */
+static int openFile(const std::string& path, int flags) {
+	const char* fname = path.empty() ? "/dev/null" : path.c_str();
+	int fd = TEMP_FAILURE_RETRY(open(fname, flags | O_CLOEXEC, 0644));
+	if (fd == -1) {
+		PLOG_W("Couldn't open '%s'", fname);
+	}
+	return fd;
+}
+
+static pid_t startJob(nsjconf_t* nsjconf, const job_t& job) {
+	const nsjail::BatchJob& spec = *job.spec;
+
+	std::shared_ptr<nsjconf_t> jobconf = subproc::copyConf(nsjconf);
+	if (spec.has_time_limit()) {
+		jobconf->tlimit = spec.time_limit();
+	}
+	if (spec.has_rlimit_as()) {
+		jobconf->rl_as = spec.rlimit_as() * 1024UL * 1024UL;
+	}
+	if (spec.has_rlimit_cpu()) {
+		jobconf->rl_cpu = spec.rlimit_cpu();
+	}
+	if (spec.has_rlimit_fsize()) {
+		jobconf->rl_fsize = spec.rlimit_fsize() * 1024UL * 1024UL;
+	}
+	if (spec.has_rlimit_nofile()) {
+		jobconf->rl_nofile = spec.rlimit_nofile();
+	}
+	if (spec.has_cgroup_mem_max()) {
+		jobconf->cgroup_mem_max = spec.cgroup_mem_max();
+	}
+	if (spec.has_cgroup_pids_max()) {
+		jobconf->cgroup_pids_max = spec.cgroup_pids_max();
+	}
+
+	/* Listeners can already bring their own command and seccomp policy, see subproc.cc */
+	listener_t l = {job.name, "", 0, "", "", {}, spec.seccomp_policy_name(), -1};
+	if (spec.arg_size() > 0) {
+		l.exec_file = spec.arg(0);
+		l.argv.assign(spec.arg().begin(), spec.arg().end());
+	}
+
+	int fd_in = openFile(spec.stdin_file(), O_RDONLY);
+	int fd_out = openFile(spec.stdout_file(), O_WRONLY | O_CREAT | O_TRUNC);
+	int fd_err = -1;
+	if (spec.stderr_file() == spec.stdout_file()) {
+		fd_err = fd_out == -1 ? -1 : fcntl(fd_out, F_DUPFD_CLOEXEC, 0);
+	} else {
+		fd_err = openFile(spec.stderr_file(), O_WRONLY | O_CREAT | O_TRUNC);
+	}
+
+	pid_t pid = -1;
+	if (fd_in != -1 && fd_out != -1 && fd_err != -1) {
+		pid = subproc::runChildWithConf(nsjconf, jobconf, &l, fd_in, fd_out, fd_err);
+	}
+	for (int fd : {fd_in, fd_out, fd_err}) {
+		if (fd != -1) {
+			close(fd);
+		}
+	}
+	return pid;
+}
+
+void schedule(nsjconf_t* nsjconf) {
+	while (running.size() < parallelism && nextJob < jobs.size()) {
+		size_t idx = nextJob++;
+		job_t& job = jobs[idx];
+		job.pid = startJob(nsjconf, job);
+		if (job.pid == -1) {
+			LOG_W("Couldn't start job '%s'", job.name.c_str());
+			job.state = JOB_FAILED;
+			continue;
+		}
+		LOG_D("Started job '%s' as PID: %d", job.name.c_str(), (int)job.pid);
+		job.state = JOB_RUNNING;
+		running[job.pid] = idx;
+	}
+}
+
+void collect(const std::vector<subproc::reaped_t>& reaped) {
+	for (const auto& r : reaped) {
+		auto it = running.find(r.pid);
+		if (it == running.end()) {
+			continue;
+		}
+		job_t& job = jobs[it->second];
+		job.state = JOB_EXITED;
+		job.status = r.status;
+		job.ru = r.ru;
+		job.run_us = r.run_us;
+		running.erase(it);
+	}
+}
+
+bool done(void) {
+	return nextJob == jobs.size() && running.empty();
+}
+
+static bool succeeded(const job_t& job) {
+	return job.state == JOB_EXITED && WIFEXITED(job.status) && WEXITSTATUS(job.status) == 0;
+}
+
+static std::string jobToJson(const job_t& job) {
+	static const char* const stateNames[] = {"queued", "running", "exited", "failed"};
+	std::string res = "{\"name\":" + util::jsonStr(job.name);
+	res += ",\"state\":\"" + std::string(stateNames[job.state]) + "\"";
+	if (job.pid != -1) {
+		res += ",\"pid\":" + std::to_string(job.pid);
+	}
+	if (job.state != JOB_EXITED) {
+		return res + "}";
+	}
+	if (WIFEXITED(job.status)) {
+		res += ",\"exit_status\":" + std::to_string(WEXITSTATUS(job.status));
+	} else if (WIFSIGNALED(job.status)) {
+		res += ",\"signal\":" + std::to_string(WTERMSIG(job.status));
+		res += ",\"signal_name\":" + util::jsonStr(util::sigName(WTERMSIG(job.status)));
+	}
+	res += ",\"run_us\":" + std::to_string(job.run_us);
+	res += ",\"utime_us\":" +
+	       std::to_string(job.ru.ru_utime.tv_sec * 1000000LL + job.ru.ru_utime.tv_usec);
+	res += ",\"stime_us\":" +
+	       std::to_string(job.ru.ru_stime.tv_sec * 1000000LL + job.ru.ru_stime.tv_usec);
+	res += ",\"maxrss_kb\":" + std::to_string(job.ru.ru_maxrss);
+	return res + "}";
+}
+
+int finish(nsjconf_t* nsjconf) {
+	size_t ok = 0;
+	for (const auto& job : jobs) {
+		if (succeeded(job)) {
+			ok++;
+		}
+	}
+	uint64_t wall_us = events::nowUs() - startUs;
+	LOG_I("Batch finished: %zu jobs, %zu succeeded, %zu failed, in %" PRIu64 " ms",
+	    jobs.size(), ok, jobs.size() - ok, wall_us / 1000);
+
+	if (!nsjconf->batch_results.empty()) {
+		/* One job per line, in the manifest's order */
+		std::string res = "{\"jobs\":" + std::to_string(jobs.size());
+		res += ",\"succeeded\":" + std::to_string(ok);
+		res += ",\"failed\":" + std::to_string(jobs.size() - ok);
+		res += ",\"wall_us\":" + std::to_string(wall_us);
+		res += ",\"parallelism\":" + std::to_string(parallelism);
+		res += ",\"results\":[";
+		for (size_t i = 0; i < jobs.size(); i++) {
+			res += (i == 0) ? "\n" : ",\n";
+			res += jobToJson(jobs[i]);
+		}
+		res += "\n]}\n";
+
+		const std::string tmp = nsjconf->batch_results + ".tmp";
+		if (!util::writeBufToFile(tmp.c_str(), res.data(), res.size(),
+			O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC) ||
+		    rename(tmp.c_str(), nsjconf->batch_results.c_str()) == -1) {
+			PLOG_E("Couldn't write the batch results to '%s'",
+			    nsjconf->batch_results.c_str());
+			unlink(tmp.c_str());
+			return 1;
+		}
+	}
+	return ok == jobs.size() ? 0 : 1;
+}
+
+}  // namespace batch
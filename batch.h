@@ -0,0 +1,47 @@
+/*
+
+   nsjail - BATCH mode job queue
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#ifndef NS_BATCH_H
+#define NS_BATCH_H
+
+#include <stdbool.h>
+
+#include <vector>
+
+#include "nsjail.h"
+#include "subproc.h"
+
+namespace batch {
+
+/* Reads the job manifest (batch_manifest) */
+bool init(nsjconf_t* nsjconf);
+/* Starts queued jobs until batch_parallelism of them are running */
+void schedule(nsjconf_t* nsjconf);
+/* Records the exit status of the jobs among the jails collected by subproc::reapProc() */
+void collect(const std::vector<subproc::reaped_t>& reaped);
+/* All jobs have finished, or couldn't be started */
+bool done(void);
+/* Writes batch_results. Returns 0 if all jobs exited with 0, 1 otherwise */
+int finish(nsjconf_t* nsjconf);
+
+}  // namespace batch
+
+#endif /* NS_BATCH_H */
@@ -149,6 +149,14 @@ static bool getEffective(cap_user_data_t cap_data, unsigned int cap) {
 	return cap_data[off_byte].effective & mask;
 }
 
+bool haveEffective(unsigned int cap) {
+	cap_user_data_t cap_data = getCaps();
+	if (cap_data == NULL) {
+		return false;
+	}
+	return getEffective(cap_data, cap);
+}
+
 static bool getInheritable(cap_user_data_t cap_data, unsigned int cap) {
 	size_t off_byte = CAP_TO_INDEX(cap);
 	unsigned mask = CAP_TO_MASK(cap);
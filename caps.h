@@ -31,6 +31,8 @@ namespace caps {
 
 int nameToVal(const char* name);
 bool initNs(nsjconf_t* nsjconf);
+/* Is 'cap' in the effective set of the calling thread */
+bool haveEffective(unsigned int cap);
 
 }  // namespace caps
 
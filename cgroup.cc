@@ -26,10 +26,13 @@
 #include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <string>
+
 #include "logs.h"
 #include "util.h"
 
@@ -215,6 +218,23 @@ bool initNsFromParent(nsjconf_t* nsjconf, pid_t pid) {
 	return true;
 }
 
+/* Must be called before finishFromParent(). The 'oom_kill' counter needs Linux 4.13 */
+bool oomKilled(nsjconf_t* nsjconf, pid_t pid) {
+	if (nsjconf->cgroup_mem_max == (size_t)0) {
+		return false;
+	}
+	const std::string fname = nsjconf->cgroup_mem_mount + "/" + nsjconf->cgroup_mem_parent +
+				  "/NSJAIL." + std::to_string(pid) + "/memory.oom_control";
+	char buf[1024];
+	ssize_t sz = util::readFromFile(fname.c_str(), buf, sizeof(buf) - 1);
+	if (sz <= 0) {
+		return false;
+	}
+	buf[sz] = '\0';
+	const char* kill_cnt = strstr(buf, "oom_kill ");
+	return kill_cnt != NULL && strtoull(kill_cnt + strlen("oom_kill "), NULL, 10) > 0;
+}
+
 void finishFromParentMem(nsjconf_t* nsjconf, pid_t pid) {
 	if (nsjconf->cgroup_mem_max == (size_t)0) {
 		return;
@@ -71,7 +71,8 @@ struct custom_option custom_opts[] = {
         "\tl: Wait for connections on a TCP port (specified with --port) [MODE_LISTEN_TCP]\n"
         "\to: Launch a single process on the console using clone/execve [MODE_STANDALONE_ONCE]\n"
         "\te: Launch a single process on the console using execve [MODE_STANDALONE_EXECVE]\n"
-        "\tr: Launch a single process on the console with clone/execve, keep doing it forever [MODE_STANDALONE_RERUN]" },
+        "\tr: Launch a single process on the console with clone/execve, keep doing it forever [MODE_STANDALONE_RERUN]\n"
+        "\tb: Run the jobs from --batch_manifest with clone/execve, several at a time [MODE_STANDALONE_BATCH]" },
     { { "config", required_argument, NULL, 'C' }, "Configuration file in the config.proto ProtoBuf format (see configs/ directory for examples)" },
     { { "exec_file", required_argument, NULL, 'x' }, "File to exec (default: argv[0])" },
     { { "execute_fd", no_argument, NULL, 0x0607 }, "Use execveat() to execute a file-descriptor instead of executing the binary path. In such case argv[0]/exec_file denotes a file path before mount namespacing" },
@@ -83,9 +84,15 @@ struct custom_option custom_opts[] = {
     { { "cwd", required_argument, NULL, 'D' }, "Directory in the namespace the process will run (default: '/')" },
     { { "port", required_argument, NULL, 'p' }, "TCP port to bind to (enables MODE_LISTEN_TCP) (default: 0)" },
     { { "bindhost", required_argument, NULL, 0x604 }, "IP address to bind the port to (only in [MODE_LISTEN_TCP]), (default: '::')" },
+    { { "listen", required_argument, NULL, 0x711 }, "Listen on '[host:]port' or 'unix:/path' too (enables MODE_LISTEN_TCP). Can be specified multiple times. Sockets passed with LISTEN_FDS/LISTEN_PID (systemd) are used as well" },
+    { { "control_socket", required_argument, NULL, 0x050E }, "Launch, query, kill and wait for jails with the ControlRequest messages from config.proto, sent to this unix socket (SOCK_SEQPACKET, mode 0600). Stdio fds of the jails are passed as SCM_RIGHTS (enables MODE_LISTEN_TCP) (default: none)" },
     { { "max_conns_per_ip", required_argument, NULL, 'i' }, "Maximum number of connections per one IP (only in [MODE_LISTEN_TCP]), (default: 0 (unlimited))" },
     { { "log", required_argument, NULL, 'l' }, "Log file (default: use log_fd)" },
     { { "log_fd", required_argument, NULL, 'L' }, "Log FD (default: 2)" },
+    { { "event_stream", required_argument, NULL, 0x050A }, "Send jail lifecycle events (spawn, exec, exit, time_limit, seccomp_violation, oom) as JSON lines to 'fd:N' or 'unix:/path'. Slow consumers lose events instead of stalling nsjail (default: none)" },
+    { { "batch_manifest", required_argument, NULL, 0x050B }, "Jobs to run in MODE_STANDALONE_BATCH: a file with the BatchManifest message from config.proto in the ProtoBuf text format (argv, stdio files and limits of each job)" },
+    { { "batch_parallelism", required_argument, NULL, 0x050C }, "How many jobs run at a time in MODE_STANDALONE_BATCH (default: 0 - the number of online CPUs)" },
+    { { "batch_results", required_argument, NULL, 0x050D }, "Write the exit status and resource usage of all jobs of MODE_STANDALONE_BATCH to this file as JSON (default: none)" },
     { { "time_limit", required_argument, NULL, 't' }, "Maximum time that a jail can exist, in seconds (default: 600)" },
     { { "max_cpus", required_argument, NULL, 0x508 }, "Maximum number of CPUs a single jailed process can use (default: 0 'no limit')" },
     { { "daemon", no_argument, NULL, 'd' }, "Daemonize after start" },
@@ -119,6 +126,10 @@ struct custom_option custom_opts[] = {
     { { "disable_clone_newipc", no_argument, NULL, 0x0405 }, "Don't use CLONE_NEWIPC" },
     { { "disable_clone_newuts", no_argument, NULL, 0x0406 }, "Don't use CLONE_NEWUTS" },
     { { "disable_clone_newcgroup", no_argument, NULL, 0x0407 }, "Don't use CLONE_NEWCGROUP. Might be required for kernel versions < 4.6" },
+    { { "pool_newnet", no_argument, NULL, 0x0409 }, "Take net namespaces from a pool of pre-created ones, instead of creating a new one for every jail. Requires euid==0" },
+    { { "pool_newipc", no_argument, NULL, 0x040a }, "Take ipc namespaces from a pool of pre-created ones, instead of creating a new one for every jail. Requires euid==0" },
+    { { "pool_newuts", no_argument, NULL, 0x040b }, "Take uts namespaces from a pool of pre-created ones, instead of creating a new one for every jail. Requires euid==0" },
+    { { "ns_pool_size", required_argument, NULL, 0x040c }, "Number of namespaces of each pooled type to pre-create (default: 4)" },
     { { "uid_mapping", required_argument, NULL, 'U' }, "Add a custom uid mapping of the form inside_uid:outside_uid:count. Setting this requires newuidmap (set-uid) to be present" },
     { { "gid_mapping", required_argument, NULL, 'G' }, "Add a custom gid mapping of the form inside_gid:outside_gid:count. Setting this requires newgidmap (set-uid) to be present" },
     { { "bindmount_ro", required_argument, NULL, 'R' }, "List of mountpoints to be mounted --bind (ro) inside the container. Can be specified multiple times. Supports 'source' syntax, or 'source:dest'" },
@@ -131,6 +142,10 @@ struct custom_option custom_opts[] = {
     { { "proc_rw", no_argument, NULL, 0x0606 }, "Is procfs mounted as R/W (default: R/O)" },
     { { "seccomp_policy", required_argument, NULL, 'P' }, "Path to file containing seccomp-bpf policy (see kafel/)" },
     { { "seccomp_string", required_argument, NULL, 0x0901 }, "String with kafel seccomp-bpf policy (see kafel/)" },
+    { { "seccomp_cache_dir", required_argument, NULL, 0x0902 }, "Directory with compiled seccomp-bpf policies, reused across runs. Must be writable by trusted users only (default: none)" },
+    { { "seccomp_hot_syscall", required_argument, NULL, 0x0903 }, "Number of a frequently used syscall, checked first by the seccomp-bpf policy. Can be specified multiple times" },
+    { { "seccomp_notify", required_argument, NULL, 0x0904 }, "Syscall handled by nsjail instead of the seccomp-bpf policy (SECCOMP_RET_USER_NOTIF): 'nr[:log|allow|deny[:argN=value]]'. 'allow' with an argument check fails other calls with EPERM. Can be specified multiple times (default action: log)" },
+    { { "seccomp_profile", required_argument, NULL, 0x0905 }, "Pass every syscall of the jails to nsjail (SECCOMP_RET_USER_NOTIF) and write a Kafel policy allowing the ones seen, most frequent first, to this file when jails exit. Slows the jails down considerably. Can't be combined with a seccomp-bpf policy (default: none)" },
     { { "cgroup_mem_max", required_argument, NULL, 0x0801 }, "Maximum number of bytes to use in the group (default: '0' - disabled)" },
     { { "cgroup_mem_mount", required_argument, NULL, 0x0802 }, "Location of memory cgroup FS (default: '/sys/fs/cgroup/memory')" },
     { { "cgroup_mem_parent", required_argument, NULL, 0x0803 }, "Which pre-existing memory cgroup to use as a parent (default: 'NSJAIL')" },
@@ -144,10 +159,23 @@ struct custom_option custom_opts[] = {
     { { "cgroup_cpu_mount", required_argument, NULL, 0x0822 }, "Location of cpu cgroup FS (default: '/sys/fs/cgroup/net_cls')" },
     { { "cgroup_cpu_parent", required_argument, NULL, 0x0833 }, "Which pre-existing cpu cgroup to use as a parent (default: 'NSJAIL')" },
     { { "iface_no_lo", no_argument, NULL, 0x700 }, "Don't bring the 'lo' interface up" },
+    { { "net_none", no_argument, NULL, 0x704 }, "All jails share one empty net namespace ('lo' is down) instead of creating one per jail. Jails can reach each other's abstract AF_UNIX sockets. Requires euid==0" },
     { { "macvlan_iface", required_argument, NULL, 'I' }, "Interface which will be cloned (MACVLAN) and put inside the subprocess' namespace as 'vs'" },
     { { "macvlan_vs_ip", required_argument, NULL, 0x701 }, "IP of the 'vs' interface (e.g. \"192.168.0.1\")" },
     { { "macvlan_vs_nm", required_argument, NULL, 0x702 }, "Netmask of the 'vs' interface (e.g. \"255.255.255.0\")" },
     { { "macvlan_vs_gw", required_argument, NULL, 0x703 }, "Default GW for the 'vs' interface (e.g. \"192.168.0.1\")" },
+    { { "macvlan_vs_ip6", required_argument, NULL, 0x705 }, "IPv6 address of the 'vs' interface (e.g. \"2001:db8::2\")" },
+    { { "macvlan_vs_prefix6", required_argument, NULL, 0x706 }, "IPv6 prefix length of the 'vs' interface (default: 64)" },
+    { { "macvlan_vs_gw6", required_argument, NULL, 0x707 }, "Default IPv6 GW for the 'vs' interface (e.g. \"2001:db8::1\")" },
+    { { "macvlan_pool_size", required_argument, NULL, 0x708 }, "Pre-create this many MACVLAN interfaces, with consecutive addresses starting at macvlan_vs_ip/macvlan_vs_ip6, and move them into jails on demand. Limits the number of concurrent jails. Requires euid==0 (default: 0 - disabled)" },
+    { { "veth_bridge", required_argument, NULL, 0x709 }, "Give each jail a veth pair ('vs' inside), with the host end attached to this bridge. Requires euid==0" },
+    { { "veth_cidr", required_argument, NULL, 0x70a }, "Addresses for the veth interfaces are leased from this range (default: '10.64.0.0/16')" },
+    { { "veth_gw", required_argument, NULL, 0x70b }, "Default GW for the veth interfaces, e.g. the bridge's address (default: none)" },
+    { { "net_egress_rate", required_argument, NULL, 0x70c }, "Limit traffic sent by the jail's 'vs' interface to this many bytes per second (tbf qdisc) (default: 0 - no limit)" },
+    { { "net_egress_burst", required_argument, NULL, 0x70d }, "Burst size in bytes for net_egress_rate (default: 0 - max(rate/50, 16384))" },
+    { { "net_ingress_rate", required_argument, NULL, 0x70e }, "Limit traffic received by the jail to this many bytes per second. Requires veth_bridge (default: 0 - no limit)" },
+    { { "net_ingress_burst", required_argument, NULL, 0x70f }, "Burst size in bytes for net_ingress_rate (default: 0 - max(rate/50, 16384))" },
+    { { "port_forward", required_argument, NULL, 0x710 }, "Forward TCP connections to a host port (bound to --bindhost) to 127.0.0.1 inside the jail: 'host_port:jail_port'. Can be specified multiple times. Supported in MODE_STANDALONE_ONCE/RERUN only, and needs CAP_SYS_ADMIN (e.g. running as root)" },
 };
 
 struct custom_option deprecated_opts[] = {
@@ -203,6 +231,9 @@ static void cmdlineUsage(const char* pname) {
 	LOG_HELP_BOLD("  nsjail -Mo --chroot / -- /bin/echo \"ABC\"");
 	LOG_HELP(" Execute echo command directly, without a supervising process");
 	LOG_HELP_BOLD("  nsjail -Me --chroot / --disable_proc -- /bin/echo \"ABC\"");
+	LOG_HELP(" Run the jobs listed in jobs.txt, 8 at a time");
+	LOG_HELP_BOLD("  nsjail -Mb --chroot / --batch_manifest jobs.txt --batch_parallelism 8 "
+		      "--batch_results results.json");
 }
 
 void logParams(nsjconf_t* nsjconf) {
@@ -219,6 +250,9 @@ void logParams(nsjconf_t* nsjconf) {
 	case MODE_STANDALONE_RERUN:
 		LOG_I("Mode: STANDALONE_RERUN");
 		break;
+	case MODE_STANDALONE_BATCH:
+		LOG_I("Mode: STANDALONE_BATCH");
+		break;
 	default:
 		LOG_F("Mode: UNKNOWN");
 		break;
@@ -230,7 +264,9 @@ void logParams(nsjconf_t* nsjconf) {
 	    "clone_newuser:%s, clone_newns:%s, clone_newpid:%s, clone_newipc:%s, clonew_newuts:%s, "
 	    "clone_newcgroup:%s, keep_caps:%s, disable_no_new_privs:%s, max_cpus:%zu",
 	    nsjconf->hostname.c_str(), nsjconf->chroot.c_str(),
-	    nsjconf->exec_file.empty() ? nsjconf->argv[0].c_str() : nsjconf->exec_file.c_str(),
+	    /* Batch jobs and control_socket launches can bring their own commands */
+	    nsjconf->exec_file.empty() && !nsjconf->argv.empty() ? nsjconf->argv[0].c_str()
+								   : nsjconf->exec_file.c_str(),
 	    nsjconf->bindhost.c_str(), nsjconf->port, nsjconf->max_conns_per_ip, nsjconf->tlimit,
 	    nsjconf->personality, logYesNo(nsjconf->daemonize), logYesNo(nsjconf->clone_newnet),
 	    logYesNo(nsjconf->clone_newuser), logYesNo(nsjconf->clone_newns),
@@ -301,16 +337,90 @@ static std::string argFromVec(const std::vector<std::string>& vec, size_t pos) {
 	return vec[pos];
 }
 
+/* 'unix:/path', 'port', 'host:port' or '[ipv6]:port' */
+static bool parseListen(nsjconf_t* nsjconf, const std::string& spec) {
+	listener_t l = {"", "", 0, "", "", {}, "", -1};
+	if (spec.compare(0, 5, "unix:") == 0) {
+		l.unix_path = spec.substr(5);
+		nsjconf->listeners.push_back(l);
+		return true;
+	}
+	std::string port = spec;
+	size_t pos = spec.rfind(':');
+	if (pos != std::string::npos) {
+		l.bindhost = spec.substr(0, pos);
+		if (l.bindhost.size() > 1 && l.bindhost.front() == '[' &&
+		    l.bindhost.back() == ']') {
+			l.bindhost = l.bindhost.substr(1, l.bindhost.size() - 2);
+		}
+		port = spec.substr(pos + 1);
+	}
+	l.port = strtol(port.c_str(), NULL, 0);
+	if (!util::isANumber(port.c_str()) || l.port < 1 || l.port > 65535) {
+		LOG_E("Invalid listener '%s', expected '[host:]port' or 'unix:/path'",
+		    spec.c_str());
+		return false;
+	}
+	nsjconf->listeners.push_back(l);
+	return true;
+}
+
+/* 'nr[:log|allow|deny[:argN=value]]' */
+static bool parseSeccompNotify(nsjconf_t* nsjconf, const std::string& spec) {
+	notify_t n = {0, NOTIFY_LOG, -1, 0, EPERM};
+	std::string nr = spec, action, arg;
+	size_t pos = spec.find(':');
+	if (pos != std::string::npos) {
+		nr = spec.substr(0, pos);
+		action = spec.substr(pos + 1);
+		pos = action.find(':');
+		if (pos != std::string::npos) {
+			arg = action.substr(pos + 1);
+			action = action.substr(0, pos);
+		}
+	}
+	if (nr.empty() || !util::isANumber(nr.c_str())) {
+		LOG_E("Invalid syscall number in '%s'", spec.c_str());
+		return false;
+	}
+	n.nr = strtoul(nr.c_str(), NULL, 0);
+	if (action.empty() || action == "log") {
+		n.action = NOTIFY_LOG;
+	} else if (action == "allow") {
+		n.action = NOTIFY_ALLOW;
+	} else if (action == "deny") {
+		n.action = NOTIFY_DENY;
+	} else {
+		LOG_E("Unknown action '%s' in '%s'", action.c_str(), spec.c_str());
+		return false;
+	}
+	if (!arg.empty()) {
+		pos = arg.find('=');
+		if (arg.compare(0, 3, "arg") != 0 || arg.size() < 6 || arg[3] < '0' ||
+		    arg[3] > '5' || pos != 4 || !util::isANumber(arg.substr(5).c_str())) {
+			LOG_E("Invalid argument check '%s', expected 'argN=value' with N in 0-5",
+			    arg.c_str());
+			return false;
+		}
+		n.arg_index = arg[3] - '0';
+		n.arg_value = strtoull(arg.substr(5).c_str(), NULL, 0);
+	}
+	nsjconf->seccomp_notify.push_back(n);
+	return true;
+}
+
 static bool setupArgv(nsjconf_t* nsjconf, int argc, char** argv, int optind) {
 	for (int i = optind; i < argc; i++) {
 		nsjconf->argv.push_back(argv[i]);
 	}
-	if (nsjconf->argv.empty()) {
+	/* Batch jobs and control_socket launches can bring their own commands */
+	if (nsjconf->argv.empty() && nsjconf->mode != MODE_STANDALONE_BATCH &&
+	    nsjconf->control_socket.empty()) {
 		cmdlineUsage(argv[0]);
 		LOG_E("No command provided");
 		return false;
 	}
-	if (nsjconf->exec_file.empty()) {
+	if (nsjconf->exec_file.empty() && !nsjconf->argv.empty()) {
 		nsjconf->exec_file = nsjconf->argv[0];
 	}
 
@@ -330,8 +440,7 @@ static bool setupArgv(nsjconf_t* nsjconf, int argc, char** argv, int optind) {
 	return true;
 }
 
-static bool setupMounts(nsjconf_t* nsjconf, const std::vector<std::string>& tmpfs_mounts,
-    const std::string& tmpfs_size) {
+static bool setupMounts(nsjconf_t* nsjconf, const std::vector<std::string>& tmpfs_mounts) {
 	if (!(nsjconf->chroot.empty())) {
 		if (!mnt::addMountPtHead(nsjconf, nsjconf->chroot, "/", /* fs_type= */ "",
 			/* options= */ "",
@@ -360,9 +469,10 @@ static bool setupMounts(nsjconf_t* nsjconf, const std::vector<std::string>& tmpf
 		}
 	}
 
+	const std::string tmpfs_opts = mnt::tmpfsOptions(nsjconf->tmpfs_mount);
 	for (const auto& s : tmpfs_mounts) {
 		if (!mnt::addMountPtTail(nsjconf, /* src= */ "", /* dst= */ s, "tmpfs",
-			/* options= */ tmpfs_size, /* flags= */ 0,
+			/* options= */ tmpfs_opts, /* flags= */ 0,
 			/* is_dir= */ mnt::NS_DIR_YES, /* is_mandatory= */ true,
 			/* src_env= */ "", /* dst_env= */ "", /* src_content= */ "",
 			/* is_symlink= */ false)) {
@@ -422,7 +532,12 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 	nsjconf->clone_newipc = true;
 	nsjconf->clone_newuts = true;
 	nsjconf->clone_newcgroup = true;
+	nsjconf->pool_newnet = false;
+	nsjconf->pool_newipc = false;
+	nsjconf->pool_newuts = false;
+	nsjconf->ns_pool_size = 4;
 	nsjconf->mode = MODE_STANDALONE_ONCE;
+	nsjconf->batch_parallelism = 0;
 	nsjconf->is_root_rw = false;
 	nsjconf->is_silent = false;
 	nsjconf->skip_setsid = false;
@@ -442,19 +557,35 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 	nsjconf->cgroup_cpu_parent = "NSJAIL";
 	nsjconf->cgroup_cpu_ms_per_sec = 0U;
 	nsjconf->iface_lo = true;
+	nsjconf->net_none = false;
 	nsjconf->iface_vs_ip = "0.0.0.0";
 	nsjconf->iface_vs_nm = "255.255.255.0";
 	nsjconf->iface_vs_gw = "0.0.0.0";
+	nsjconf->iface_vs_prefix6 = 64;
+	nsjconf->macvlan_pool_size = 0;
+	nsjconf->veth_cidr = "10.64.0.0/16";
+	nsjconf->net_egress_rate = 0;
+	nsjconf->net_egress_burst = 0;
+	nsjconf->net_ingress_rate = 0;
+	nsjconf->net_ingress_burst = 0;
 	nsjconf->orig_uid = getuid();
 	nsjconf->num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
 	nsjconf->seccomp_fprog.filter = NULL;
 	nsjconf->seccomp_fprog.len = 0;
+	nsjconf->seccomp_fprog_post.filter = NULL;
+	nsjconf->seccomp_fprog_post.len = 0;
+	nsjconf->tmpfs_root.size = 16777216;
+	nsjconf->tmpfs_root.nr_inodes = 0;
+	nsjconf->tmpfs_scratch.size = 16777216;
+	nsjconf->tmpfs_scratch.nr_inodes = 0;
+	nsjconf->tmpfs_mount.size = 4194304;
+	nsjconf->tmpfs_mount.nr_inodes = 0;
+	nsjconf->skip_unused_scratch_tmpfs = false;
 
 	nsjconf->openfds.push_back(STDIN_FILENO);
 	nsjconf->openfds.push_back(STDOUT_FILENO);
 	nsjconf->openfds.push_back(STDERR_FILENO);
 
-	std::string tmpfs_size = "size=4194304";
 	std::vector<std::string> tmpfs_mounts;
 
 	// Generate options array for getopt_long.
@@ -489,7 +620,8 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 			break;
 		case 'C':
 			if (!config::parseFile(nsjconf.get(), optarg)) {
-				LOG_F("Couldn't parse configuration from '%s' file", optarg);
+				LOG_E("Couldn't parse configuration from '%s' file", optarg);
+				return nullptr;
 			}
 			break;
 		case 'c':
@@ -502,6 +634,12 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 		case 0x604:
 			nsjconf->bindhost = optarg;
 			break;
+		case 0x711:
+			if (!parseListen(nsjconf.get(), optarg)) {
+				return nullptr;
+			}
+			nsjconf->mode = MODE_LISTEN_TCP;
+			break;
 		case 'i':
 			nsjconf->max_conns_per_ip = strtoul(optarg, NULL, 0);
 			break;
@@ -511,6 +649,22 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 		case 'L':
 			nsjconf->logfile = "/dev/fd/" + std::to_string(strtol(optarg, NULL, 10));
 			break;
+		case 0x050A:
+			nsjconf->event_stream = optarg;
+			break;
+		case 0x050B:
+			nsjconf->batch_manifest = optarg;
+			break;
+		case 0x050C:
+			nsjconf->batch_parallelism = strtoul(optarg, NULL, 0);
+			break;
+		case 0x050D:
+			nsjconf->batch_results = optarg;
+			break;
+		case 0x050E:
+			nsjconf->control_socket = optarg;
+			nsjconf->mode = MODE_LISTEN_TCP;
+			break;
 		case 'd':
 			nsjconf->daemonize = true;
 			break;
@@ -596,6 +750,18 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 		case 0x0408:
 			nsjconf->clone_newcgroup = true;
 			break;
+		case 0x0409:
+			nsjconf->pool_newnet = true;
+			break;
+		case 0x040a:
+			nsjconf->pool_newipc = true;
+			break;
+		case 0x040b:
+			nsjconf->pool_newuts = true;
+			break;
+		case 0x040c:
+			nsjconf->ns_pool_size = (size_t)strtoull(optarg, NULL, 0);
+			break;
 		case 0x0501:
 			nsjconf->keep_caps = true;
 			break;
@@ -625,8 +791,7 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 			nsjconf->is_root_rw = true;
 			break;
 		case 0x0602:
-			tmpfs_size = "size=";
-			tmpfs_size.append(std::to_string(strtoull(optarg, NULL, 0)));
+			nsjconf->tmpfs_mount.size = strtoull(optarg, NULL, 0);
 			break;
 		case 0x0603:
 			nsjconf->proc_path.clear();
@@ -751,11 +916,15 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 			case 'r':
 				nsjconf->mode = MODE_STANDALONE_RERUN;
 				break;
+			case 'b':
+				nsjconf->mode = MODE_STANDALONE_BATCH;
+				break;
 			default:
 				LOG_E("Modes supported: -M l - MODE_LISTEN_TCP (default)");
 				LOG_E("                 -M o - MODE_STANDALONE_ONCE");
 				LOG_E("                 -M r - MODE_STANDALONE_RERUN");
 				LOG_E("                 -M e - MODE_STANDALONE_EXECVE");
+				LOG_E("                 -M b - MODE_STANDALONE_BATCH");
 				cmdlineUsage(argv[0]);
 				return nullptr;
 				break;
@@ -764,6 +933,9 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 		case 0x700:
 			nsjconf->iface_lo = false;
 			break;
+		case 0x704:
+			nsjconf->net_none = true;
+			break;
 		case 'I':
 			nsjconf->iface_vs = optarg;
 			break;
@@ -776,6 +948,42 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 		case 0x703:
 			nsjconf->iface_vs_gw = optarg;
 			break;
+		case 0x705:
+			nsjconf->iface_vs_ip6 = optarg;
+			break;
+		case 0x706:
+			nsjconf->iface_vs_prefix6 = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 0x707:
+			nsjconf->iface_vs_gw6 = optarg;
+			break;
+		case 0x708:
+			nsjconf->macvlan_pool_size = (size_t)strtoull(optarg, NULL, 0);
+			break;
+		case 0x709:
+			nsjconf->veth_bridge = optarg;
+			break;
+		case 0x70a:
+			nsjconf->veth_cidr = optarg;
+			break;
+		case 0x70b:
+			nsjconf->veth_gw = optarg;
+			break;
+		case 0x70c:
+			nsjconf->net_egress_rate = strtoull(optarg, NULL, 0);
+			break;
+		case 0x70d:
+			nsjconf->net_egress_burst = strtoull(optarg, NULL, 0);
+			break;
+		case 0x70e:
+			nsjconf->net_ingress_rate = strtoull(optarg, NULL, 0);
+			break;
+		case 0x70f:
+			nsjconf->net_ingress_burst = strtoull(optarg, NULL, 0);
+			break;
+		case 0x710:
+			nsjconf->port_forwards.push_back(optarg);
+			break;
 		case 0x801:
 			nsjconf->cgroup_mem_max = (size_t)strtoull(optarg, NULL, 0);
 			break;
@@ -818,6 +1026,20 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 		case 0x901:
 			nsjconf->kafel_string = optarg;
 			break;
+		case 0x902:
+			nsjconf->seccomp_cache_dir = optarg;
+			break;
+		case 0x903:
+			nsjconf->seccomp_hot_syscalls.push_back(strtoul(optarg, NULL, 0));
+			break;
+		case 0x904:
+			if (!parseSeccompNotify(nsjconf.get(), optarg)) {
+				return nullptr;
+			}
+			break;
+		case 0x905:
+			nsjconf->seccomp_profile_file = optarg;
+			break;
 		default:
 			cmdlineUsage(argv[0]);
 			return nullptr;
@@ -831,9 +1053,28 @@ std::unique_ptr<nsjconf_t> parseArgs(int argc, char* argv[]) {
 	if (!logs::initLog(nsjconf->logfile, nsjconf->loglevel)) {
 		return nullptr;
 	}
-	if (!setupMounts(nsjconf.get(), tmpfs_mounts, tmpfs_size)) {
+	if (!setupMounts(nsjconf.get(), tmpfs_mounts)) {
 		return nullptr;
 	}
+	for (const auto& p : nsjconf->mountpts) {
+		if (!p.is_idmapped) {
+			continue;
+		}
+		if (nsjconf->mode == MODE_STANDALONE_EXECVE) {
+			LOG_E("ID-mapped mounts are not supported in the MODE_STANDALONE_EXECVE "
+			      "mode");
+			return nullptr;
+		}
+		if (!nsjconf->clone_newuser || !nsjconf->clone_newns) {
+			LOG_E("ID-mapped mounts require both CLONE_NEWUSER and CLONE_NEWNS");
+			return nullptr;
+		}
+		/* open_tree(OPEN_TREE_CLONE) and mount_setattr() work on the host's mounts */
+		if (geteuid() != 0) {
+			LOG_E("ID-mapped mounts require root privileges");
+			return nullptr;
+		}
+	}
 	if (!setupArgv(nsjconf.get(), argc, argv, optind)) {
 		return nullptr;
 	}
@@ -63,6 +63,20 @@ static uint64_t configRLimit(
 	abort();
 }
 
+static bool configTmpfs(tmpfs_t* tmpfs, const nsjail::TmpfsOpts& opts) {
+	if (opts.has_size()) {
+		tmpfs->size = opts.size();
+	}
+	tmpfs->nr_inodes = opts.nr_inodes();
+	if (!opts.huge().empty() && opts.huge() != "never" && opts.huge() != "always" &&
+	    opts.huge() != "within_size" && opts.huge() != "advise") {
+		LOG_E("Unknown tmpfs huge= value: '%s'", opts.huge().c_str());
+		return false;
+	}
+	tmpfs->huge = opts.huge();
+	return true;
+}
+
 static bool configParseInternal(nsjconf_t* nsjconf, const nsjail::NsJailConfig& njc) {
 	switch (njc.mode()) {
 	case nsjail::Mode::LISTEN:
@@ -77,6 +91,9 @@ static bool configParseInternal(nsjconf_t* nsjconf, const nsjail::NsJailConfig&
 	case nsjail::Mode::EXECVE:
 		nsjconf->mode = MODE_STANDALONE_EXECVE;
 		break;
+	case nsjail::Mode::BATCH:
+		nsjconf->mode = MODE_STANDALONE_BATCH;
+		break;
 	default:
 		LOG_E("Uknown running mode: %d", njc.mode());
 		return false;
@@ -85,6 +102,7 @@ static bool configParseInternal(nsjconf_t* nsjconf, const nsjail::NsJailConfig&
 		nsjconf->chroot = njc.chroot_dir();
 	}
 	nsjconf->is_root_rw = njc.is_root_rw();
+	nsjconf->name = njc.name();
 	nsjconf->hostname = njc.hostname();
 	nsjconf->cwd = njc.cwd();
 	nsjconf->port = njc.port();
@@ -100,6 +118,19 @@ static bool configParseInternal(nsjconf_t* nsjconf, const nsjail::NsJailConfig&
 	if (njc.has_log_file()) {
 		nsjconf->logfile = njc.log_file();
 	}
+	if (njc.has_event_stream()) {
+		nsjconf->event_stream = njc.event_stream();
+	}
+	if (njc.has_batch_manifest()) {
+		nsjconf->batch_manifest = njc.batch_manifest();
+	}
+	nsjconf->batch_parallelism = njc.batch_parallelism();
+	if (njc.has_batch_results()) {
+		nsjconf->batch_results = njc.batch_results();
+	}
+	if (njc.has_control_socket()) {
+		nsjconf->control_socket = njc.control_socket();
+	}
 	if (njc.has_log_level()) {
 		switch (njc.log_level()) {
 		case nsjail::LogLevel::DEBUG:
@@ -183,6 +214,10 @@ static bool configParseInternal(nsjconf_t* nsjconf, const nsjail::NsJailConfig&
 	nsjconf->clone_newipc = njc.clone_newipc();
 	nsjconf->clone_newuts = njc.clone_newuts();
 	nsjconf->clone_newcgroup = njc.clone_newcgroup();
+	nsjconf->pool_newnet = njc.pool_newnet();
+	nsjconf->pool_newipc = njc.pool_newipc();
+	nsjconf->pool_newuts = njc.pool_newuts();
+	nsjconf->ns_pool_size = njc.ns_pool_size();
 
 	for (ssize_t i = 0; i < njc.uidmap_size(); i++) {
 		if (!user::parseId(nsjconf, njc.uidmap(i).inside_id(), njc.uidmap(i).outside_id(),
@@ -225,7 +260,26 @@ static bool configParseInternal(nsjconf_t* nsjconf, const nsjail::NsJailConfig&
 			    dst.c_str());
 			return false;
 		}
+		if (njc.mount(i).is_idmapped()) {
+			if (!njc.mount(i).is_bind()) {
+				LOG_E("ID-mapped mount src:'%s' dst:'%s' must be a bind mount",
+				    src.c_str(), dst.c_str());
+				return false;
+			}
+			nsjconf->mountpts.back().is_idmapped = true;
+		}
+	}
+
+	if (njc.has_tmpfs_root() && !configTmpfs(&nsjconf->tmpfs_root, njc.tmpfs_root())) {
+		return false;
+	}
+	if (njc.has_tmpfs_scratch() && !configTmpfs(&nsjconf->tmpfs_scratch, njc.tmpfs_scratch())) {
+		return false;
+	}
+	if (njc.has_tmpfsmount() && !configTmpfs(&nsjconf->tmpfs_mount, njc.tmpfsmount())) {
+		return false;
 	}
+	nsjconf->skip_unused_scratch_tmpfs = njc.skip_unused_scratch_tmpfs();
 
 	if (njc.has_seccomp_policy_file()) {
 		nsjconf->kafel_file_path = njc.seccomp_policy_file();
@@ -234,6 +288,48 @@ static bool configParseInternal(nsjconf_t* nsjconf, const nsjail::NsJailConfig&
 		nsjconf->kafel_string += njc.seccomp_string(i);
 		nsjconf->kafel_string += '\n';
 	}
+	if (njc.has_seccomp_cache_dir()) {
+		nsjconf->seccomp_cache_dir = njc.seccomp_cache_dir();
+	}
+	for (const auto nr : njc.seccomp_hot_syscall()) {
+		nsjconf->seccomp_hot_syscalls.push_back(nr);
+	}
+	for (ssize_t i = 0; i < njc.seccomp_notify_size(); i++) {
+		const nsjail::SeccompNotify& sn = njc.seccomp_notify(i);
+		notify_t n = {sn.syscall(), NOTIFY_LOG, -1, sn.arg_value(), (int)sn.deny_errno()};
+		switch (sn.action()) {
+		case nsjail::SeccompNotify::LOG:
+			n.action = NOTIFY_LOG;
+			break;
+		case nsjail::SeccompNotify::ALLOW:
+			n.action = NOTIFY_ALLOW;
+			break;
+		case nsjail::SeccompNotify::DENY:
+			n.action = NOTIFY_DENY;
+			break;
+		}
+		if (sn.has_arg_index()) {
+			if (sn.arg_index() > 5) {
+				LOG_E("seccomp_notify: arg_index %u out of range (0-5)",
+				    sn.arg_index());
+				return false;
+			}
+			n.arg_index = sn.arg_index();
+		}
+		nsjconf->seccomp_notify.push_back(n);
+	}
+	if (njc.has_seccomp_profile_file()) {
+		nsjconf->seccomp_profile_file = njc.seccomp_profile_file();
+	}
+	for (ssize_t i = 0; i < njc.seccomp_named_policy_size(); i++) {
+		const nsjail::SeccompPolicy& sp = njc.seccomp_named_policy(i);
+		seccomp_policy_t p = {sp.name(), sp.policy_file(), "", {0, NULL}};
+		for (ssize_t j = 0; j < sp.policy_string().size(); j++) {
+			p.kafel_string += sp.policy_string(j);
+			p.kafel_string += '\n';
+		}
+		nsjconf->seccomp_policies.push_back(p);
+	}
 
 	nsjconf->cgroup_mem_max = njc.cgroup_mem_max();
 	nsjconf->cgroup_mem_mount = njc.cgroup_mem_mount();
@@ -246,12 +342,48 @@ static bool configParseInternal(nsjconf_t* nsjconf, const nsjail::NsJailConfig&
 	nsjconf->cgroup_net_cls_parent = njc.cgroup_net_cls_parent();
 
 	nsjconf->iface_lo = !(njc.iface_no_lo());
+	nsjconf->net_none = njc.net_none();
 	if (njc.has_macvlan_iface()) {
 		nsjconf->iface_vs = njc.macvlan_iface();
 	}
 	nsjconf->iface_vs_ip = njc.macvlan_vs_ip();
 	nsjconf->iface_vs_nm = njc.macvlan_vs_nm();
 	nsjconf->iface_vs_gw = njc.macvlan_vs_gw();
+	nsjconf->iface_vs_ip6 = njc.macvlan_vs_ip6();
+	nsjconf->iface_vs_prefix6 = njc.macvlan_vs_prefix6();
+	nsjconf->iface_vs_gw6 = njc.macvlan_vs_gw6();
+	nsjconf->macvlan_pool_size = njc.macvlan_pool_size();
+	nsjconf->veth_bridge = njc.veth_bridge();
+	nsjconf->veth_cidr = njc.veth_cidr();
+	nsjconf->veth_gw = njc.veth_gw();
+	nsjconf->net_egress_rate = njc.net_egress_rate();
+	nsjconf->net_egress_burst = njc.net_egress_burst();
+	nsjconf->net_ingress_rate = njc.net_ingress_rate();
+	nsjconf->net_ingress_burst = njc.net_ingress_burst();
+	for (ssize_t i = 0; i < njc.port_forward_size(); i++) {
+		nsjconf->port_forwards.push_back(njc.port_forward(i));
+	}
+	for (ssize_t i = 0; i < njc.listener_size(); i++) {
+		const nsjail::Listener& l = njc.listener(i);
+		nsjconf->listeners.push_back({l.name(), l.bindhost(), (int)l.port(), l.unix_path(),
+		    "", {}, l.seccomp_policy_name(), -1});
+		if (!l.has_exec_bin()) {
+			continue;
+		}
+		listener_t* listener = &nsjconf->listeners.back();
+		listener->exec_file = l.exec_bin().path();
+		listener->argv.push_back(l.exec_bin().path());
+		for (ssize_t j = 0; j < l.exec_bin().arg().size(); j++) {
+			listener->argv.push_back(l.exec_bin().arg(j));
+		}
+		if (l.exec_bin().has_arg0()) {
+			listener->argv[0] = l.exec_bin().arg0();
+		}
+		if (l.exec_bin().exec_fd()) {
+			LOG_E("exec_fd is not supported for listeners' exec_bin");
+			return false;
+		}
+	}
 
 	if (njc.has_exec_bin()) {
 		nsjconf->exec_file = njc.exec_bin().path();
@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -44,6 +45,7 @@
 #include "logs.h"
 #include "mnt.h"
 #include "net.h"
+#include "nspool.h"
 #include "pid.h"
 #include "user.h"
 #include "uts.h"
@@ -59,10 +61,17 @@ static bool containInitPidNs(nsjconf_t* nsjconf) {
 }
 
 static bool containInitNetNs(nsjconf_t* nsjconf) {
+	/* Pooled namespaces were set up by the supervisor */
+	if (nspool::isPooled(nsjconf, CLONE_NEWNET)) {
+		return true;
+	}
 	return net::initNsFromChild(nsjconf);
 }
 
 static bool containInitUtsNs(nsjconf_t* nsjconf) {
+	if (nspool::isPooled(nsjconf, CLONE_NEWUTS)) {
+		return true;
+	}
 	return uts::initNs(nsjconf);
 }
 
@@ -260,7 +269,8 @@ static bool containMakeFdsCOE(nsjconf_t* nsjconf) {
 }
 
 bool setupFD(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err) {
-	if (nsjconf->mode != MODE_LISTEN_TCP) {
+	/* Batch jobs get the files from their manifest entries, see batch.cc */
+	if (nsjconf->mode != MODE_LISTEN_TCP && nsjconf->mode != MODE_STANDALONE_BATCH) {
 		if (!nsjconf->is_silent) {
 			return true;
 		}
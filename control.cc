@@ -0,0 +1,551 @@
+/*
+
+   nsjail - control socket for launching jails
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+/*
+ * Clients of the control_socket send a ControlRequest per SOCK_SEQPACKET packet, and get a
+ * ControlResponse back (see config.proto). Launched jails are started with a copy of the current
+ * configuration, with the request's settings applied (see subproc::copyConf()), and are reaped by
+ * the LISTEN mode loop in nsjail.cc as any other jail. Used by the main thread only
+ */
+
+#include "control.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "config.pb.h"
+#include "events.h"
+#include "logs.h"
+#include "macros.h"
+#include "sandbox.h"
+#include "util.h"
+
+namespace control {
+
+static const size_t kMaxRequest = 64 * 1024;
+/* stdin, stdout and stderr */
+static const size_t kMaxFds = 3;
+/* Exit statuses which nobody has asked for yet, the oldest ones are forgotten first */
+static const size_t kMaxResults = 4096;
+
+/* NsJailConfig fields which LAUNCH requests can set */
+static const char* const kLaunchFields[] = {
+    "exec_bin",
+    "envar",
+    "keep_env",
+    "cwd",
+    "hostname",
+    "time_limit",
+    "max_cpus",
+    "rlimit_as",
+    "rlimit_core",
+    "rlimit_cpu",
+    "rlimit_fsize",
+    "rlimit_nofile",
+    "rlimit_nproc",
+    "rlimit_stack",
+    "cgroup_mem_max",
+    "cgroup_pids_max",
+    "cgroup_cpu_ms_per_sec",
+};
+
+static int listenFd = -1;
+static std::vector<int> clients;
+/* pid -> clients waiting for it to exit */
+static std::multimap<pid_t, int> waiters;
+/* Running jails started over the socket */
+static std::set<pid_t> launched;
+static std::map<pid_t, nsjail::ControlResponse> results;
+static std::deque<pid_t> resultsOrder;
+
+bool init(nsjconf_t* nsjconf) {
+	if (nsjconf->control_socket.empty()) {
+		return true;
+	}
+	if (nsjconf->mode != MODE_LISTEN_TCP) {
+		LOG_E("control_socket is supported in MODE_LISTEN_TCP only");
+		return false;
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, '\0', sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (nsjconf->control_socket.size() >= sizeof(addr.sun_path)) {
+		LOG_E("AF_UNIX socket path '%s' too long", nsjconf->control_socket.c_str());
+		return false;
+	}
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", nsjconf->control_socket.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd == -1) {
+		PLOG_E("socket(AF_UNIX, SOCK_SEQPACKET)");
+		return false;
+	}
+	/* A leftover of a previous instance */
+	if (unlink(addr.sun_path) == -1 && errno != ENOENT) {
+		PLOG_W("unlink('%s')", addr.sun_path);
+	}
+	/* Whoever can connect can start jails */
+	mode_t orig_umask = umask(0077);
+	int ret = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+	umask(orig_umask);
+	if (ret == -1) {
+		PLOG_E("bind('%s')", addr.sun_path);
+		close(fd);
+		return false;
+	}
+	if (listen(fd, SOMAXCONN) == -1) {
+		PLOG_E("listen(%d)", SOMAXCONN);
+		close(fd);
+		return false;
+	}
+	listenFd = fd;
+	LOG_I("Accepting control requests on [unix:%s]", addr.sun_path);
+	return true;
+}
+
+void addPollFds(std::vector<struct pollfd>* pfds) {
+	if (listenFd == -1) {
+		return;
+	}
+	pfds->push_back({listenFd, POLLIN, 0});
+	for (int fd : clients) {
+		pfds->push_back({fd, POLLIN, 0});
+	}
+}
+
+static void closeClient(int fd) {
+	for (auto it = waiters.begin(); it != waiters.end();) {
+		if (it->second == fd) {
+			it = waiters.erase(it);
+		} else {
+			++it;
+		}
+	}
+	for (auto it = clients.begin(); it != clients.end(); ++it) {
+		if (*it == fd) {
+			clients.erase(it);
+			break;
+		}
+	}
+	close(fd);
+}
+
+static void reply(int fd, const nsjail::ControlResponse& resp) {
+	std::string buf;
+	if (!resp.SerializeToString(&buf)) {
+		LOG_W("Couldn't serialize the control response");
+		return;
+	}
+	/* A client which doesn't read its replies is closed when it hangs up */
+	if (TEMP_FAILURE_RETRY(send(fd, buf.data(), buf.size(), MSG_NOSIGNAL | MSG_DONTWAIT)) ==
+	    -1) {
+		PLOG_W("send(fd=%d) of the control response", fd);
+	}
+}
+
+static void fillResult(const subproc::reaped_t& r, nsjail::ControlResponse* resp) {
+	resp->set_pid(r.pid);
+	resp->set_state(nsjail::ControlResponse::EXITED);
+	if (WIFEXITED(r.status)) {
+		resp->set_exit_status(WEXITSTATUS(r.status));
+	} else if (WIFSIGNALED(r.status)) {
+		resp->set_signal(WTERMSIG(r.status));
+	}
+	resp->set_run_us(r.run_us);
+	resp->set_utime_us(r.ru.ru_utime.tv_sec * 1000000ULL + r.ru.ru_utime.tv_usec);
+	resp->set_stime_us(r.ru.ru_stime.tv_sec * 1000000ULL + r.ru.ru_stime.tv_usec);
+	resp->set_maxrss_kb(r.ru.ru_maxrss);
+}
+
+static void forgetResult(pid_t pid) {
+	if (results.erase(pid) == 0) {
+		return;
+	}
+	for (auto it = resultsOrder.begin(); it != resultsOrder.end(); ++it) {
+		if (*it == pid) {
+			resultsOrder.erase(it);
+			break;
+		}
+	}
+}
+
+static const pids_t* findJail(nsjconf_t* nsjconf, pid_t pid) {
+	for (const auto& p : nsjconf->pids) {
+		if (p.pid == pid) {
+			return &p;
+		}
+	}
+	return NULL;
+}
+
+static bool checkFields(const nsjail::NsJailConfig& cfg, nsjail::ControlResponse* resp) {
+	std::vector<const google::protobuf::FieldDescriptor*> fields;
+	cfg.GetReflection()->ListFields(cfg, &fields);
+	for (const auto* f : fields) {
+		bool allowed = false;
+		for (size_t i = 0; i < ARR_SZ(kLaunchFields); i++) {
+			if (f->name() == kLaunchFields[i]) {
+				allowed = true;
+				break;
+			}
+		}
+		if (!allowed) {
+			resp->set_error("'" + f->name() + "' can't be set for a single jail");
+			return false;
+		}
+	}
+	if (cfg.has_exec_bin() && cfg.exec_bin().exec_fd()) {
+		resp->set_error("exec_fd is not supported for launched jails");
+		return false;
+	}
+	return true;
+}
+
+static void applyConfig(const nsjail::NsJailConfig& cfg, nsjconf_t* jailconf) {
+	for (const auto& env : cfg.envar()) {
+		jailconf->envs.push_back(env);
+	}
+	if (cfg.has_keep_env()) {
+		jailconf->keep_env = cfg.keep_env();
+	}
+	if (cfg.has_cwd()) {
+		jailconf->cwd = cfg.cwd();
+	}
+	if (cfg.has_hostname()) {
+		jailconf->hostname = cfg.hostname();
+	}
+	if (cfg.has_time_limit()) {
+		jailconf->tlimit = cfg.time_limit();
+	}
+	if (cfg.has_max_cpus()) {
+		jailconf->max_cpus = cfg.max_cpus();
+	}
+	/* In MiB, as in the config */
+	if (cfg.has_rlimit_as()) {
+		jailconf->rl_as = cfg.rlimit_as() * 1024UL * 1024UL;
+	}
+	if (cfg.has_rlimit_core()) {
+		jailconf->rl_core = cfg.rlimit_core() * 1024UL * 1024UL;
+	}
+	if (cfg.has_rlimit_cpu()) {
+		jailconf->rl_cpu = cfg.rlimit_cpu();
+	}
+	if (cfg.has_rlimit_fsize()) {
+		jailconf->rl_fsize = cfg.rlimit_fsize() * 1024UL * 1024UL;
+	}
+	if (cfg.has_rlimit_nofile()) {
+		jailconf->rl_nofile = cfg.rlimit_nofile();
+	}
+	if (cfg.has_rlimit_nproc()) {
+		jailconf->rl_nproc = cfg.rlimit_nproc();
+	}
+	if (cfg.has_rlimit_stack()) {
+		jailconf->rl_stack = cfg.rlimit_stack() * 1024UL * 1024UL;
+	}
+	if (cfg.has_cgroup_mem_max()) {
+		jailconf->cgroup_mem_max = cfg.cgroup_mem_max();
+	}
+	if (cfg.has_cgroup_pids_max()) {
+		jailconf->cgroup_pids_max = cfg.cgroup_pids_max();
+	}
+	if (cfg.has_cgroup_cpu_ms_per_sec()) {
+		jailconf->cgroup_cpu_ms_per_sec = cfg.cgroup_cpu_ms_per_sec();
+	}
+}
+
+static void launch(nsjconf_t* nsjconf, const nsjail::ControlRequest& req,
+    const std::vector<int>& fds, nsjail::ControlResponse* resp) {
+	if (fds.size() != 0 && fds.size() != 1 && fds.size() != 3) {
+		resp->set_error("Expected 0, 1 or 3 file descriptors, got " +
+				std::to_string(fds.size()));
+		return;
+	}
+	const nsjail::NsJailConfig& cfg = req.config();
+	if (!checkFields(cfg, resp)) {
+		return;
+	}
+	if (!req.seccomp_policy_name().empty() &&
+	    !sandbox::hasPolicy(nsjconf, req.seccomp_policy_name())) {
+		resp->set_error("Unknown seccomp policy '" + req.seccomp_policy_name() + "'");
+		return;
+	}
+	/* Listeners can already bring their own command and seccomp policy, see subproc.cc */
+	listener_t l = {"control", "", 0, "", "", {}, req.seccomp_policy_name(), -1};
+	if (cfg.has_exec_bin()) {
+		l.exec_file = cfg.exec_bin().path();
+		l.argv.push_back(cfg.exec_bin().path());
+		for (const auto& arg : cfg.exec_bin().arg()) {
+			l.argv.push_back(arg);
+		}
+		if (cfg.exec_bin().has_arg0()) {
+			l.argv[0] = cfg.exec_bin().arg0();
+		}
+	} else if (nsjconf->argv.empty()) {
+		resp->set_error("No exec_bin, and there's no default command");
+		return;
+	}
+
+	std::shared_ptr<nsjconf_t> jailconf = subproc::copyConf(nsjconf);
+	applyConfig(cfg, jailconf.get());
+
+	int devnull = -1;
+	int fd_in, fd_out, fd_err;
+	if (fds.empty()) {
+		devnull = TEMP_FAILURE_RETRY(open("/dev/null", O_RDWR | O_CLOEXEC));
+		if (devnull == -1) {
+			PLOG_E("open('/dev/null', O_RDWR)");
+			resp->set_error("Couldn't open /dev/null");
+			return;
+		}
+		fd_in = fd_out = fd_err = devnull;
+	} else if (fds.size() == 1) {
+		fd_in = fd_out = fd_err = fds[0];
+	} else {
+		fd_in = fds[0];
+		fd_out = fds[1];
+		fd_err = fds[2];
+	}
+	pid_t pid = subproc::runChildWithConf(nsjconf, jailconf, &l, fd_in, fd_out, fd_err);
+	if (devnull != -1) {
+		close(devnull);
+	}
+	if (pid == -1) {
+		resp->set_error("Couldn't start the jail");
+		return;
+	}
+	/* Of an earlier jail with the same pid */
+	forgetResult(pid);
+	launched.insert(pid);
+	resp->set_pid(pid);
+	resp->set_state(nsjail::ControlResponse::RUNNING);
+}
+
+static void status(nsjconf_t* nsjconf, pid_t pid, nsjail::ControlResponse* resp) {
+	const pids_t* p = findJail(nsjconf, pid);
+	if (p) {
+		resp->set_pid(pid);
+		resp->set_state(nsjail::ControlResponse::RUNNING);
+		if (p->start_us != 0) {
+			resp->set_run_us(events::nowUs() - p->start_us);
+		}
+		return;
+	}
+	auto it = results.find(pid);
+	if (it != results.end()) {
+		*resp = it->second;
+		return;
+	}
+	resp->set_pid(pid);
+	resp->set_state(nsjail::ControlResponse::UNKNOWN);
+}
+
+static void killJail(nsjconf_t* nsjconf, pid_t pid, int sig, nsjail::ControlResponse* resp) {
+	resp->set_pid(pid);
+	/* Only jails of this nsjail, not any process */
+	if (!findJail(nsjconf, pid)) {
+		resp->set_error("No running jail with pid " + std::to_string(pid));
+		return;
+	}
+	if (kill(pid, sig) == -1) {
+		PLOG_W("kill(pid=%d, sig=%d)", (int)pid, sig);
+		resp->set_error("kill() failed: " + std::string(strerror(errno)));
+		return;
+	}
+	resp->set_state(nsjail::ControlResponse::RUNNING);
+}
+
+/* Returns false if the reply has to wait until the jail exits */
+static bool waitJail(
+    nsjconf_t* nsjconf, int client, pid_t pid, nsjail::ControlResponse* resp) {
+	auto it = results.find(pid);
+	if (it != results.end()) {
+		*resp = it->second;
+		forgetResult(pid);
+		return true;
+	}
+	if (findJail(nsjconf, pid)) {
+		waiters.insert({pid, client});
+		return false;
+	}
+	resp->set_pid(pid);
+	resp->set_error("No jail with pid " + std::to_string(pid));
+	return true;
+}
+
+/* The request in 'buf', and the fds passed with it */
+static ssize_t recvRequest(int fd, char* buf, size_t len, std::vector<int>* fds) {
+	struct iovec iov = {
+	    .iov_base = buf,
+	    .iov_len = len,
+	};
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * kMaxFds)];
+		struct cmsghdr align;
+	} cmsgbuf;
+
+	struct msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+	ssize_t ret = TEMP_FAILURE_RETRY(recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT));
+	if (ret <= 0) {
+		return ret;
+	}
+	for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+		size_t cnt = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t i = 0; i < cnt; i++) {
+			int rfd;
+			memcpy(&rfd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+			fds->push_back(rfd);
+		}
+	}
+	if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+		LOG_W("Control request on fd=%d truncated (more than %zu bytes, or %zu fds)", fd,
+		    len, kMaxFds);
+		errno = EMSGSIZE;
+		return -1;
+	}
+	return ret;
+}
+
+static void handleRequest(nsjconf_t* nsjconf, int fd) {
+	static char buf[kMaxRequest];
+	std::vector<int> fds;
+	ssize_t sz = recvRequest(fd, buf, sizeof(buf), &fds);
+	if (sz == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return;
+	}
+
+	nsjail::ControlRequest req;
+	nsjail::ControlResponse resp;
+	bool send_reply = true;
+	if (sz <= 0) {
+		if (sz == -1) {
+			PLOG_W("recvmsg(fd=%d)", fd);
+		}
+		send_reply = false;
+	} else if (!req.ParseFromArray(buf, sz)) {
+		resp.set_error("Couldn't parse the ControlRequest");
+	} else {
+		switch (req.op()) {
+		case nsjail::ControlRequest::LAUNCH:
+			launch(nsjconf, req, fds, &resp);
+			break;
+		case nsjail::ControlRequest::STATUS:
+			status(nsjconf, req.pid(), &resp);
+			break;
+		case nsjail::ControlRequest::KILL:
+			killJail(nsjconf, req.pid(), req.signal(), &resp);
+			break;
+		case nsjail::ControlRequest::WAIT:
+			send_reply = waitJail(nsjconf, fd, req.pid(), &resp);
+			break;
+		default:
+			resp.set_error("Unknown op");
+			break;
+		}
+	}
+	/* The jail has its own copies by now */
+	for (int rfd : fds) {
+		close(rfd);
+	}
+
+	if (sz <= 0) {
+		closeClient(fd);
+		return;
+	}
+	if (resp.has_error()) {
+		LOG_W("Control request on fd=%d failed: %s", fd, resp.error().c_str());
+	}
+	if (send_reply) {
+		reply(fd, resp);
+	}
+}
+
+void handleEvents(nsjconf_t* nsjconf, const struct pollfd* pfds, size_t cnt) {
+	if (cnt == 0) {
+		return;
+	}
+	for (size_t i = 1; i < cnt; i++) {
+		if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+			handleRequest(nsjconf, pfds[i].fd);
+		}
+	}
+	if (pfds[0].revents & POLLIN) {
+		int fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+		if (fd == -1) {
+			PLOG_W("accept4(fd=%d)", listenFd);
+			return;
+		}
+		LOG_D("New control connection, fd=%d", fd);
+		clients.push_back(fd);
+	}
+}
+
+void collect(const std::vector<subproc::reaped_t>& reaped) {
+	for (const auto& r : reaped) {
+		nsjail::ControlResponse resp;
+		fillResult(r, &resp);
+
+		auto range = waiters.equal_range(r.pid);
+		bool waited = (range.first != range.second);
+		for (auto it = range.first; it != range.second; ++it) {
+			reply(it->second, resp);
+		}
+		waiters.erase(range.first, range.second);
+
+		/* Kept for a later WAIT or STATUS */
+		if (launched.erase(r.pid) && !waited) {
+			results[r.pid] = resp;
+			resultsOrder.push_back(r.pid);
+			if (resultsOrder.size() > kMaxResults) {
+				results.erase(resultsOrder.front());
+				resultsOrder.pop_front();
+			}
+		}
+	}
+}
+
+bool busy(void) {
+	return !launched.empty() || !waiters.empty();
+}
+
+}  // namespace control
@@ -0,0 +1,48 @@
+/*
+
+   nsjail - control socket for launching jails
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#ifndef NS_CONTROL_H
+#define NS_CONTROL_H
+
+#include <poll.h>
+#include <stdbool.h>
+
+#include <vector>
+
+#include "nsjail.h"
+#include "subproc.h"
+
+namespace control {
+
+/* Creates the control_socket, if one is configured */
+bool init(nsjconf_t* nsjconf);
+/* Appends the control socket and its connected clients */
+void addPollFds(std::vector<struct pollfd>* pfds);
+/* 'pfds' are the ones appended by addPollFds(), after poll() */
+void handleEvents(nsjconf_t* nsjconf, const struct pollfd* pfds, size_t cnt);
+/* Answers the WAIT requests for the jails collected by subproc::reapProc() */
+void collect(const std::vector<subproc::reaped_t>& reaped);
+/* Jails launched over the socket are running, or clients wait for them */
+bool busy(void);
+
+}  // namespace control
+
+#endif /* NS_CONTROL_H */
@@ -0,0 +1,269 @@
+/*
+
+   nsjail - JSON stream of jail lifecycle events
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "events.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "logs.h"
+#include "macros.h"
+#include "util.h"
+
+namespace events {
+
+/*
+ * One JSON object per line. The fd is non-blocking, and records which the consumer doesn't take
+ * right away wait in a bounded buffer; when it's full, new records are dropped and counted (the
+ * next record carries the count). Used by the main thread only
+ */
+static const size_t kMaxPending = 1024 * 1024;
+
+static int eventFd = -1;
+static bool isSocket = false;
+static std::string pending;
+static uint64_t dropped = 0;
+
+/* 'fd:N' or 'unix:/path' */
+static int openSpec(const std::string& spec) {
+	if (spec.compare(0, 3, "fd:") == 0 && util::isANumber(spec.substr(3).c_str())) {
+		int fd = atoi(spec.substr(3).c_str());
+		if (fcntl(fd, F_GETFD) == -1) {
+			PLOG_E("Event stream fd=%d is not open", fd);
+			return -1;
+		}
+		return fd;
+	}
+	if (spec.compare(0, 5, "unix:") != 0) {
+		LOG_E("Invalid event stream '%s', expected 'fd:N' or 'unix:/path'", spec.c_str());
+		return -1;
+	}
+	struct sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (spec.size() - 5 >= sizeof(addr.sun_path)) {
+		LOG_E("Event stream socket path '%s' is too long", spec.c_str() + 5);
+		return -1;
+	}
+	memcpy(addr.sun_path, spec.c_str() + 5, spec.size() - 5);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		PLOG_E("socket(AF_UNIX, SOCK_STREAM)");
+		return -1;
+	}
+	/* Connected while still blocking, the consumer is expected to be listening */
+	if (TEMP_FAILURE_RETRY(connect(fd, (struct sockaddr*)&addr, sizeof(addr))) == -1) {
+		PLOG_E("connect('%s')", addr.sun_path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool init(nsjconf_t* nsjconf) {
+	if (nsjconf->event_stream.empty()) {
+		return true;
+	}
+	int fd = openSpec(nsjconf->event_stream);
+	if (fd == -1) {
+		return false;
+	}
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		PLOG_E("fcntl(fd=%d, F_SETFL, O_NONBLOCK)", fd);
+		return false;
+	}
+	int type;
+	socklen_t len = sizeof(type);
+	isSocket = (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0);
+	eventFd = fd;
+	LOG_D("Sending lifecycle events to '%s' (fd=%d)", nsjconf->event_stream.c_str(), fd);
+	return true;
+}
+
+void flush(void) {
+	while (eventFd != -1 && !pending.empty()) {
+		/* SIGPIPE is ignored (see nsjail.cc), a consumer which went away gives EPIPE */
+		ssize_t sz = isSocket ? send(eventFd, pending.data(), pending.size(), MSG_NOSIGNAL)
+				      : write(eventFd, pending.data(), pending.size());
+		if (sz > 0) {
+			pending.erase(0, sz);
+			continue;
+		}
+		if (sz == -1 && errno == EINTR) {
+			continue;
+		}
+		if (sz == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return;
+		}
+		PLOG_W("Couldn't write to the event stream, no more events will be sent");
+		if (isSocket) {
+			close(eventFd);
+		}
+		eventFd = -1;
+		pending.clear();
+	}
+}
+
+uint64_t nowUs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void appendStr(std::string* rec, const char* key, const std::string& val) {
+	*rec += ",\"";
+	*rec += key;
+	*rec += "\":";
+	*rec += util::jsonStr(val);
+}
+
+static void appendNum(std::string* rec, const char* key, int64_t val) {
+	*rec += ",\"";
+	*rec += key;
+	*rec += "\":";
+	*rec += std::to_string(val);
+}
+
+/* Common fields */
+static std::string begin(const char* type, const pids_t& p) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	char buf[64];
+	snprintf(buf, sizeof(buf), "{\"time\":%ld.%06ld", (long)ts.tv_sec, ts.tv_nsec / 1000);
+	std::string rec = buf;
+	appendStr(&rec, "event", type);
+	appendNum(&rec, "pid", p.pid);
+	appendStr(&rec, "remote", p.remote_txt);
+	appendStr(&rec, "config", p.conf ? p.conf->name : "");
+	if (dropped > 0) {
+		appendNum(&rec, "dropped", dropped);
+	}
+	return rec;
+}
+
+static void end(std::string* rec) {
+	if (eventFd == -1) {
+		return;
+	}
+	*rec += "}\n";
+	if (pending.size() + rec->size() > kMaxPending) {
+		dropped++;
+		return;
+	}
+	dropped = 0;
+	pending += *rec;
+	flush();
+}
+
+void spawn(const pids_t& p) {
+	if (eventFd == -1) {
+		return;
+	}
+	std::string rec = begin("spawn", p);
+	appendNum(&rec, "clone_us", p.clone_us);
+	end(&rec);
+}
+
+void exec(const pids_t& p) {
+	if (eventFd == -1) {
+		return;
+	}
+	std::string rec = begin("exec", p);
+	appendNum(&rec, "clone_us", p.clone_us);
+	appendNum(&rec, "setup_us", p.setup_us);
+	end(&rec);
+}
+
+void exited(const pids_t& p, int status, const struct rusage& ru) {
+	if (eventFd == -1) {
+		return;
+	}
+	std::string rec = begin("exit", p);
+	if (WIFEXITED(status)) {
+		appendNum(&rec, "exit_status", WEXITSTATUS(status));
+	} else if (WIFSIGNALED(status)) {
+		appendNum(&rec, "signal", WTERMSIG(status));
+		appendStr(&rec, "signal_name", util::sigName(WTERMSIG(status)));
+	}
+	/* Jails taken over from the previous nsjail binary don't have the timings */
+	if (p.start_us != 0) {
+		appendNum(&rec, "run_us", nowUs() - p.start_us);
+	}
+	appendNum(&rec, "utime_us", ru.ru_utime.tv_sec * 1000000LL + ru.ru_utime.tv_usec);
+	appendNum(&rec, "stime_us", ru.ru_stime.tv_sec * 1000000LL + ru.ru_stime.tv_usec);
+	appendNum(&rec, "maxrss_kb", ru.ru_maxrss);
+	appendNum(&rec, "minflt", ru.ru_minflt);
+	appendNum(&rec, "majflt", ru.ru_majflt);
+	appendNum(&rec, "inblock", ru.ru_inblock);
+	appendNum(&rec, "oublock", ru.ru_oublock);
+	appendNum(&rec, "nvcsw", ru.ru_nvcsw);
+	appendNum(&rec, "nivcsw", ru.ru_nivcsw);
+	end(&rec);
+}
+
+void timeLimit(const pids_t& p, time_t run_time) {
+	if (eventFd == -1) {
+		return;
+	}
+	std::string rec = begin("time_limit", p);
+	appendNum(&rec, "run_time", run_time);
+	appendNum(&rec, "time_limit", p.conf ? p.conf->tlimit : 0);
+	end(&rec);
+}
+
+void seccompViolation(const pids_t& p, const syscalls::call_t& call) {
+	if (eventFd == -1) {
+		return;
+	}
+	std::string rec = begin("seccomp_violation", p);
+	if (call.nr != -1) {
+		appendNum(&rec, "nr", call.nr);
+		appendStr(&rec, "syscall", syscalls::name(call.nr));
+	}
+	if (call.has_args) {
+		appendStr(&rec, "call", syscalls::toStr(call.nr, call.args));
+	}
+	appendNum(&rec, "sp", call.sp);
+	appendNum(&rec, "pc", call.pc);
+	end(&rec);
+}
+
+void oom(const pids_t& p) {
+	if (eventFd == -1) {
+		return;
+	}
+	std::string rec = begin("oom", p);
+	appendNum(&rec, "cgroup_mem_max", p.conf ? p.conf->cgroup_mem_max : 0);
+	end(&rec);
+}
+
+}  // namespace events
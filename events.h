@@ -0,0 +1,50 @@
+/*
+
+   nsjail - JSON stream of jail lifecycle events
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#ifndef NS_EVENTS_H
+#define NS_EVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include "nsjail.h"
+#include "syscalls.h"
+
+namespace events {
+
+bool init(nsjconf_t* nsjconf);
+/* Writes what the consumer couldn't take earlier, never blocks */
+void flush(void);
+/* CLOCK_MONOTONIC, for the phase timings in pids_t */
+uint64_t nowUs(void);
+
+void spawn(const pids_t& p);
+void exec(const pids_t& p);
+void exited(const pids_t& p, int status, const struct rusage& ru);
+void timeLimit(const pids_t& p, time_t run_time);
+void seccompViolation(const pids_t& p, const syscalls::call_t& call);
+void oom(const pids_t& p);
+
+}  // namespace events
+
+#endif /* NS_EVENTS_H */
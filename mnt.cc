@@ -40,6 +40,7 @@
 #include <syscall.h>
 #include <unistd.h>
 
+#include <map>
 #include <string>
 
 #include "logs.h"
@@ -53,6 +54,40 @@ namespace mnt {
 #define MS_LAZYTIME (1 << 25)
 #endif /* if !defined(MS_LAZYTIME) */
 
+/* New mount API (Linux >= 5.12 for ID-mapped mounts), possibly missing in older headers */
+#if !defined(__NR_open_tree)
+#define __NR_open_tree 428
+#endif /* !defined(__NR_open_tree) */
+#if !defined(__NR_move_mount)
+#define __NR_move_mount 429
+#endif /* !defined(__NR_move_mount) */
+#if !defined(__NR_mount_setattr)
+#define __NR_mount_setattr 442
+#endif /* !defined(__NR_mount_setattr) */
+#if !defined(OPEN_TREE_CLONE)
+#define OPEN_TREE_CLONE 1
+#endif /* !defined(OPEN_TREE_CLONE) */
+#if !defined(OPEN_TREE_CLOEXEC)
+#define OPEN_TREE_CLOEXEC O_CLOEXEC
+#endif /* !defined(OPEN_TREE_CLOEXEC) */
+#if !defined(MOVE_MOUNT_F_EMPTY_PATH)
+#define MOVE_MOUNT_F_EMPTY_PATH 0x00000004
+#endif /* !defined(MOVE_MOUNT_F_EMPTY_PATH) */
+#if !defined(MOUNT_ATTR_IDMAP)
+#define MOUNT_ATTR_IDMAP 0x00100000
+#endif /* !defined(MOUNT_ATTR_IDMAP) */
+#if !defined(AT_RECURSIVE)
+#define AT_RECURSIVE 0x8000
+#endif /* !defined(AT_RECURSIVE) */
+
+/* Same layout as the kernel's 'struct mount_attr' (MOUNT_ATTR_SIZE_VER0) */
+struct mountAttr_t {
+	uint64_t attr_set;
+	uint64_t attr_clr;
+	uint64_t propagation;
+	uint64_t userns_fd;
+};
+
 static const std::string flagsToStr(uintptr_t flags) {
 	std::string res;
 
@@ -120,11 +155,81 @@ static bool isDir(const char* path) {
 	return false;
 }
 
-static bool mountPt(mount_t* mpt, const char* newroot, const char* tmpdir) {
+/*
+ * Directory fds inside the new root, keyed by their path relative to it ("" is the new root
+ * itself). Mount targets share long prefixes, so each directory is created and opened only once
+ * per jail. Entries are dropped once a new mount shadows them.
+ */
+typedef std::map<std::string, int> dirCache_t;
+
+static int dirCacheGet(dirCache_t* cache, const char* newroot, const std::string& path) {
+	auto it = cache->find(path);
+	if (it != cache->end()) {
+		return it->second;
+	}
+
+	int fd;
+	if (path.empty()) {
+		fd = TEMP_FAILURE_RETRY(open(newroot, O_DIRECTORY | O_RDONLY | O_CLOEXEC));
+		if (fd == -1) {
+			PLOG_W("open('%s', O_DIRECTORY|O_RDONLY|O_CLOEXEC)", newroot);
+			return -1;
+		}
+	} else {
+		size_t pos = path.rfind('/');
+		std::string parent = (pos == std::string::npos) ? "" : path.substr(0, pos);
+		std::string name = (pos == std::string::npos) ? path : path.substr(pos + 1);
+
+		int parent_fd = dirCacheGet(cache, newroot, parent);
+		if (parent_fd == -1) {
+			return -1;
+		}
+		if (mkdirat(parent_fd, name.c_str(), 0755) == -1 && errno != EEXIST) {
+			PLOG_W("mkdir('%s/%s', 0755)", newroot, path.c_str());
+			return -1;
+		}
+		fd = TEMP_FAILURE_RETRY(
+		    openat(parent_fd, name.c_str(), O_DIRECTORY | O_RDONLY | O_CLOEXEC));
+		if (fd == -1) {
+			PLOG_W("openat('%s/%s', O_DIRECTORY|O_RDONLY|O_CLOEXEC)", newroot,
+			    path.c_str());
+			return -1;
+		}
+	}
+
+	cache->insert(std::make_pair(path, fd));
+	return fd;
+}
+
+/* Forget 'path' and all directories below it, as they're now covered by a new mount */
+static void dirCacheDrop(dirCache_t* cache, const std::string& path) {
+	const std::string prefix = path.empty() ? "" : path + "/";
+	auto it = cache->find(path);
+	if (it != cache->end()) {
+		close(it->second);
+		cache->erase(it);
+	}
+	for (it = cache->lower_bound(prefix);
+	     it != cache->end() && it->first.compare(0, prefix.length(), prefix) == 0;) {
+		close(it->second);
+		it = cache->erase(it);
+	}
+}
+
+static void dirCacheClose(dirCache_t* cache) {
+	dirCacheDrop(cache, "");
+}
+
+static bool mountPt(mount_t* mpt, const char* newroot, const char* tmpdir, dirCache_t* cache) {
 	LOG_D("Mounting '%s'", describeMountPt(*mpt).c_str());
 
+	/*
+	 * mpt->dst is normalized by addMountPt(): it starts with a '/' and has no empty
+	 * components
+	 */
+	const std::string relpath = mpt->dst.substr(1);
 	char dstpath[PATH_MAX];
-	snprintf(dstpath, sizeof(dstpath), "%s/%s", newroot, mpt->dst.c_str());
+	snprintf(dstpath, sizeof(dstpath), "%s/%s", newroot, relpath.c_str());
 
 	char srcpath[PATH_MAX];
 	if (!mpt->src.empty()) {
@@ -133,14 +238,18 @@ static bool mountPt(mount_t* mpt, const char* newroot, const char* tmpdir) {
 		snprintf(srcpath, sizeof(srcpath), "none");
 	}
 
-	if (!util::createDirRecursively(dstpath)) {
+	size_t pos = relpath.rfind('/');
+	const std::string parent = (pos == std::string::npos) ? "" : relpath.substr(0, pos);
+	const std::string name = (pos == std::string::npos) ? relpath : relpath.substr(pos + 1);
+	int parent_fd = dirCacheGet(cache, newroot, parent);
+	if (parent_fd == -1) {
 		LOG_W("Couldn't create upper directories for '%s'", dstpath);
 		return false;
 	}
 
 	if (mpt->is_symlink) {
 		LOG_D("symlink('%s', '%s')", srcpath, dstpath);
-		if (symlink(srcpath, dstpath) == -1) {
+		if (symlinkat(srcpath, parent_fd, name.c_str()) == -1) {
 			if (mpt->is_mandatory) {
 				PLOG_W("symlink('%s', '%s')", srcpath, dstpath);
 				return false;
@@ -152,12 +261,15 @@ static bool mountPt(mount_t* mpt, const char* newroot, const char* tmpdir) {
 		return true;
 	}
 
-	if (mpt->is_dir) {
-		if (mkdir(dstpath, 0711) == -1 && errno != EEXIST) {
+	if (name.empty()) {
+		/* The new root itself, it already exists */
+	} else if (mpt->is_dir) {
+		if (mkdirat(parent_fd, name.c_str(), 0711) == -1 && errno != EEXIST) {
 			PLOG_W("mkdir('%s')", dstpath);
 		}
 	} else {
-		int fd = TEMP_FAILURE_RETRY(open(dstpath, O_CREAT | O_RDONLY | O_CLOEXEC, 0644));
+		int fd = TEMP_FAILURE_RETRY(
+		    openat(parent_fd, name.c_str(), O_CREAT | O_RDONLY | O_CLOEXEC, 0644));
 		if (fd >= 0) {
 			close(fd);
 		} else {
@@ -165,6 +277,26 @@ static bool mountPt(mount_t* mpt, const char* newroot, const char* tmpdir) {
 		}
 	}
 
+	if (mpt->is_idmapped) {
+		if (mpt->idmap_fd == -1) {
+			LOG_W("No ID-mapped mount received for '%s'",
+			    describeMountPt(*mpt).c_str());
+			return false;
+		}
+		int ret = syscall(__NR_move_mount, (uintptr_t)mpt->idmap_fd, "",
+		    (uintptr_t)AT_FDCWD, dstpath, (uintptr_t)MOVE_MOUNT_F_EMPTY_PATH);
+		close(mpt->idmap_fd);
+		mpt->idmap_fd = -1;
+		if (ret == -1) {
+			PLOG_W("move_mount('%s') dstpath:'%s' failed",
+			    describeMountPt(*mpt).c_str(), dstpath);
+			return false;
+		}
+		mpt->mounted = true;
+		dirCacheDrop(cache, relpath);
+		return true;
+	}
+
 	if (!mpt->src_content.empty()) {
 		static uint64_t df_counter = 0;
 		snprintf(
@@ -209,6 +341,7 @@ static bool mountPt(mount_t* mpt, const char* newroot, const char* tmpdir) {
 		return false;
 	} else {
 		mpt->mounted = true;
+		dirCacheDrop(cache, relpath);
 	}
 
 	if (!mpt->src_content.empty() && unlink(srcpath) == -1) {
@@ -346,28 +479,43 @@ static bool initNsInternal(nsjconf_t* nsjconf) {
 		PLOG_E("mount('/', '/', NULL, MS_REC|MS_PRIVATE, NULL)");
 		return false;
 	}
-	if (mount(NULL, destdir, "tmpfs", 0, "size=16777216") == -1) {
-		PLOG_E("mount('%s', 'tmpfs')", destdir);
+	const std::string root_opts = tmpfsOptions(nsjconf->tmpfs_root);
+	if (mount(NULL, destdir, "tmpfs", 0, root_opts.c_str()) == -1) {
+		PLOG_E("mount('%s', 'tmpfs', '%s')", destdir, root_opts.c_str());
 		return false;
 	}
 
-	char tmpdir[PATH_MAX];
-	if (!getDir(nsjconf, tmpdir, "tmp")) {
-		LOG_E("Couldn't obtain temporary mount directories");
-		return false;
+	/* The scratch tmpfs is used only to stage the src_content files */
+	bool use_tmpdir = !nsjconf->skip_unused_scratch_tmpfs;
+	for (const auto& p : nsjconf->mountpts) {
+		if (!p.src_content.empty()) {
+			use_tmpdir = true;
+		}
 	}
-	if (mount(NULL, tmpdir, "tmpfs", 0, "size=16777216") == -1) {
-		PLOG_E("mount('%s', 'tmpfs')", tmpdir);
-		return false;
+
+	char tmpdir[PATH_MAX] = "";
+	if (use_tmpdir) {
+		if (!getDir(nsjconf, tmpdir, "tmp")) {
+			LOG_E("Couldn't obtain temporary mount directories");
+			return false;
+		}
+		const std::string scratch_opts = tmpfsOptions(nsjconf->tmpfs_scratch);
+		if (mount(NULL, tmpdir, "tmpfs", 0, scratch_opts.c_str()) == -1) {
+			PLOG_E("mount('%s', 'tmpfs', '%s')", tmpdir, scratch_opts.c_str());
+			return false;
+		}
 	}
 
+	dirCache_t cache;
 	for (auto& p : nsjconf->mountpts) {
-		if (!mountPt(&p, destdir, tmpdir) && p.is_mandatory) {
+		if (!mountPt(&p, destdir, tmpdir, &cache) && p.is_mandatory) {
+			dirCacheClose(&cache);
 			return false;
 		}
 	}
+	dirCacheClose(&cache);
 
-	if (umount2(tmpdir, MNT_DETACH) == -1) {
+	if (use_tmpdir && umount2(tmpdir, MNT_DETACH) == -1) {
 		PLOG_E("umount2('%s', MNT_DETACH)", tmpdir);
 		return false;
 	}
@@ -428,6 +576,106 @@ bool initNs(nsjconf_t* nsjconf) {
 	return false;
 }
 
+/*
+ * ID-mapped mounts must be created by the parent: attaching an idmapping requires privileges
+ * over the source mount's user namespace (i.e. real root for the host's mounts), which the jailed
+ * process doesn't have
+ */
+static int idmapTree(const mount_t& mpt, int userns_fd) {
+	int fd = syscall(__NR_open_tree, (uintptr_t)AT_FDCWD, mpt.src.c_str(),
+	    (uintptr_t)(OPEN_TREE_CLONE | OPEN_TREE_CLOEXEC | AT_RECURSIVE));
+	if (fd == -1) {
+		PLOG_W("open_tree('%s', OPEN_TREE_CLONE|AT_RECURSIVE)", mpt.src.c_str());
+		return -1;
+	}
+
+	struct mountAttr_t attr = {};
+	attr.attr_set = MOUNT_ATTR_IDMAP;
+	attr.userns_fd = userns_fd;
+	if (syscall(__NR_mount_setattr, (uintptr_t)fd, "",
+		(uintptr_t)(AT_EMPTY_PATH | AT_RECURSIVE), &attr, sizeof(attr)) == -1) {
+		PLOG_W("mount_setattr('%s', MOUNT_ATTR_IDMAP). ID-mapped mounts require Linux "
+		       ">= 5.12 and support from the underlying filesystem",
+		    mpt.src.c_str());
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool initNsFromParent(nsjconf_t* nsjconf, pid_t pid, int pipefd) {
+	int userns_fd = -1;
+	for (const auto& mpt : nsjconf->mountpts) {
+		if (!mpt.is_idmapped) {
+			continue;
+		}
+		if (userns_fd == -1) {
+			char path[PATH_MAX];
+			snprintf(path, sizeof(path), "/proc/%d/ns/user", (int)pid);
+			userns_fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+			if (userns_fd == -1) {
+				PLOG_E("open('%s', O_RDONLY|O_CLOEXEC)", path);
+				return false;
+			}
+		}
+
+		int fd = idmapTree(mpt, userns_fd);
+		if (fd == -1) {
+			if (mpt.is_mandatory) {
+				close(userns_fd);
+				return false;
+			}
+			/* No descriptor attached, the child will skip this mount */
+			static const char kNoFd = 'N';
+			if (util::writeToFd(pipefd, &kNoFd, sizeof(kNoFd)) != sizeof(kNoFd)) {
+				close(userns_fd);
+				return false;
+			}
+			continue;
+		}
+		bool ret = util::sendFd(pipefd, fd);
+		close(fd);
+		if (!ret) {
+			close(userns_fd);
+			return false;
+		}
+	}
+	if (userns_fd != -1) {
+		close(userns_fd);
+	}
+	return true;
+}
+
+bool recvIdmapFds(nsjconf_t* nsjconf, int pipefd) {
+	for (auto& mpt : nsjconf->mountpts) {
+		if (!mpt.is_idmapped) {
+			continue;
+		}
+		mpt.idmap_fd = util::recvFd(pipefd);
+		if (mpt.idmap_fd == -1 && mpt.is_mandatory) {
+			LOG_E("Couldn't receive the ID-mapped mount for '%s'",
+			    describeMountPt(mpt).c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Make the path absolute, and remove empty path components, e.g. '//usr/lib/' -> '/usr/lib' */
+static const std::string normalizePath(const std::string& path) {
+	std::string res;
+	for (const auto& c : util::strSplit(path, '/')) {
+		if (c.empty()) {
+			continue;
+		}
+		res.append("/").append(c);
+	}
+	if (res.empty()) {
+		res = "/";
+	}
+	return res;
+}
+
 static bool addMountPt(mount_t* mnt, const std::string& src, const std::string& dst,
     const std::string& fstype, const std::string& options, uintptr_t flags, isDir_t is_dir,
     bool is_mandatory, const std::string& src_env, const std::string& dst_env,
@@ -451,12 +699,15 @@ static bool addMountPt(mount_t* mnt, const std::string& src, const std::string&
 		mnt->dst = e;
 	}
 	mnt->dst.append(dst);
+	mnt->dst = normalizePath(mnt->dst);
 
 	mnt->fs_type = fstype;
 	mnt->options = options;
 	mnt->flags = flags;
 	mnt->is_symlink = is_symlink;
 	mnt->is_mandatory = is_mandatory;
+	mnt->is_idmapped = false;
+	mnt->idmap_fd = -1;
 	mnt->mounted = false;
 	mnt->src_content = src_content;
 
@@ -541,8 +792,25 @@ const std::string describeMountPt(const mount_t& mpt) {
 	if (mpt.is_symlink) {
 		descr.append(" symlink:true");
 	}
+	if (mpt.is_idmapped) {
+		descr.append(" idmapped:true");
+	}
 
 	return descr;
 }
 
+const std::string tmpfsOptions(const tmpfs_t& tmpfs) {
+	std::string opts;
+
+	opts.append("size=").append(std::to_string(tmpfs.size));
+	if (tmpfs.nr_inodes) {
+		opts.append(",nr_inodes=").append(std::to_string(tmpfs.nr_inodes));
+	}
+	if (!tmpfs.huge.empty()) {
+		opts.append(",huge=").append(tmpfs.huge);
+	}
+
+	return opts;
+}
+
 }  // namespace mnt
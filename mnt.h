@@ -38,6 +38,8 @@ typedef enum {
 } isDir_t;
 
 bool initNs(nsjconf_t* nsjconf);
+bool initNsFromParent(nsjconf_t* nsjconf, pid_t pid, int pipefd);
+bool recvIdmapFds(nsjconf_t* nsjconf, int pipefd);
 bool addMountPtHead(nsjconf_t* nsjconf, const std::string& src, const std::string& dst,
     const std::string& fstype, const std::string& options, uintptr_t flags, isDir_t is_dir,
     bool is_mandatory, const std::string& src_env, const std::string& dst_env,
@@ -47,6 +49,7 @@ bool addMountPtTail(nsjconf_t* nsjconf, const std::string& src, const std::strin
     bool is_mandatory, const std::string& src_env, const std::string& dst_env,
     const std::string& src_content, bool is_symlink);
 const std::string describeMountPt(const mount_t& mpt);
+const std::string tmpfsOptions(const tmpfs_t& tmpfs);
 
 }  // namespace mnt
 
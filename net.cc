@@ -23,11 +23,17 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/if_link.h>
+#include <linux/pkt_sched.h>
+#include <linux/veth.h>
+#include <net/ethernet.h>
 #include <net/if.h>
-#include <net/route.h>
 #include <netinet/in.h>
 #include <netinet/ip6.h>
 #include <netinet/tcp.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,114 +43,957 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "logs.h"
-#include "subproc.h"
-
-extern char** environ;
+#include "macros.h"
+#include "nl.h"
+#include "util.h"
 
 namespace net {
 
 #define IFACE_NAME "vs"
 
-#if defined(NSJAIL_NL3_WITH_MACVLAN)
-#include <netlink/route/link.h>
-#include <netlink/route/link/macvlan.h>
-bool initNsFromParent(nsjconf_t* nsjconf, int pid) {
-	if (!nsjconf->clone_newnet) {
-		return true;
+/* Persistent NETLINK_ROUTE socket of the supervisor */
+static int nlSock = -1;
+/* Interface index of the macvlan_iface, resolved at startup */
+static unsigned int vsMasterIdx = 0;
+
+static bool ifaceIndex(int sock, const char* ifacename, int* idx) {
+	struct ifreq ifr;
+	memset(&ifr, '\0', sizeof(ifr));
+	snprintf(ifr.ifr_name, IF_NAMESIZE, "%s", ifacename);
+	if (ioctl(sock, SIOCGIFINDEX, &ifr) == -1) {
+		PLOG_E("ioctl(iface='%s', SIOCGIFINDEX)", ifacename);
+		return false;
 	}
-	if (nsjconf->iface_vs.empty()) {
+	*idx = ifr.ifr_ifindex;
+	return true;
+}
+
+static void msgIfaceUp(nl::msg_t* msg, int idx, const char* descr) {
+	struct ifinfomsg ifi;
+	memset(&ifi, '\0', sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_index = idx;
+	ifi.ifi_flags = IFF_UP;
+	ifi.ifi_change = IFF_UP;
+	nl::initMsg(msg, RTM_NEWLINK, 0, &ifi, sizeof(ifi), descr);
+}
+
+static bool msgAddr(nl::msg_t* msg, int idx, int family, const void* addr, size_t addrlen,
+    uint8_t prefixlen, const void* brd, const char* descr) {
+	struct ifaddrmsg ifa;
+	memset(&ifa, '\0', sizeof(ifa));
+	ifa.ifa_family = family;
+	ifa.ifa_prefixlen = prefixlen;
+	/* The address is unique to this jail, no point in waiting for DAD to finish */
+	ifa.ifa_flags = (family == AF_INET6) ? IFA_F_NODAD : 0;
+	ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+	ifa.ifa_index = idx;
+	nl::initMsg(msg, RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL, &ifa, sizeof(ifa), descr);
+	if (!nl::addAttr(msg, IFA_LOCAL, addr, addrlen) ||
+	    !nl::addAttr(msg, IFA_ADDRESS, addr, addrlen)) {
+		return false;
+	}
+	if (brd && !nl::addAttr(msg, IFA_BROADCAST, brd, addrlen)) {
+		return false;
+	}
+	return true;
+}
+
+static bool msgDefaultRoute(
+    nl::msg_t* msg, int idx, int family, const void* gw, size_t gwlen, const char* descr) {
+	struct rtmsg rtm;
+	memset(&rtm, '\0', sizeof(rtm));
+	rtm.rtm_family = family;
+	rtm.rtm_dst_len = 0;
+	rtm.rtm_table = RT_TABLE_MAIN;
+	rtm.rtm_protocol = RTPROT_BOOT;
+	rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+	rtm.rtm_type = RTN_UNICAST;
+	nl::initMsg(msg, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, &rtm, sizeof(rtm), descr);
+	return nl::addAttr(msg, RTA_GATEWAY, gw, gwlen) && nl::addAttrU32(msg, RTA_OIF, idx);
+}
+
+/* Converts the 'vs' IPv4/IPv6 configuration into addresses and gateways for netlink */
+struct vsConf_t {
+	struct in_addr ip;
+	struct in_addr nm;
+	uint8_t prefix;
+	struct in_addr gw;
+	struct in6_addr ip6;
+	uint8_t prefix6;
+	struct in6_addr gw6;
+};
+
+static bool parseVsConf(nsjconf_t* nsjconf, vsConf_t* vs) {
+	memset(vs, '\0', sizeof(*vs));
+	if (inet_pton(AF_INET, nsjconf->iface_vs_ip.c_str(), &vs->ip) != 1) {
+		LOG_E("Cannot convert '%s' into an IPv4 address", nsjconf->iface_vs_ip.c_str());
+		return false;
+	}
+	if (inet_pton(AF_INET, nsjconf->iface_vs_nm.c_str(), &vs->nm) != 1) {
+		LOG_E("Cannot convert '%s' into a IPv4 netmask", nsjconf->iface_vs_nm.c_str());
+		return false;
+	}
+	vs->prefix = __builtin_popcount(ntohl(vs->nm.s_addr));
+	if (inet_pton(AF_INET, nsjconf->iface_vs_gw.c_str(), &vs->gw) != 1) {
+		LOG_E("Cannot convert '%s' into a IPv4 GW address", nsjconf->iface_vs_gw.c_str());
+		return false;
+	}
+
+	if (!nsjconf->iface_vs_ip6.empty() &&
+	    inet_pton(AF_INET6, nsjconf->iface_vs_ip6.c_str(), &vs->ip6) != 1) {
+		LOG_E("Cannot convert '%s' into an IPv6 address", nsjconf->iface_vs_ip6.c_str());
+		return false;
+	}
+	if (nsjconf->iface_vs_prefix6 > 128) {
+		LOG_E("Invalid IPv6 prefix length: %u", nsjconf->iface_vs_prefix6);
+		return false;
+	}
+	vs->prefix6 = nsjconf->iface_vs_prefix6;
+	if (!nsjconf->iface_vs_gw6.empty() &&
+	    inet_pton(AF_INET6, nsjconf->iface_vs_gw6.c_str(), &vs->gw6) != 1) {
+		LOG_E("Cannot convert '%s' into an IPv6 GW address", nsjconf->iface_vs_gw6.c_str());
+		return false;
+	}
+	return true;
+}
+
+static bool hasIp(const vsConf_t& vs) {
+	return vs.ip.s_addr != INADDR_ANY;
+}
+
+static bool hasIp6(const vsConf_t& vs) {
+	return !IN6_IS_ADDR_UNSPECIFIED(&vs.ip6);
+}
+
+/*
+ * Token bucket (tbf) root qdisc limiting what leaves the interface to 'rate' bytes/s. The queue
+ * holds 50ms worth of traffic on top of the burst, like tc does by default
+ */
+static bool msgTbf(nl::msg_t* msg, int idx, uint64_t rate, uint64_t burst, const char* descr) {
+	if (burst == 0) {
+		burst = std::max(rate / 50, (uint64_t)16384);
+	}
+	struct tcmsg tcm;
+	memset(&tcm, '\0', sizeof(tcm));
+	tcm.tcm_family = AF_UNSPEC;
+	tcm.tcm_ifindex = idx;
+	tcm.tcm_handle = TC_H_MAKE(1U << 16, 0);
+	tcm.tcm_parent = TC_H_ROOT;
+	nl::initMsg(msg, RTM_NEWQDISC, NLM_F_CREATE | NLM_F_REPLACE, &tcm, sizeof(tcm), descr);
+
+	struct tc_tbf_qopt qopt;
+	memset(&qopt, '\0', sizeof(qopt));
+	qopt.rate.rate = (rate >= (1ULL << 32)) ? ~0U : rate;
+	qopt.rate.linklayer = TC_LINKLAYER_ETHERNET;
+	qopt.limit = std::min(burst + rate / 20, (uint64_t)UINT32_MAX);
+	uint32_t burst32 = std::min(burst, (uint64_t)UINT32_MAX);
+	if (!nl::addAttrStr(msg, TCA_KIND, "tbf")) {
+		return false;
+	}
+	struct rtattr* opts = nl::nestStart(msg, TCA_OPTIONS);
+	if (opts == NULL || !nl::addAttr(msg, TCA_TBF_PARMS, &qopt, sizeof(qopt)) ||
+	    !nl::addAttrU32(msg, TCA_TBF_BURST, burst32)) {
+		return false;
+	}
+	if (rate >= (1ULL << 32) && !nl::addAttr(msg, TCA_TBF_RATE64, &rate, sizeof(rate))) {
+		return false;
+	}
+	nl::nestEnd(msg, opts);
+	return true;
+}
+
+/* Appends requests setting addresses, link state and default routes of 'vs' to the batch */
+static bool addVsMsgs(
+    int sock, const vsConf_t& vs, nl::msg_t msgs[], nl::msg_t* batch[], size_t* cnt) {
+	int idx;
+	if (!ifaceIndex(sock, IFACE_NAME, &idx)) {
+		return false;
+	}
+	if (hasIp(vs)) {
+		struct in_addr brd;
+		brd.s_addr = vs.ip.s_addr | ~vs.nm.s_addr;
+		if (!msgAddr(&msgs[*cnt], idx, AF_INET, &vs.ip, sizeof(vs.ip), vs.prefix, &brd,
+			"add IPv4 address to 'vs'")) {
+			return false;
+		}
+		batch[*cnt] = &msgs[*cnt];
+		(*cnt)++;
+	}
+	if (hasIp6(vs)) {
+		if (!msgAddr(&msgs[*cnt], idx, AF_INET6, &vs.ip6, sizeof(vs.ip6), vs.prefix6, NULL,
+			"add IPv6 address to 'vs'")) {
+			return false;
+		}
+		batch[*cnt] = &msgs[*cnt];
+		(*cnt)++;
+	}
+	msgIfaceUp(&msgs[*cnt], idx, "set 'vs' up");
+	batch[*cnt] = &msgs[*cnt];
+	(*cnt)++;
+	if (hasIp(vs) && vs.gw.s_addr != INADDR_ANY) {
+		if (!msgDefaultRoute(&msgs[*cnt], idx, AF_INET, &vs.gw, sizeof(vs.gw),
+			"add IPv4 default route via 'vs'")) {
+			return false;
+		}
+		batch[*cnt] = &msgs[*cnt];
+		(*cnt)++;
+	}
+	if (hasIp6(vs) && !IN6_IS_ADDR_UNSPECIFIED(&vs.gw6)) {
+		if (!msgDefaultRoute(&msgs[*cnt], idx, AF_INET6, &vs.gw6, sizeof(vs.gw6),
+			"add IPv6 default route via 'vs'")) {
+			return false;
+		}
+		batch[*cnt] = &msgs[*cnt];
+		(*cnt)++;
+	}
+	return true;
+}
+
+/* Appends the egress shaping request for 'vs', if configured */
+static bool addEgressMsg(
+    nsjconf_t* nsjconf, int sock, nl::msg_t msgs[], nl::msg_t* batch[], size_t* cnt) {
+	if (nsjconf->net_egress_rate == 0) {
 		return true;
 	}
+	int idx;
+	if (!ifaceIndex(sock, IFACE_NAME, &idx)) {
+		return false;
+	}
+	if (!msgTbf(&msgs[*cnt], idx, nsjconf->net_egress_rate, nsjconf->net_egress_burst,
+		"add egress qdisc to 'vs'")) {
+		return false;
+	}
+	batch[*cnt] = &msgs[*cnt];
+	(*cnt)++;
+	return true;
+}
 
-	LOG_D("Putting iface:'%s' into namespace of PID:%d (with libnl3)",
-	    nsjconf->iface_vs.c_str(), pid);
+/*
+ * Pool of MACVLAN interfaces, created at startup in a holding net namespace, and moved into
+ * jails on demand. Each one owns a fixed address from the configured range
+ */
+struct poolIface_t {
+	std::string name;
+	uint8_t mac[ETH_ALEN];
+	vsConf_t vs;
+	/* Counters survive moves between namespaces, these are the ones of previous jails */
+	struct rtnl_link_stats64 base;
+};
+struct poolUse_t {
+	size_t slot;
+	int ns_fd;
+	int sock;
+};
+static std::vector<poolIface_t> vsPool;
+static std::vector<size_t> vsPoolFree;
+static std::map<pid_t, poolUse_t> vsPoolUsed;
+static int origNsFd = -1;
+static int holdNsFd = -1;
+static int holdSock = -1;
+
+static bool openOrigNs(void) {
+	origNsFd = TEMP_FAILURE_RETRY(open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC));
+	if (origNsFd == -1) {
+		PLOG_E("open('/proc/self/ns/net', O_RDONLY|O_CLOEXEC)");
+		return false;
+	}
+	return true;
+}
 
-	struct nl_sock* sk = nl_socket_alloc();
-	if (sk == NULL) {
-		LOG_E("Could not allocate socket with nl_socket_alloc()");
+/* Opens a NETLINK_ROUTE socket bound to another net namespace */
+static int nsSocket(int ns_fd) {
+	if (setns(ns_fd, CLONE_NEWNET) == -1) {
+		PLOG_E("setns(fd=%d, CLONE_NEWNET)", ns_fd);
+		return -1;
+	}
+	int sock = nl::openSocket();
+	if (setns(origNsFd, CLONE_NEWNET) == -1) {
+		PLOG_F("Couldn't return to the original net namespace");
+	}
+	return sock;
+}
+
+/* Opens a NETLINK_ROUTE socket in the net namespace of a process, and returns the ns fd too */
+static int pidNsSocket(pid_t pid, int* ns_fd) {
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "/proc/%d/ns/net", (int)pid);
+	*ns_fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+	if (*ns_fd == -1) {
+		PLOG_E("open('%s', O_RDONLY|O_CLOEXEC)", path);
+		return -1;
+	}
+	int sock = nsSocket(*ns_fd);
+	if (sock == -1) {
+		close(*ns_fd);
+		*ns_fd = -1;
+	}
+	return sock;
+}
+
+static bool msgMacvlan(nl::msg_t* msg) {
+	struct rtattr* linkinfo = nl::nestStart(msg, IFLA_LINKINFO);
+	if (linkinfo == NULL || !nl::addAttrStr(msg, IFLA_INFO_KIND, "macvlan")) {
 		return false;
 	}
+	struct rtattr* data = nl::nestStart(msg, IFLA_INFO_DATA);
+	if (data == NULL || !nl::addAttrU32(msg, IFLA_MACVLAN_MODE, MACVLAN_MODE_BRIDGE)) {
+		return false;
+	}
+	nl::nestEnd(msg, data);
+	nl::nestEnd(msg, linkinfo);
+	return true;
+}
 
-	int err;
-	if ((err = nl_connect(sk, NETLINK_ROUTE)) < 0) {
-		LOG_E("Unable to connect socket: %s", nl_geterror(err));
-		nl_socket_free(sk);
+static bool poolCreateIface(size_t slot) {
+	poolIface_t* pi = &vsPool[slot];
+	uint64_t rnd = util::rnd64();
+	memcpy(pi->mac, &rnd, sizeof(pi->mac));
+	/* Locally administered, unicast */
+	pi->mac[0] = (pi->mac[0] & 0xfe) | 0x02;
+	memset(&pi->base, '\0', sizeof(pi->base));
+
+	struct ifinfomsg ifi;
+	memset(&ifi, '\0', sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	nl::msg_t msg;
+	nl::initMsg(&msg, RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL, &ifi, sizeof(ifi),
+	    "create pooled MACVLAN interface");
+	if (!nl::addAttrU32(&msg, IFLA_LINK, vsMasterIdx) ||
+	    !nl::addAttrStr(&msg, IFLA_IFNAME, pi->name.c_str()) ||
+	    !nl::addAttr(&msg, IFLA_ADDRESS, pi->mac, sizeof(pi->mac)) ||
+	    !nl::addAttrU32(&msg, IFLA_NET_NS_FD, holdNsFd) || !msgMacvlan(&msg)) {
 		return false;
 	}
+	nl::msg_t* const msgs[] = {&msg};
+	return nl::transact(nlSock, msgs, ARR_SZ(msgs));
+}
 
-	struct rtnl_link* rmv = rtnl_link_macvlan_alloc();
-	if (rmv == NULL) {
-		LOG_E("rtnl_link_macvlan_alloc(): %s", nl_geterror(err));
-		nl_socket_free(sk);
+/* Moves an interface to another net namespace, and renames it there. It's brought down */
+static bool moveIface(int sock, int idx, int ns_fd, const char* name, const uint8_t* mac,
+    const char* descr) {
+	struct ifinfomsg ifi;
+	memset(&ifi, '\0', sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_index = idx;
+	ifi.ifi_flags = 0;
+	ifi.ifi_change = IFF_UP;
+	nl::msg_t msg;
+	nl::initMsg(&msg, RTM_NEWLINK, 0, &ifi, sizeof(ifi), descr);
+	if (!nl::addAttrU32(&msg, IFLA_NET_NS_FD, ns_fd) ||
+	    !nl::addAttrStr(&msg, IFLA_IFNAME, name)) {
+		return false;
+	}
+	if (mac && !nl::addAttr(&msg, IFLA_ADDRESS, mac, ETH_ALEN)) {
 		return false;
 	}
+	nl::msg_t* const msgs[] = {&msg};
+	return nl::transact(sock, msgs, ARR_SZ(msgs));
+}
 
-	struct nl_cache* link_cache;
-	if ((err = rtnl_link_alloc_cache(sk, AF_UNSPEC, &link_cache)) < 0) {
-		LOG_E("rtnl_link_alloc_cache(): %s", nl_geterror(err));
-		rtnl_link_put(rmv);
-		nl_socket_free(sk);
+/* 'ip' + 'off', if it's still within the subnet and it isn't the broadcast address */
+static bool ip4Add(const vsConf_t& vs, uint64_t off, struct in_addr* res) {
+	uint32_t nm = ntohl(vs.nm.s_addr);
+	if (off > UINT32_MAX) {
+		return false;
+	}
+	uint64_t addr = ntohl(vs.ip.s_addr) + off;
+	if (addr > UINT32_MAX || (addr & nm) != (ntohl(vs.ip.s_addr) & nm) ||
+	    (vs.prefix < 31 && (addr | nm) == UINT32_MAX)) {
+		return false;
+	}
+	res->s_addr = htonl(addr);
+	return true;
+}
+
+/* 'ip6' + 'off', carried across all 128 bits, if it's still within the 'prefix6' subnet */
+static bool ip6Add(const vsConf_t& vs, uint64_t off, struct in6_addr* res) {
+	uint64_t carry = off;
+	for (int i = 15; i >= 0; i--) {
+		carry += vs.ip6.s6_addr[i];
+		res->s6_addr[i] = carry & 0xff;
+		carry >>= 8;
+	}
+	if (carry != 0) {
 		return false;
 	}
+	for (uint8_t bit = 0; bit < vs.prefix6; bit++) {
+		uint8_t mask = 0x80 >> (bit % 8);
+		if ((vs.ip6.s6_addr[bit / 8] & mask) != (res->s6_addr[bit / 8] & mask)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool poolInit(nsjconf_t* nsjconf) {
+	if (geteuid() != 0) {
+		LOG_E("The MACVLAN pool requires root privileges");
+		return false;
+	}
+	vsConf_t vs;
+	if (!parseVsConf(nsjconf, &vs)) {
+		return false;
+	}
+	if (!hasIp(vs) && !hasIp6(vs)) {
+		LOG_E("The MACVLAN pool requires an IPv4 or IPv6 address range "
+		      "(macvlan_vs_ip/ip6)");
+		return false;
+	}
+	/* Consecutive addresses, starting at macvlan_vs_ip/macvlan_vs_ip6 */
+	const uint64_t last = nsjconf->macvlan_pool_size - 1;
+	struct in_addr ip;
+	struct in6_addr ip6;
+	if (hasIp(vs) && !ip4Add(vs, last, &ip)) {
+		LOG_E("macvlan_pool_size: %zu addresses starting at %s don't fit in the /%u subnet",
+		    nsjconf->macvlan_pool_size, nsjconf->iface_vs_ip.c_str(), (unsigned)vs.prefix);
+		return false;
+	}
+	if (hasIp6(vs) && !ip6Add(vs, last, &ip6)) {
+		LOG_E("macvlan_pool_size: %zu addresses starting at %s don't fit in the /%u subnet",
+		    nsjconf->macvlan_pool_size, nsjconf->iface_vs_ip6.c_str(),
+		    (unsigned)vs.prefix6);
+		return false;
+	}
+
+	if (!openOrigNs()) {
+		return false;
+	}
+	if (unshare(CLONE_NEWNET) == -1) {
+		PLOG_E("unshare(CLONE_NEWNET)");
+		return false;
+	}
+	holdNsFd = TEMP_FAILURE_RETRY(open("/proc/thread-self/ns/net", O_RDONLY | O_CLOEXEC));
+	if (holdNsFd == -1) {
+		PLOG_E("open('/proc/thread-self/ns/net', O_RDONLY|O_CLOEXEC)");
+	} else {
+		holdSock = nl::openSocket();
+	}
+	if (setns(origNsFd, CLONE_NEWNET) == -1) {
+		PLOG_F("Couldn't return to the original net namespace");
+	}
+	if (holdSock == -1) {
+		return false;
+	}
+
+	vsPool.resize(nsjconf->macvlan_pool_size);
+	for (size_t i = 0; i < vsPool.size(); i++) {
+		vsPool[i].name = "nsjvs" + std::to_string(i);
+		vsPool[i].vs = vs;
+		if (hasIp(vs)) {
+			ip4Add(vs, i, &vsPool[i].vs.ip);
+		}
+		if (hasIp6(vs)) {
+			ip6Add(vs, i, &vsPool[i].vs.ip6);
+		}
+		if (!poolCreateIface(i)) {
+			LOG_E("Couldn't create pooled MACVLAN interface '%s'",
+			    vsPool[i].name.c_str());
+			return false;
+		}
+		vsPoolFree.push_back(i);
+	}
+	LOG_D("Created %zu MACVLAN interfaces in the holding net namespace", vsPool.size());
+	return true;
+}
+
+static bool poolAcquire(nsjconf_t* nsjconf, pid_t pid) {
+	if (vsPoolFree.empty()) {
+		LOG_E("No free MACVLAN interfaces left in the pool (size: %zu)", vsPool.size());
+		return false;
+	}
+	size_t slot = vsPoolFree.back();
+	const poolIface_t& pi = vsPool[slot];
+
+	/* Keeps the jail's namespace (and the interface) alive until the interface is returned */
+	int ns_fd;
+	int sock = pidNsSocket(pid, &ns_fd);
+	if (sock == -1) {
+		return false;
+	}
+
+	int idx;
+	if (!ifaceIndex(holdSock, pi.name.c_str(), &idx) ||
+	    !moveIface(holdSock, idx, ns_fd, IFACE_NAME, NULL,
+		"move pooled MACVLAN interface into the jail")) {
+		close(sock);
+		close(ns_fd);
+		return false;
+	}
+	vsPoolFree.pop_back();
+	vsPoolUsed[pid] = {slot, ns_fd, sock};
+
+	/*
+	 * Moving between namespaces flushes addresses and qdiscs, so they're set once it's in the
+	 * jail. The qdisc goes away the same way when the interface is returned to the pool
+	 */
+	nl::msg_t msgs[6];
+	nl::msg_t* batch[ARR_SZ(msgs)];
+	size_t cnt = 0;
+	if (!addVsMsgs(sock, pi.vs, msgs, batch, &cnt) ||
+	    !addEgressMsg(nsjconf, sock, msgs, batch, &cnt) || !nl::transact(sock, batch, cnt)) {
+		LOG_E("Couldn't configure pooled MACVLAN interface '%s'", pi.name.c_str());
+		return false;
+	}
+	LOG_D("Moved '%s' into the net namespace of PID:%d", pi.name.c_str(), pid);
+	return true;
+}
+
+/*
+ * IPv4 address management for the veth mode. The offsets within veth_cidr are tracked in a
+ * hierarchy of bitmaps: a set bit in ipamFree[0] is a free offset, a set bit in ipamFree[n + 1]
+ * means that the corresponding word of ipamFree[n] has a free bit. The top level is a single
+ * word. Leasing (the lowest free offset) and releasing walk one word per level, which is at most
+ * 4 levels for a /8
+ */
+static struct in_addr ipamBase;
+static uint8_t ipamPrefix;
+static std::vector<std::vector<uint64_t>> ipamFree;
+static size_t ipamFreeCnt = 0;
+
+/* Updates the upper levels after ipamFree[0][off / 64] changed */
+static void ipamPropagate(uint32_t off) {
+	size_t idx = off / 64;
+	for (size_t lvl = 1; lvl < ipamFree.size(); lvl++) {
+		uint64_t bit = 1ULL << (idx % 64);
+		uint64_t& word = ipamFree[lvl][idx / 64];
+		bool has_free = (ipamFree[lvl - 1][idx] != 0);
+		if (((word & bit) != 0) == has_free) {
+			return;
+		}
+		word ^= bit;
+		idx /= 64;
+	}
+}
+
+static void ipamMark(uint32_t off) {
+	ipamFree[0][off / 64] &= ~(1ULL << (off % 64));
+	ipamPropagate(off);
+}
+
+static bool ipamInit(const std::string& cidr, const struct in_addr& gw) {
+	size_t pos = cidr.find('/');
+	if (pos == std::string::npos) {
+		LOG_E("'%s' is not in the a.b.c.d/prefix format", cidr.c_str());
+		return false;
+	}
+	std::string addr = cidr.substr(0, pos);
+	if (inet_pton(AF_INET, addr.c_str(), &ipamBase) != 1) {
+		LOG_E("Cannot convert '%s' into an IPv4 address", addr.c_str());
+		return false;
+	}
+	int prefix = atoi(cidr.substr(pos + 1).c_str());
+	if (prefix < 8 || prefix > 30) {
+		LOG_E("Prefix length of '%s' must be within 8..30", cidr.c_str());
+		return false;
+	}
+	ipamPrefix = prefix;
+	uint32_t size = 1U << (32 - prefix);
+	ipamBase.s_addr = htonl(ntohl(ipamBase.s_addr) & ~(size - 1));
+
+	ipamFree.clear();
+	ipamFree.push_back(std::vector<uint64_t>((size + 63) / 64, ~0ULL));
+	/* Smaller than a word with prefixes longer than /26 */
+	if (size < 64) {
+		ipamFree[0][0] = (1ULL << size) - 1;
+	}
+	while (ipamFree.back().size() > 1) {
+		size_t cnt = ipamFree.back().size();
+		std::vector<uint64_t> lvl((cnt + 63) / 64, 0);
+		for (size_t i = 0; i < cnt; i++) {
+			lvl[i / 64] |= (1ULL << (i % 64));
+		}
+		ipamFree.push_back(lvl);
+	}
+	ipamFreeCnt = size - 2;
+	/* The network and the broadcast addresses are never leased */
+	ipamMark(0);
+	ipamMark(size - 1);
+	uint32_t gw_off = ntohl(gw.s_addr) - ntohl(ipamBase.s_addr);
+	if (gw_off > 0 && gw_off < size - 1) {
+		ipamMark(gw_off);
+		ipamFreeCnt--;
+	}
+	LOG_D("%zu addresses available in '%s'", ipamFreeCnt, cidr.c_str());
+	return true;
+}
+
+static bool ipamAlloc(uint32_t* off) {
+	if (ipamFreeCnt == 0) {
+		return false;
+	}
+	size_t idx = 0;
+	for (size_t lvl = ipamFree.size(); lvl > 0; lvl--) {
+		idx = idx * 64 + __builtin_ctzll(ipamFree[lvl - 1][idx]);
+	}
+	*off = idx;
+	ipamMark(*off);
+	ipamFreeCnt--;
+	return true;
+}
+
+static void ipamRelease(uint32_t off) {
+	if ((ipamFree[0][off / 64] & (1ULL << (off % 64))) != 0) {
+		LOG_W("Address offset %u is not leased", off);
+		return;
+	}
+	ipamFree[0][off / 64] |= (1ULL << (off % 64));
+	ipamPropagate(off);
+	ipamFreeCnt++;
+}
+
+/* veth mode: the host end of each jail's veth pair is attached to veth_bridge */
+struct vethUse_t {
+	uint32_t off;
+	std::string host_name;
+	/*
+	 * Bound to the jail's net namespace. It keeps the namespace, and with it the veth pair,
+	 * around until the jail is reaped, so the statistics can still be read then
+	 */
+	int sock;
+};
+static unsigned int vethBridgeIdx = 0;
+static vsConf_t vethConf;
+static std::map<pid_t, vethUse_t> vethUsed;
+
+static bool vethInit(nsjconf_t* nsjconf) {
+	if (geteuid() != 0) {
+		LOG_E("The veth mode requires root privileges");
+		return false;
+	}
+	if (!nsjconf->iface_vs.empty()) {
+		LOG_E("veth_bridge and macvlan_iface cannot be used together");
+		return false;
+	}
+	vethBridgeIdx = if_nametoindex(nsjconf->veth_bridge.c_str());
+	if (vethBridgeIdx == 0) {
+		PLOG_E("if_nametoindex('%s')", nsjconf->veth_bridge.c_str());
+		return false;
+	}
+
+	memset(&vethConf, '\0', sizeof(vethConf));
+	if (!nsjconf->veth_gw.empty() &&
+	    inet_pton(AF_INET, nsjconf->veth_gw.c_str(), &vethConf.gw) != 1) {
+		LOG_E("Cannot convert '%s' into a IPv4 GW address", nsjconf->veth_gw.c_str());
+		return false;
+	}
+	if (!ipamInit(nsjconf->veth_cidr, vethConf.gw)) {
+		return false;
+	}
+	vethConf.prefix = ipamPrefix;
+	vethConf.nm.s_addr = htonl(~((1U << (32 - ipamPrefix)) - 1));
+
+	nlSock = nl::openSocket();
+	if (nlSock == -1) {
+		return false;
+	}
+	return openOrigNs();
+}
+
+static bool vethCreate(nsjconf_t* nsjconf, pid_t pid) {
+	uint32_t off;
+	if (!ipamAlloc(&off)) {
+		LOG_E("No free addresses left in '%s'", nsjconf->veth_cidr.c_str());
+		return false;
+	}
+	vethUse_t vu = {off, "nsjv" + std::to_string(pid), -1};
+
+	struct ifinfomsg ifi;
+	memset(&ifi, '\0', sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_flags = IFF_UP;
+	ifi.ifi_change = IFF_UP;
+	nl::msg_t msg;
+	nl::initMsg(&msg, RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL, &ifi, sizeof(ifi),
+	    "create veth pair");
+	struct rtattr *linkinfo, *data, *peer;
+	struct ifinfomsg peer_ifi;
+	memset(&peer_ifi, '\0', sizeof(peer_ifi));
+	peer_ifi.ifi_family = AF_UNSPEC;
+	if (!nl::addAttrStr(&msg, IFLA_IFNAME, vu.host_name.c_str()) ||
+	    !nl::addAttrU32(&msg, IFLA_MASTER, vethBridgeIdx) ||
+	    (linkinfo = nl::nestStart(&msg, IFLA_LINKINFO)) == NULL ||
+	    !nl::addAttrStr(&msg, IFLA_INFO_KIND, "veth") ||
+	    (data = nl::nestStart(&msg, IFLA_INFO_DATA)) == NULL ||
+	    (peer = nl::nestStart(&msg, VETH_INFO_PEER)) == NULL ||
+	    !nl::addData(&msg, &peer_ifi, sizeof(peer_ifi)) ||
+	    !nl::addAttrStr(&msg, IFLA_IFNAME, IFACE_NAME) ||
+	    !nl::addAttrU32(&msg, IFLA_NET_NS_PID, pid)) {
+		ipamRelease(off);
+		return false;
+	}
+	nl::nestEnd(&msg, peer);
+	nl::nestEnd(&msg, data);
+	nl::nestEnd(&msg, linkinfo);
+	nl::msg_t* const msgs[] = {&msg};
+	if (!nl::transact(nlSock, msgs, ARR_SZ(msgs))) {
+		ipamRelease(off);
+		return false;
+	}
+	vethUsed[pid] = vu;
+
+	vsConf_t vs = vethConf;
+	vs.ip.s_addr = htonl(ntohl(ipamBase.s_addr) + off);
+	int ns_fd;
+	int sock = pidNsSocket(pid, &ns_fd);
+	if (sock == -1) {
+		return false;
+	}
+	close(ns_fd);
+	vethUsed[pid].sock = sock;
+	nl::msg_t vs_msgs[6];
+	nl::msg_t* batch[ARR_SZ(vs_msgs)];
+	size_t cnt = 0;
+	bool ret = addVsMsgs(sock, vs, vs_msgs, batch, &cnt) &&
+		   addEgressMsg(nsjconf, sock, vs_msgs, batch, &cnt) &&
+		   nl::transact(sock, batch, cnt);
+	if (!ret) {
+		LOG_E("Couldn't configure the veth interface of PID:%d", pid);
+		return false;
+	}
+	/* What the host end sends is what the jail receives */
+	if (nsjconf->net_ingress_rate > 0) {
+		int host_idx = if_nametoindex(vu.host_name.c_str());
+		nl::msg_t msg;
+		if (host_idx == 0) {
+			PLOG_E("if_nametoindex('%s')", vu.host_name.c_str());
+			return false;
+		}
+		if (!msgTbf(&msg, host_idx, nsjconf->net_ingress_rate, nsjconf->net_ingress_burst,
+			"add ingress qdisc to the host end of veth")) {
+			return false;
+		}
+		nl::msg_t* const msgs[] = {&msg};
+		if (!nl::transact(nlSock, msgs, ARR_SZ(msgs))) {
+			return false;
+		}
+	}
+
+	char ipstr[INET_ADDRSTRLEN];
+	LOG_D("Created veth pair '%s'<->'%s' (%s) for PID:%d", vu.host_name.c_str(), IFACE_NAME,
+	    inet_ntop(AF_INET, &vs.ip, ipstr, sizeof(ipstr)), pid);
+	return true;
+}
+
+/* Deleting the host end removes the jail's end too, so its address can be leased again */
+static void vethRelease(pid_t pid) {
+	auto it = vethUsed.find(pid);
+	if (it == vethUsed.end()) {
+		return;
+	}
+	struct ifinfomsg ifi;
+	memset(&ifi, '\0', sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	nl::msg_t msg;
+	nl::initMsg(&msg, RTM_DELLINK, 0, &ifi, sizeof(ifi), "delete veth pair");
+	if (nl::addAttrStr(&msg, IFLA_IFNAME, it->second.host_name.c_str())) {
+		nl::msg_t* const msgs[] = {&msg};
+		nl::transact(nlSock, msgs, ARR_SZ(msgs));
+	}
+	if (it->second.sock != -1) {
+		close(it->second.sock);
+	}
+	ipamRelease(it->second.off);
+	vethUsed.erase(it);
+}
 
-	int master_index = rtnl_link_name2i(link_cache, nsjconf->iface_vs.c_str());
-	if (master_index == 0) {
-		LOG_E("rtnl_link_name2i(): Did not find '%s' interface", nsjconf->iface_vs.c_str());
-		nl_cache_free(link_cache);
-		rtnl_link_put(rmv);
-		nl_socket_free(sk);
+/*
+ * Per-jail MACVLAN interfaces disappear together with the jail's namespace. A socket bound to
+ * it keeps the namespace, and the interface statistics, around until the jail is reaped
+ */
+static std::map<pid_t, int> vsSocks;
+
+static bool linkStats(int sock, const char* ifacename, struct rtnl_link_stats64* st) {
+	struct ifinfomsg ifi;
+	memset(&ifi, '\0', sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	nl::msg_t msg;
+	nl::initMsg(&msg, RTM_GETLINK, 0, &ifi, sizeof(ifi), "get interface statistics");
+	if (!nl::addAttrStr(&msg, IFLA_IFNAME, ifacename)) {
+		return false;
+	}
+	uint8_t buf[16384] __attribute__((aligned(NLMSG_ALIGNTO)));
+	ssize_t len = nl::query(sock, &msg, buf, sizeof(buf));
+	if (len == -1) {
 		return false;
 	}
+	struct nlmsghdr* nh = (struct nlmsghdr*)buf;
+	int attrlen = IFLA_PAYLOAD(nh);
+	for (struct rtattr* rta = IFLA_RTA((struct ifinfomsg*)NLMSG_DATA(nh)); RTA_OK(rta, attrlen);
+	     rta = RTA_NEXT(rta, attrlen)) {
+		if (rta->rta_type == IFLA_STATS64 && RTA_PAYLOAD(rta) >= sizeof(*st)) {
+			memcpy(st, RTA_DATA(rta), sizeof(*st));
+			return true;
+		}
+	}
+	LOG_W("No IFLA_STATS64 for interface '%s'", ifacename);
+	return false;
+}
+
+const std::string statsToText(nsjconf_t* nsjconf, pid_t pid) {
+	struct rtnl_link_stats64 st;
+	bool ok;
+	auto veth = vethUsed.find(pid);
+	auto pool = vsPoolUsed.find(pid);
+	auto vs = vsSocks.find(pid);
+	if (veth != vethUsed.end()) {
+		ok = linkStats(nlSock, veth->second.host_name.c_str(), &st);
+		/* Counted from the host's end of the pair */
+		std::swap(st.rx_bytes, st.tx_bytes);
+		std::swap(st.rx_packets, st.tx_packets);
+		std::swap(st.rx_dropped, st.tx_dropped);
+	} else if (pool != vsPoolUsed.end()) {
+		ok = linkStats(pool->second.sock, IFACE_NAME, &st);
+		const struct rtnl_link_stats64& base = vsPool[pool->second.slot].base;
+		st.rx_bytes -= base.rx_bytes;
+		st.tx_bytes -= base.tx_bytes;
+		st.rx_packets -= base.rx_packets;
+		st.tx_packets -= base.tx_packets;
+		st.rx_dropped -= base.rx_dropped;
+		st.tx_dropped -= base.tx_dropped;
+	} else if (vs != vsSocks.end()) {
+		ok = linkStats(vs->second, IFACE_NAME, &st);
+	} else {
+		return "";
+	}
+	if (!ok) {
+		return "";
+	}
 
-	rtnl_link_set_name(rmv, IFACE_NAME);
-	rtnl_link_set_link(rmv, master_index);
-	rtnl_link_set_ns_pid(rmv, pid);
+	char buf[256];
+	snprintf(buf, sizeof(buf),
+	    " (rx: %llu bytes/%llu packets/%llu dropped, tx: %llu bytes/%llu packets/%llu dropped)",
+	    (unsigned long long)st.rx_bytes, (unsigned long long)st.rx_packets,
+	    (unsigned long long)st.rx_dropped, (unsigned long long)st.tx_bytes,
+	    (unsigned long long)st.tx_packets, (unsigned long long)st.tx_dropped);
+	return buf;
+}
+
+void releaseNs(nsjconf_t* nsjconf, pid_t pid) {
+	vethRelease(pid);
+
+	auto vs = vsSocks.find(pid);
+	if (vs != vsSocks.end()) {
+		close(vs->second);
+		vsSocks.erase(vs);
+	}
 
-	if ((err = rtnl_link_add(sk, rmv, NLM_F_CREATE)) < 0) {
-		LOG_E("rtnl_link_add(name:'%s' link:'%s'): %s", IFACE_NAME,
-		    nsjconf->iface_vs.c_str(), nl_geterror(err));
-		nl_cache_free(link_cache);
-		rtnl_link_put(rmv);
-		nl_socket_free(sk);
+	auto it = vsPoolUsed.find(pid);
+	if (it == vsPoolUsed.end()) {
+		return;
+	}
+	const poolUse_t& pu = it->second;
+	poolIface_t& pi = vsPool[pu.slot];
+
+	/* The MAC address might've been changed inside the jail, restore it too */
+	int idx;
+	if (linkStats(pu.sock, IFACE_NAME, &pi.base) && ifaceIndex(pu.sock, IFACE_NAME, &idx) &&
+	    moveIface(pu.sock, idx, holdNsFd, pi.name.c_str(), pi.mac,
+		"return MACVLAN interface to the pool")) {
+		vsPoolFree.push_back(pu.slot);
+	} else {
+		LOG_W("Couldn't return '%s' to the pool, creating a new one", pi.name.c_str());
+		if (poolCreateIface(pu.slot)) {
+			vsPoolFree.push_back(pu.slot);
+		}
+	}
+	close(pu.sock);
+	close(pu.ns_fd);
+	vsPoolUsed.erase(it);
+}
+
+bool init(nsjconf_t* nsjconf) {
+	if (!nsjconf->clone_newnet) {
+		return true;
+	}
+	if ((nsjconf->net_egress_rate > 0 || nsjconf->net_ingress_rate > 0) &&
+	    nsjconf->iface_vs.empty() && nsjconf->veth_bridge.empty()) {
+		LOG_E("Bandwidth limits require a MACVLAN (macvlan_iface) or veth (veth_bridge) "
+		      "interface");
+		return false;
+	}
+	if (nsjconf->net_ingress_rate > 0 && nsjconf->veth_bridge.empty()) {
+		LOG_E("Ingress bandwidth limit is only supported with veth_bridge");
 		return false;
 	}
+	if (!nsjconf->veth_bridge.empty()) {
+		return vethInit(nsjconf);
+	}
+	if (nsjconf->iface_vs.empty()) {
+		return true;
+	}
 
-	nl_cache_free(link_cache);
-	rtnl_link_put(rmv);
-	nl_socket_free(sk);
+	vsMasterIdx = if_nametoindex(nsjconf->iface_vs.c_str());
+	if (vsMasterIdx == 0) {
+		PLOG_E("if_nametoindex('%s')", nsjconf->iface_vs.c_str());
+		return false;
+	}
+	nlSock = nl::openSocket();
+	if (nlSock == -1) {
+		return false;
+	}
+	LOG_D("MACVLAN parent interface '%s' has index %u", nsjconf->iface_vs.c_str(),
+	    vsMasterIdx);
+	if (nsjconf->macvlan_pool_size > 0) {
+		return poolInit(nsjconf);
+	}
 	return true;
 }
-#else   // defined(NSJAIL_NL3_WITH_MACVLAN)
 
 bool initNsFromParent(nsjconf_t* nsjconf, int pid) {
 	if (!nsjconf->clone_newnet) {
 		return true;
 	}
+	if (!nsjconf->veth_bridge.empty()) {
+		return vethCreate(nsjconf, pid);
+	}
 	if (nsjconf->iface_vs.empty()) {
 		return true;
 	}
 
-	LOG_D("Putting iface:'%s' into namespace of PID:%d (with /sbin/ip)",
-	    nsjconf->iface_vs.c_str(), pid);
+	if (nsjconf->macvlan_pool_size > 0) {
+		return poolAcquire(nsjconf, pid);
+	}
+
+	LOG_D("Putting iface:'%s' into namespace of PID:%d", nsjconf->iface_vs.c_str(), pid);
+
+	struct ifinfomsg ifi;
+	memset(&ifi, '\0', sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
 
-	char pid_str[256];
-	snprintf(pid_str, sizeof(pid_str), "%d", pid);
+	nl::msg_t msg;
+	nl::initMsg(&msg, RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL, &ifi, sizeof(ifi),
+	    "create MACVLAN interface");
+	if (!nl::addAttrU32(&msg, IFLA_LINK, vsMasterIdx) ||
+	    !nl::addAttrStr(&msg, IFLA_IFNAME, IFACE_NAME) ||
+	    !nl::addAttrU32(&msg, IFLA_NET_NS_PID, pid) || !msgMacvlan(&msg)) {
+		return false;
+	}
 
-	const std::vector<std::string> argv{"/sbin/ip", "link", "add", "link", nsjconf->iface_vs,
-	    "name", IFACE_NAME, "netns", pid_str, "type", "macvlan", "mode", "bridge"};
-	if (subproc::systemExe(argv, environ) != 0) {
-		LOG_E("Couldn't create MACVTAP interface for '%s'", nsjconf->iface_vs.c_str());
+	nl::msg_t* const msgs[] = {&msg};
+	if (!nl::transact(nlSock, msgs, ARR_SZ(msgs))) {
+		LOG_E("Couldn't create MACVLAN interface for '%s'", nsjconf->iface_vs.c_str());
 		return false;
 	}
 
+	int ns_fd;
+	int sock = pidNsSocket(pid, &ns_fd);
+	if (sock == -1) {
+		return false;
+	}
+	close(ns_fd);
+	vsSocks[pid] = sock;
 	return true;
 }
-#endif  // defined(NSJAIL_NL3_WITH_MACVLAN)
 
 static bool isSocket(int fd) {
 	int optval;
@@ -164,6 +1013,10 @@ bool limitConns(nsjconf_t* nsjconf, int connsock) {
 
 	struct sockaddr_in6 addr;
 	auto connstr = connToText(connsock, true /* remote */, &addr);
+	/* There are no addresses to count connections of AF_UNIX peers by */
+	if (addr.sin6_family != AF_INET6) {
+		return true;
+	}
 
 	unsigned cnt = 0;
 	for (const auto& pid : nsjconf->pids) {
@@ -238,6 +1091,189 @@ int getRecvSocket(const char* bindhost, int port) {
 	return sockfd;
 }
 
+int getRecvUnixSocket(const char* path) {
+	struct sockaddr_un addr;
+	memset(&addr, '\0', sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		LOG_E("AF_UNIX socket path '%s' too long", path);
+		return -1;
+	}
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+	int sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sockfd == -1) {
+		PLOG_E("socket(AF_UNIX)");
+		return -1;
+	}
+	/* A leftover of a previous instance */
+	if (unlink(path) == -1 && errno != ENOENT) {
+		PLOG_W("unlink('%s')", path);
+	}
+	if (bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+		close(sockfd);
+		PLOG_E("bind('%s')", path);
+		return -1;
+	}
+	if (listen(sockfd, SOMAXCONN) == -1) {
+		close(sockfd);
+		PLOG_E("listen(%d)", SOMAXCONN);
+		return -1;
+	}
+	LOG_I("Listening on [unix:%s]", path);
+	return sockfd;
+}
+
+/* Unnamed listeners are identified by their position, when passed to an upgraded nsjail */
+const std::string listenerName(nsjconf_t* nsjconf, size_t idx) {
+	if (!nsjconf->listeners[idx].name.empty()) {
+		return nsjconf->listeners[idx].name;
+	}
+	return "nsjail-listener-" + std::to_string(idx);
+}
+
+static bool adoptListener(nsjconf_t* nsjconf, int fd, const std::string& name) {
+	if (!isSocket(fd)) {
+		LOG_E("Inherited fd=%d is not a socket", fd);
+		return false;
+	}
+	if (TEMP_FAILURE_RETRY(fcntl(fd, F_SETFD, FD_CLOEXEC)) == -1) {
+		PLOG_E("fcntl(fd=%d, F_SETFD, FD_CLOEXEC)", fd);
+		return false;
+	}
+	listener_t* l = NULL;
+	for (size_t i = 0; i < nsjconf->listeners.size(); i++) {
+		if (nsjconf->listeners[i].fd == -1 && !name.empty() &&
+		    listenerName(nsjconf, i) == name) {
+			l = &nsjconf->listeners[i];
+			break;
+		}
+	}
+	if (l == NULL) {
+		nsjconf->listeners.push_back({name, "", 0, "", "", {}, "", -1});
+		l = &nsjconf->listeners.back();
+	}
+	l->fd = fd;
+	LOG_I("Listening on inherited fd=%d ('%s')", fd, name.c_str());
+	return true;
+}
+
+/*
+ * Sockets passed by the service manager (systemd socket activation) start at fd=3. They're
+ * matched with the configured listeners by their LISTEN_FDNAMES names
+ */
+static bool inheritSystemdListeners(nsjconf_t* nsjconf) {
+	const char* pid_str = getenv("LISTEN_PID");
+	const char* fds_str = getenv("LISTEN_FDS");
+	if (pid_str == NULL || fds_str == NULL) {
+		return true;
+	}
+	if ((pid_t)strtol(pid_str, NULL, 10) != getpid()) {
+		LOG_D("LISTEN_PID=%s is not our PID, ignoring LISTEN_FDS", pid_str);
+		return true;
+	}
+	const char* names_str = getenv("LISTEN_FDNAMES");
+	std::vector<std::string> names;
+	if (names_str != NULL) {
+		names = util::strSplit(names_str, ':');
+	}
+
+	int cnt = atoi(fds_str);
+	for (int i = 0; i < cnt; i++) {
+		std::string name = (i < (int)names.size()) ? names[i] : "";
+		if (!adoptListener(nsjconf, 3 + i, name)) {
+			return false;
+		}
+	}
+	/* Not for the jails */
+	unsetenv("LISTEN_PID");
+	unsetenv("LISTEN_FDS");
+	unsetenv("LISTEN_FDNAMES");
+	return true;
+}
+
+/* Sockets left open by the previous nsjail binary: 'fd=name:fd=name...', see upgrade.cc */
+static bool inheritUpgradeListeners(nsjconf_t* nsjconf) {
+	const char* fds_str = getenv(kListenFdsEnv);
+	if (fds_str == NULL) {
+		return true;
+	}
+	for (const auto& s : util::strSplit(fds_str, ':')) {
+		size_t pos = s.find('=');
+		if (pos == std::string::npos) {
+			LOG_E("Invalid %s entry: '%s'", kListenFdsEnv, s.c_str());
+			return false;
+		}
+		if (!adoptListener(nsjconf, atoi(s.substr(0, pos).c_str()), s.substr(pos + 1))) {
+			return false;
+		}
+	}
+	unsetenv(kListenFdsEnv);
+	return true;
+}
+
+std::vector<listener_t> configuredListeners(nsjconf_t* nsjconf) {
+	std::vector<listener_t> res = nsjconf->listeners;
+	if (nsjconf->port != 0) {
+		res.insert(res.begin(), {"", nsjconf->bindhost, nsjconf->port, "", "", {}, "", -1});
+	}
+	return res;
+}
+
+static const std::string& listenerHost(nsjconf_t* nsjconf, const listener_t& l) {
+	return l.bindhost.empty() ? nsjconf->bindhost : l.bindhost;
+}
+
+bool sameListener(nsjconf_t* nsjconf, const listener_t& a, const listener_t& b) {
+	return a.name == b.name && a.unix_path == b.unix_path && a.port == b.port &&
+	       listenerHost(nsjconf, a) == listenerHost(nsjconf, b);
+}
+
+const std::string listenerText(nsjconf_t* nsjconf, const listener_t& l) {
+	std::string res = l.name.empty() ? "" : ("'" + l.name + "' ");
+	if (!l.unix_path.empty()) {
+		return res + "[unix:" + l.unix_path + "]";
+	}
+	if (l.port == 0) {
+		return res + "[inherited]";
+	}
+	return res + "[" + listenerHost(nsjconf, l) + "]:" + std::to_string(l.port);
+}
+
+bool initListeners(nsjconf_t* nsjconf) {
+	nsjconf->listeners = configuredListeners(nsjconf);
+	if (!inheritSystemdListeners(nsjconf) || !inheritUpgradeListeners(nsjconf)) {
+		return false;
+	}
+	/* Jails can be started over the control_socket alone */
+	if (nsjconf->listeners.empty() && nsjconf->control_socket.empty()) {
+		nsjconf->listeners.push_back(
+		    {"", nsjconf->bindhost, nsjconf->port, "", "", {}, "", -1});
+	}
+	for (auto& l : nsjconf->listeners) {
+		if (l.fd != -1) {
+			continue;
+		}
+		if (l.unix_path.empty() && l.port == 0) {
+			LOG_E("Listener '%s' has neither a port nor a unix_path, and no such "
+			      "socket was passed in LISTEN_FDS",
+			    l.name.c_str());
+			return false;
+		}
+		if (!l.unix_path.empty()) {
+			l.fd = getRecvUnixSocket(l.unix_path.c_str());
+		} else {
+			l.fd = getRecvSocket(
+			    l.bindhost.empty() ? nsjconf->bindhost.c_str() : l.bindhost.c_str(),
+			    l.port);
+		}
+		if (l.fd == -1) {
+			return false;
+		}
+	}
+	return true;
+}
+
 int acceptConn(int listenfd) {
 	struct sockaddr_in6 cli_addr;
 	socklen_t socklen = sizeof(cli_addr);
@@ -256,6 +1292,25 @@ int acceptConn(int listenfd) {
 	return connfd;
 }
 
+/* Peers connected over AF_UNIX have no names, their credentials identify them better */
+static const std::string unixConnToText(
+    int fd, bool remote, const struct sockaddr_un* addr, socklen_t addrlen) {
+	if (remote) {
+		struct ucred cred;
+		socklen_t credlen = sizeof(cred);
+		if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) == -1) {
+			PLOG_W("getsockopt(%d, SO_PEERCRED)", fd);
+			return "[unix:unknown]";
+		}
+		return "[unix:pid=" + std::to_string(cred.pid) +
+		       ",uid=" + std::to_string(cred.uid) + "]";
+	}
+	if (addrlen <= offsetof(struct sockaddr_un, sun_path) || addr->sun_path[0] == '\0') {
+		return "[unix]";
+	}
+	return std::string("[unix:") + addr->sun_path + "]";
+}
+
 const std::string connToText(int fd, bool remote, struct sockaddr_in6* addr_or_null) {
 	std::string res;
 
@@ -263,20 +1318,30 @@ const std::string connToText(int fd, bool remote, struct sockaddr_in6* addr_or_n
 		return "[STANDALONE MODE]";
 	}
 
-	struct sockaddr_in6 addr;
-	socklen_t addrlen = sizeof(addr);
+	struct sockaddr_storage ss;
+	socklen_t addrlen = sizeof(ss);
 	if (remote) {
-		if (getpeername(fd, (struct sockaddr*)&addr, &addrlen) == -1) {
+		if (getpeername(fd, (struct sockaddr*)&ss, &addrlen) == -1) {
 			PLOG_W("getpeername(%d)", fd);
 			return "[unknown]";
 		}
 	} else {
-		if (getsockname(fd, (struct sockaddr*)&addr, &addrlen) == -1) {
+		if (getsockname(fd, (struct sockaddr*)&ss, &addrlen) == -1) {
 			PLOG_W("getsockname(%d)", fd);
 			return "[unknown]";
 		}
 	}
 
+	if (ss.ss_family == AF_UNIX) {
+		if (addr_or_null) {
+			memset(addr_or_null, '\0', sizeof(*addr_or_null));
+			addr_or_null->sin6_family = AF_UNIX;
+		}
+		return unixConnToText(fd, remote, (const struct sockaddr_un*)&ss, addrlen);
+	}
+
+	struct sockaddr_in6 addr;
+	memcpy(&addr, &ss, sizeof(addr));
 	if (addr_or_null) {
 		memcpy(addr_or_null, &addr, sizeof(*addr_or_null));
 	}
@@ -294,140 +1359,61 @@ const std::string connToText(int fd, bool remote, struct sockaddr_in6* addr_or_n
 	return res;
 }
 
-static bool ifaceUp(const char* ifacename) {
-	int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
-	if (sock == -1) {
-		PLOG_E("socket(AF_INET, SOCK_STREAM, IPPROTO_IP)");
-		return false;
-	}
-
-	struct ifreq ifr;
-	memset(&ifr, '\0', sizeof(ifr));
-	snprintf(ifr.ifr_name, IF_NAMESIZE, "%s", ifacename);
-
-	if (ioctl(sock, SIOCGIFFLAGS, &ifr) == -1) {
-		PLOG_E("ioctl(iface='%s', SIOCGIFFLAGS, IFF_UP)", ifacename);
-		close(sock);
-		return false;
-	}
-
-	ifr.ifr_flags |= (IFF_UP | IFF_RUNNING);
-
-	if (ioctl(sock, SIOCSIFFLAGS, &ifr) == -1) {
-		PLOG_E("ioctl(iface='%s', SIOCSIFFLAGS, IFF_UP|IFF_RUNNING)", ifacename);
-		close(sock);
-		return false;
+/*
+ * Brings 'lo' up, and configures addresses, link state and default routes of 'vs', with a single
+ * batch of rtnetlink requests. Interfaces taken from the pool were configured by the supervisor
+ */
+bool initNsFromChild(nsjconf_t* nsjconf) {
+	if (!nsjconf->clone_newnet) {
+		return true;
 	}
 
-	close(sock);
-	return true;
-}
-
-static bool netConfigureVs(nsjconf_t* nsjconf) {
-	struct ifreq ifr;
-	memset(&ifr, '\0', sizeof(ifr));
-	snprintf(ifr.ifr_name, IF_NAMESIZE, "%s", IFACE_NAME);
-	struct in_addr addr;
-
-	int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
-	if (sock == -1) {
-		PLOG_E("socket(AF_INET, SOCK_STREAM, IPPROTO_IP)");
+	vsConf_t vs;
+	bool has_vs = !nsjconf->iface_vs.empty() && nsjconf->macvlan_pool_size == 0;
+	if (has_vs && !parseVsConf(nsjconf, &vs)) {
 		return false;
 	}
-
-	if (inet_pton(AF_INET, nsjconf->iface_vs_ip.c_str(), &addr) != 1) {
-		PLOG_E("Cannot convert '%s' into an IPv4 address", nsjconf->iface_vs_ip.c_str());
-		close(sock);
-		return false;
+	if (has_vs && !hasIp(vs) && !hasIp6(vs)) {
+		LOG_D("IP address for interface '%s' not set", IFACE_NAME);
+		has_vs = false;
 	}
-	if (addr.s_addr == INADDR_ANY) {
-		LOG_D("IPv4 address for interface '%s' not set", IFACE_NAME);
-		close(sock);
+	/* A MACVLAN interface created for this jail alone is shaped from within its namespace */
+	bool shape_vs = !nsjconf->iface_vs.empty() && nsjconf->macvlan_pool_size == 0;
+	if (!nsjconf->iface_lo && !has_vs && !(shape_vs && nsjconf->net_egress_rate > 0)) {
 		return true;
 	}
 
-	struct sockaddr_in* sa = (struct sockaddr_in*)(&ifr.ifr_addr);
-	sa->sin_family = AF_INET;
-	sa->sin_addr = addr;
-	if (ioctl(sock, SIOCSIFADDR, &ifr) == -1) {
-		PLOG_E("ioctl(iface='%s', SIOCSIFADDR, '%s')", IFACE_NAME,
-		    nsjconf->iface_vs_ip.c_str());
-		close(sock);
+	int sock = nl::openSocket();
+	if (sock == -1) {
 		return false;
 	}
 
-	if (inet_pton(AF_INET, nsjconf->iface_vs_nm.c_str(), &addr) != 1) {
-		PLOG_E("Cannot convert '%s' into a IPv4 netmask", nsjconf->iface_vs_nm.c_str());
-		close(sock);
-		return false;
-	}
-	sa->sin_family = AF_INET;
-	sa->sin_addr = addr;
-	if (ioctl(sock, SIOCSIFNETMASK, &ifr) == -1) {
-		PLOG_E("ioctl(iface='%s', SIOCSIFNETMASK, '%s')", IFACE_NAME,
-		    nsjconf->iface_vs_nm.c_str());
-		close(sock);
-		return false;
-	}
+	nl::msg_t msgs[7];
+	nl::msg_t* batch[ARR_SZ(msgs)];
+	size_t cnt = 0;
 
-	if (!ifaceUp(IFACE_NAME)) {
-		close(sock);
-		return false;
+	if (nsjconf->iface_lo) {
+		int lo_idx;
+		if (!ifaceIndex(sock, "lo", &lo_idx)) {
+			close(sock);
+			return false;
+		}
+		msgIfaceUp(&msgs[cnt], lo_idx, "set 'lo' up");
+		batch[cnt] = &msgs[cnt];
+		cnt++;
 	}
-
-	if (inet_pton(AF_INET, nsjconf->iface_vs_gw.c_str(), &addr) != 1) {
-		PLOG_E("Cannot convert '%s' into a IPv4 GW address", nsjconf->iface_vs_gw.c_str());
+	if (has_vs && !addVsMsgs(sock, vs, msgs, batch, &cnt)) {
 		close(sock);
 		return false;
 	}
-	if (addr.s_addr == INADDR_ANY) {
-		LOG_D("Gateway address for '%s' is not set", IFACE_NAME);
-		close(sock);
-		return true;
-	}
-
-	struct rtentry rt;
-	memset(&rt, '\0', sizeof(rt));
-
-	struct sockaddr_in* sdest = (struct sockaddr_in*)(&rt.rt_dst);
-	struct sockaddr_in* smask = (struct sockaddr_in*)(&rt.rt_genmask);
-	struct sockaddr_in* sgate = (struct sockaddr_in*)(&rt.rt_gateway);
-	sdest->sin_family = AF_INET;
-	sdest->sin_addr.s_addr = INADDR_ANY;
-	smask->sin_family = AF_INET;
-	smask->sin_addr.s_addr = INADDR_ANY;
-	sgate->sin_family = AF_INET;
-	sgate->sin_addr = addr;
-
-	rt.rt_flags = RTF_UP | RTF_GATEWAY;
-	char rt_dev[] = IFACE_NAME;
-	rt.rt_dev = rt_dev;
-
-	if (ioctl(sock, SIOCADDRT, &rt) == -1) {
-		PLOG_E("ioctl(SIOCADDRT, '%s')", nsjconf->iface_vs_gw.c_str());
+	if (shape_vs && !addEgressMsg(nsjconf, sock, msgs, batch, &cnt)) {
 		close(sock);
 		return false;
 	}
 
+	bool ret = nl::transact(sock, batch, cnt);
 	close(sock);
-	return true;
-}
-
-bool initNsFromChild(nsjconf_t* nsjconf) {
-	if (!nsjconf->clone_newnet) {
-		return true;
-	}
-	if (nsjconf->iface_lo) {
-		if (!ifaceUp("lo")) {
-			return false;
-		}
-	}
-	if (!nsjconf->iface_vs.empty()) {
-		if (!netConfigureVs(nsjconf)) {
-			return false;
-		}
-	}
-	return true;
+	return ret;
 }
 
 }  // namespace net
@@ -24,19 +24,35 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 #include <string>
+#include <vector>
 
 #include "nsjail.h"
 
 namespace net {
 
+/* Listening sockets passed over execve(), see upgrade.cc */
+static const char kListenFdsEnv[] = "NSJAIL_LISTEN_FDS";
+
+bool init(nsjconf_t* nsjconf);
 bool limitConns(nsjconf_t* nsjconf, int connsock);
 int getRecvSocket(const char* bindhost, int port);
+int getRecvUnixSocket(const char* path);
+const std::string listenerName(nsjconf_t* nsjconf, size_t idx);
+/* Listeners of a parsed configuration, together with the one for 'port' */
+std::vector<listener_t> configuredListeners(nsjconf_t* nsjconf);
+/* Same name and same address, i.e. the socket of one can be used for the other */
+bool sameListener(nsjconf_t* nsjconf, const listener_t& a, const listener_t& b);
+const std::string listenerText(nsjconf_t* nsjconf, const listener_t& l);
+bool initListeners(nsjconf_t* nsjconf);
 int acceptConn(int listenfd);
 const std::string connToText(int fd, bool remote, struct sockaddr_in6* addr_or_null);
 bool initNsFromParent(nsjconf_t* nsjconf, int pid);
 bool initNsFromChild(nsjconf_t* nsjconf);
+const std::string statsToText(nsjconf_t* nsjconf, pid_t pid);
+void releaseNs(nsjconf_t* nsjconf, pid_t pid);
 
 }  // namespace net
 
@@ -0,0 +1,209 @@
+/*
+
+   nsjail - rtnetlink routines
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "nl.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "logs.h"
+
+namespace nl {
+
+static uint8_t* msgTail(msg_t* msg) {
+	return (uint8_t*)&msg->hdr + NLMSG_ALIGN(msg->hdr.nlmsg_len);
+}
+
+int openSocket(void) {
+	int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (sock == -1) {
+		PLOG_E("socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE)");
+		return -1;
+	}
+	struct sockaddr_nl sa;
+	memset(&sa, '\0', sizeof(sa));
+	sa.nl_family = AF_NETLINK;
+	if (bind(sock, (struct sockaddr*)&sa, sizeof(sa)) == -1) {
+		PLOG_E("bind(AF_NETLINK)");
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+void initMsg(msg_t* msg, uint16_t type, uint16_t flags, const void* hdr, size_t hdrlen,
+    const char* descr) {
+	memset(msg, '\0', sizeof(*msg));
+	msg->hdr.nlmsg_len = NLMSG_LENGTH(hdrlen);
+	msg->hdr.nlmsg_type = type;
+	msg->hdr.nlmsg_flags = NLM_F_REQUEST | flags;
+	memcpy(NLMSG_DATA(&msg->hdr), hdr, hdrlen);
+	msg->descr = descr;
+}
+
+bool addAttr(msg_t* msg, uint16_t type, const void* data, size_t len) {
+	size_t newlen = NLMSG_ALIGN(msg->hdr.nlmsg_len) + RTA_SPACE(len);
+	if (newlen > sizeof(msg->hdr) + sizeof(msg->payload)) {
+		LOG_E("Netlink message '%s' too long (%zu bytes)", msg->descr, newlen);
+		return false;
+	}
+	struct rtattr* rta = (struct rtattr*)msgTail(msg);
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len) {
+		memcpy(RTA_DATA(rta), data, len);
+	}
+	msg->hdr.nlmsg_len = newlen;
+	return true;
+}
+
+bool addAttrU32(msg_t* msg, uint16_t type, uint32_t val) {
+	return addAttr(msg, type, &val, sizeof(val));
+}
+
+bool addAttrStr(msg_t* msg, uint16_t type, const char* str) {
+	return addAttr(msg, type, str, strlen(str) + 1);
+}
+
+/* Raw data, e.g. a nested message header (VETH_INFO_PEER) */
+bool addData(msg_t* msg, const void* data, size_t len) {
+	size_t newlen = NLMSG_ALIGN(msg->hdr.nlmsg_len) + NLMSG_ALIGN(len);
+	if (newlen > sizeof(msg->hdr) + sizeof(msg->payload)) {
+		LOG_E("Netlink message '%s' too long (%zu bytes)", msg->descr, newlen);
+		return false;
+	}
+	memcpy(msgTail(msg), data, len);
+	msg->hdr.nlmsg_len = newlen;
+	return true;
+}
+
+struct rtattr* nestStart(msg_t* msg, uint16_t type) {
+	struct rtattr* nest = (struct rtattr*)msgTail(msg);
+	if (!addAttr(msg, type, NULL, 0)) {
+		return NULL;
+	}
+	return nest;
+}
+
+void nestEnd(msg_t* msg, struct rtattr* nest) {
+	nest->rta_len = msgTail(msg) - (uint8_t*)nest;
+}
+
+/*
+ * Sends all messages with a single sendmsg(), and waits for the kernel to acknowledge each one
+ * of them. Returns false if any of them failed
+ */
+static uint32_t seq = 0;
+
+bool transact(int sock, msg_t* const msgs[], size_t cnt) {
+	uint32_t first_seq = seq + 1;
+	std::vector<struct iovec> iov(cnt);
+	for (size_t i = 0; i < cnt; i++) {
+		msgs[i]->hdr.nlmsg_seq = ++seq;
+		msgs[i]->hdr.nlmsg_flags |= NLM_F_ACK;
+		iov[i].iov_base = &msgs[i]->hdr;
+		iov[i].iov_len = msgs[i]->hdr.nlmsg_len;
+	}
+
+	struct sockaddr_nl sa;
+	memset(&sa, '\0', sizeof(sa));
+	sa.nl_family = AF_NETLINK;
+	struct msghdr mh;
+	memset(&mh, '\0', sizeof(mh));
+	mh.msg_name = &sa;
+	mh.msg_namelen = sizeof(sa);
+	mh.msg_iov = iov.data();
+	mh.msg_iovlen = cnt;
+	if (TEMP_FAILURE_RETRY(sendmsg(sock, &mh, 0)) == -1) {
+		PLOG_E("sendmsg(NETLINK_ROUTE, '%s')", msgs[0]->descr);
+		return false;
+	}
+
+	bool ret = true;
+	for (size_t acked = 0; acked < cnt;) {
+		uint8_t buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+		int len = TEMP_FAILURE_RETRY(recv(sock, buf, sizeof(buf), 0));
+		if (len == -1) {
+			PLOG_E("recv(NETLINK_ROUTE)");
+			return false;
+		}
+		for (struct nlmsghdr* nh = (struct nlmsghdr*)buf; NLMSG_OK(nh, (unsigned)len);
+		     nh = NLMSG_NEXT(nh, len)) {
+			/* Skip leftovers of earlier, abandoned, requests */
+			if (nh->nlmsg_seq < first_seq || nh->nlmsg_seq >= first_seq + cnt) {
+				continue;
+			}
+			if (nh->nlmsg_type != NLMSG_ERROR) {
+				continue;
+			}
+			acked++;
+			const struct nlmsgerr* err = (const struct nlmsgerr*)NLMSG_DATA(nh);
+			if (err->error != 0) {
+				errno = -err->error;
+				PLOG_E("Netlink request '%s' failed",
+				    msgs[nh->nlmsg_seq - first_seq]->descr);
+				ret = false;
+			}
+		}
+	}
+	return ret;
+}
+
+/*
+ * Sends a single request (e.g. RTM_GETLINK) and copies the kernel's reply into 'reply'. Returns
+ * the length of the reply, or -1 if the request failed
+ */
+ssize_t query(int sock, msg_t* msg, void* reply, size_t replylen) {
+	msg->hdr.nlmsg_seq = ++seq;
+	if (TEMP_FAILURE_RETRY(send(sock, &msg->hdr, msg->hdr.nlmsg_len, 0)) == -1) {
+		PLOG_E("send(NETLINK_ROUTE, '%s')", msg->descr);
+		return -1;
+	}
+	for (;;) {
+		ssize_t len = TEMP_FAILURE_RETRY(recv(sock, reply, replylen, 0));
+		if (len == -1) {
+			PLOG_E("recv(NETLINK_ROUTE)");
+			return -1;
+		}
+		const struct nlmsghdr* nh = (const struct nlmsghdr*)reply;
+		if (!NLMSG_OK(nh, (size_t)len)) {
+			LOG_E("Truncated reply to netlink request '%s'", msg->descr);
+			return -1;
+		}
+		/* Skip leftovers of earlier, abandoned, requests */
+		if (nh->nlmsg_seq != msg->hdr.nlmsg_seq) {
+			continue;
+		}
+		if (nh->nlmsg_type == NLMSG_ERROR) {
+			errno = -((const struct nlmsgerr*)NLMSG_DATA(nh))->error;
+			PLOG_E("Netlink request '%s' failed", msg->descr);
+			return -1;
+		}
+		return len;
+	}
+}
+
+}  // namespace nl
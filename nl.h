@@ -0,0 +1,55 @@
+/*
+
+   nsjail - rtnetlink routines
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#ifndef NS_NL_H
+#define NS_NL_H
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace nl {
+
+/* A single rtnetlink request; the payload directly follows the header */
+struct msg_t {
+	struct nlmsghdr hdr;
+	uint8_t payload[1024];
+	const char* descr;
+} __attribute__((aligned(NLMSG_ALIGNTO)));
+
+int openSocket(void);
+void initMsg(msg_t* msg, uint16_t type, uint16_t flags, const void* hdr, size_t hdrlen,
+    const char* descr);
+bool addAttr(msg_t* msg, uint16_t type, const void* data, size_t len);
+bool addAttrU32(msg_t* msg, uint16_t type, uint32_t val);
+bool addAttrStr(msg_t* msg, uint16_t type, const char* str);
+bool addData(msg_t* msg, const void* data, size_t len);
+struct rtattr* nestStart(msg_t* msg, uint16_t type);
+void nestEnd(msg_t* msg, struct rtattr* nest);
+bool transact(int sock, msg_t* const msgs[], size_t cnt);
+ssize_t query(int sock, msg_t* msg, void* reply, size_t replylen);
+
+}  // namespace nl
+
+#endif /* NS_NL_H */
@@ -21,6 +21,8 @@
 
 #include "nsjail.h"
 
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -29,16 +31,27 @@
 #include <sys/time.h>
 #include <unistd.h>
 
+#include <vector>
+
+#include "batch.h"
 #include "cmdline.h"
+#include "control.h"
+#include "events.h"
 #include "logs.h"
 #include "macros.h"
 #include "net.h"
+#include "nspool.h"
+#include "portfwd.h"
+#include "reload.h"
 #include "sandbox.h"
 #include "subproc.h"
+#include "upgrade.h"
 #include "util.h"
 
 static __thread int nsjailSigFatal = 0;
 static __thread bool nsjailShowProc = false;
+static __thread bool nsjailUpgrade = false;
+static __thread bool nsjailReload = false;
 
 static void nsjailSig(int sig) {
 	if (sig == SIGALRM) {
@@ -51,6 +64,14 @@ static void nsjailSig(int sig) {
 		nsjailShowProc = true;
 		return;
 	}
+	if (sig == SIGHUP) {
+		nsjailReload = true;
+		return;
+	}
+	if (sig == SIGUSR2) {
+		nsjailUpgrade = true;
+		return;
+	}
 	nsjailSigFatal = sig;
 }
 
@@ -66,7 +87,8 @@ static bool nsjailSetSigHandler(int sig) {
 	sa.sa_flags = 0;
 	sa.sa_restorer = NULL;
 
-	if (sig == SIGTTIN || sig == SIGTTOU) {
+	/* SIGPIPE: writes to a pipe whose reader went away (e.g. event_stream) fail with EPIPE */
+	if (sig == SIGTTIN || sig == SIGTTOU || sig == SIGPIPE) {
 		sa.sa_handler = SIG_IGN;
 	};
 	if (sigaction(sig, &sa, NULL) == -1) {
@@ -109,49 +131,86 @@ static bool nsjailSetTimer(nsjconf_t* nsjconf) {
 	return true;
 }
 
-static void nsjailListenMode(nsjconf_t* nsjconf) {
-	int listenfd = net::getRecvSocket(nsjconf->bindhost.c_str(), nsjconf->port);
-	if (listenfd == -1) {
-		return;
+/* New jails are started with the new snapshot once it's ready, see reload.cc */
+static void nsjailCheckReload(std::shared_ptr<nsjconf_t>* nsjconf) {
+	if (nsjailReload) {
+		nsjailReload = false;
+		reload::start(nsjconf->get());
+	}
+	std::shared_ptr<nsjconf_t> next = reload::collect(nsjconf->get());
+	if (next) {
+		*nsjconf = next;
 	}
+}
+
+static void nsjailListenMode(std::shared_ptr<nsjconf_t> nsjconf) {
+	const size_t nlisteners = nsjconf->listeners.size();
 	for (;;) {
 		if (nsjailSigFatal > 0) {
-			subproc::killAll(nsjconf);
+			subproc::killAll(nsjconf.get());
 			logs::logStop(nsjailSigFatal);
-			close(listenfd);
+			for (const auto& l : nsjconf->listeners) {
+				close(l.fd);
+			}
 			return;
 		}
 		if (nsjailShowProc) {
 			nsjailShowProc = false;
-			subproc::displayProc(nsjconf);
+			subproc::displayProc(nsjconf.get());
 		}
-		int connfd = net::acceptConn(listenfd);
-		if (connfd >= 0) {
-			subproc::runChild(nsjconf, connfd, connfd, connfd);
-			close(connfd);
+		if (nsjailUpgrade) {
+			nsjailUpgrade = false;
+			upgrade::exec(nsjconf.get());
 		}
-		subproc::reapProc(nsjconf);
+		nsjailCheckReload(&nsjconf);
+		std::vector<struct pollfd> pfds;
+		for (const auto& l : nsjconf->listeners) {
+			pfds.push_back({l.fd, POLLIN, 0});
+		}
+		/* Its clients come and go */
+		control::addPollFds(&pfds);
+		/* Interrupted by SIGALRM every second at most */
+		if (poll(pfds.data(), pfds.size(), -1) > 0) {
+			for (size_t i = 0; i < nlisteners; i++) {
+				if (pfds[i].revents == 0) {
+					continue;
+				}
+				int connfd = net::acceptConn(pfds[i].fd);
+				if (connfd >= 0) {
+					subproc::runChild(nsjconf.get(), &nsjconf->listeners[i],
+					    connfd, connfd, connfd);
+					close(connfd);
+				}
+			}
+			control::handleEvents(
+			    nsjconf.get(), pfds.data() + nlisteners, pfds.size() - nlisteners);
+		}
+		std::vector<subproc::reaped_t> reaped;
+		subproc::reapProc(nsjconf.get(), &reaped);
+		control::collect(reaped);
 	}
 }
 
-static int nsjailStandaloneMode(nsjconf_t* nsjconf) {
-	subproc::runChild(nsjconf, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO);
+static int nsjailStandaloneMode(std::shared_ptr<nsjconf_t> nsjconf) {
+	subproc::runChild(nsjconf.get(), NULL, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO);
 	for (;;) {
-		int child_status = subproc::reapProc(nsjconf);
+		int child_status = subproc::reapProc(nsjconf.get());
 
-		if (subproc::countProc(nsjconf) == 0) {
+		if (subproc::countProc(nsjconf.get()) == 0) {
 			if (nsjconf->mode == MODE_STANDALONE_ONCE) {
 				return child_status;
 			}
-			subproc::runChild(nsjconf, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO);
+			subproc::runChild(
+			    nsjconf.get(), NULL, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO);
 			continue;
 		}
 		if (nsjailShowProc) {
 			nsjailShowProc = false;
-			subproc::displayProc(nsjconf);
+			subproc::displayProc(nsjconf.get());
 		}
+		nsjailCheckReload(&nsjconf);
 		if (nsjailSigFatal > 0) {
-			subproc::killAll(nsjconf);
+			subproc::killAll(nsjconf.get());
 			logs::logStop(nsjailSigFatal);
 			return -1;
 		}
@@ -161,15 +220,63 @@ static int nsjailStandaloneMode(nsjconf_t* nsjconf) {
 	// not reached
 }
 
+static int nsjailBatchMode(std::shared_ptr<nsjconf_t> nsjconf) {
+	if (!batch::init(nsjconf.get())) {
+		return 0xff;
+	}
+	sigset_t smask, orig_smask;
+	sigemptyset(&smask);
+	sigaddset(&smask, SIGCHLD);
+	for (;;) {
+		/* With SIGCHLD unblocked, new jails inherit the signal mask */
+		batch::schedule(nsjconf.get());
+
+		pthread_sigmask(SIG_BLOCK, &smask, &orig_smask);
+		std::vector<subproc::reaped_t> reaped;
+		subproc::reapProc(nsjconf.get(), &reaped);
+		batch::collect(reaped);
+		if (batch::done()) {
+			pthread_sigmask(SIG_SETMASK, &orig_smask, NULL);
+			return batch::finish(nsjconf.get());
+		}
+		if (nsjailShowProc) {
+			nsjailShowProc = false;
+			subproc::displayProc(nsjconf.get());
+		}
+		if (nsjailSigFatal > 0) {
+			subproc::killAll(nsjconf.get());
+			logs::logStop(nsjailSigFatal);
+			batch::finish(nsjconf.get());
+			return -1;
+		}
+		/* A jail which exited after reapProc() ends the wait right away */
+		if (reaped.empty()) {
+			sigsuspend(&orig_smask);
+		}
+		pthread_sigmask(SIG_SETMASK, &orig_smask, NULL);
+	}
+	// not reached
+}
+
 int main(int argc, char* argv[]) {
-	std::unique_ptr<nsjconf_t> nsjconf = cmdline::parseArgs(argc, argv);
+	upgrade::init(argc, argv);
+	reload::init(argc, argv);
+	std::shared_ptr<nsjconf_t> nsjconf = reload::makeSnapshot(cmdline::parseArgs(argc, argv));
 	if (!nsjconf) {
 		LOG_F("Couldn't parse cmdline options");
 	}
+	/* Before daemon(), as inherited sockets are bound to the current PID */
+	if (nsjconf->mode == MODE_LISTEN_TCP && !net::initListeners(nsjconf.get())) {
+		LOG_F("Couldn't set up listening sockets");
+	}
+	if (!control::init(nsjconf.get())) {
+		LOG_F("Couldn't set up the control socket");
+	}
 	if (!nsjconf->clone_newuser && geteuid() != 0) {
 		LOG_W("--disable_clone_newuser might require root() privs");
 	}
-	if (nsjconf->daemonize && (daemon(0, 0) == -1)) {
+	/* Already daemonized before the in-place upgrade */
+	if (nsjconf->daemonize && !upgrade::isResumed() && (daemon(0, 0) == -1)) {
 		PLOG_F("daemon");
 	}
 	cmdline::logParams(nsjconf.get());
@@ -179,17 +286,32 @@ int main(int argc, char* argv[]) {
 	if (!nsjailSetTimer(nsjconf.get())) {
 		LOG_F("nsjailSetTimer() failed");
 	}
+	if (!events::init(nsjconf.get())) {
+		LOG_F("Couldn't open the event stream");
+	}
 	if (!sandbox::preparePolicy(nsjconf.get())) {
 		LOG_F("Couldn't prepare sandboxing policy");
 	}
+	if (!net::init(nsjconf.get())) {
+		LOG_F("Couldn't initialize networking");
+	}
+	if (!nspool::init(nsjconf.get())) {
+		LOG_F("Couldn't prepare the namespace pool");
+	}
+	if (!portfwd::init(nsjconf.get())) {
+		LOG_F("Couldn't set up port forwarding");
+	}
+	if (!upgrade::restoreJails(nsjconf.get())) {
+		LOG_F("Couldn't restore the state after an in-place upgrade");
+	}
 
 	int ret = 0;
 	if (nsjconf->mode == MODE_LISTEN_TCP) {
-		nsjailListenMode(nsjconf.get());
+		nsjailListenMode(std::move(nsjconf));
+	} else if (nsjconf->mode == MODE_STANDALONE_BATCH) {
+		ret = nsjailBatchMode(std::move(nsjconf));
 	} else {
-		ret = nsjailStandaloneMode(nsjconf.get());
+		ret = nsjailStandaloneMode(std::move(nsjconf));
 	}
-
-	sandbox::closePolicy(nsjconf.get());
 	return ret;
 }
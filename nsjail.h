@@ -32,6 +32,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -39,21 +40,31 @@
 
 static const int nssigs[] = {
     SIGINT,
+    SIGHUP,
     SIGQUIT,
     SIGUSR1,
+    SIGUSR2,
     SIGALRM,
     SIGCHLD,
     SIGTERM,
     SIGTTIN,
     SIGTTOU,
+    SIGPIPE,
 };
 
+struct nsjconf_t;
+
 struct pids_t {
 	pid_t pid;
 	time_t start;
 	std::string remote_txt;
 	struct sockaddr_in6 remote_addr;
-	int pid_syscall_fd;
+	/* Configuration snapshot the jail was started with, see reload.cc */
+	std::shared_ptr<nsjconf_t> conf;
+	/* Phase timings for the event stream: CLOCK_MONOTONIC at clone(), durations in usecs */
+	uint64_t start_us;
+	uint64_t clone_us;
+	uint64_t setup_us;
 };
 
 struct mount_t {
@@ -66,9 +77,17 @@ struct mount_t {
 	bool is_dir;
 	bool is_symlink;
 	bool is_mandatory;
+	bool is_idmapped;
+	int idmap_fd;
 	bool mounted;
 };
 
+struct tmpfs_t {
+	uint64_t size;
+	uint64_t nr_inodes;
+	std::string huge;
+};
+
 struct idmap_t {
 	uid_t inside_id;
 	uid_t outside_id;
@@ -76,14 +95,53 @@ struct idmap_t {
 	bool is_newidmap;
 };
 
+struct listener_t {
+	std::string name;
+	std::string bindhost;
+	int port;
+	std::string unix_path;
+	/* Empty means: use the main exec_file/argv */
+	std::string exec_file;
+	std::vector<std::string> argv;
+	/* Name of a seccomp_named_policy, empty means: use the main seccomp policy */
+	std::string seccomp_policy;
+	int fd;
+};
+
+enum notify_action_t {
+	NOTIFY_LOG = 0,
+	NOTIFY_ALLOW,
+	NOTIFY_DENY,
+};
+
+/* A syscall handled by the supervisor via SECCOMP_RET_USER_NOTIF, see unotify.cc */
+struct notify_t {
+	uint32_t nr;
+	enum notify_action_t action;
+	/* NOTIFY_ALLOW: only if args[arg_index] == arg_value, if arg_index >= 0 */
+	int arg_index;
+	uint64_t arg_value;
+	int deny_errno;
+};
+
+/* A seccomp policy compiled at startup, which listeners can select by name, see sandbox.cc */
+struct seccomp_policy_t {
+	std::string name;
+	std::string kafel_file_path;
+	std::string kafel_string;
+	struct sock_fprog fprog;
+};
+
 enum ns_mode_t {
 	MODE_LISTEN_TCP = 0,
 	MODE_STANDALONE_ONCE,
 	MODE_STANDALONE_EXECVE,
-	MODE_STANDALONE_RERUN
+	MODE_STANDALONE_RERUN,
+	MODE_STANDALONE_BATCH
 };
 
-struct nsjconf_t {
+struct nsjconf_t : std::enable_shared_from_this<nsjconf_t> {
+	std::string name;
 	std::string exec_file;
 	bool use_execveat;
 	int exec_fd;
@@ -94,6 +152,13 @@ struct nsjconf_t {
 	int port;
 	std::string bindhost;
 	std::string logfile;
+	std::string event_stream;
+	/* MODE_STANDALONE_BATCH, see batch.cc */
+	std::string batch_manifest;
+	size_t batch_parallelism;
+	std::string batch_results;
+	/* MODE_LISTEN_TCP, see control.cc */
+	std::string control_socket;
 	logs::llevel_t loglevel;
 	bool daemonize;
 	time_t tlimit;
@@ -116,6 +181,10 @@ struct nsjconf_t {
 	bool clone_newipc;
 	bool clone_newuts;
 	bool clone_newcgroup;
+	bool pool_newnet;
+	bool pool_newipc;
+	bool pool_newuts;
+	size_t ns_pool_size;
 	enum ns_mode_t mode;
 	bool is_root_rw;
 	bool is_silent;
@@ -124,10 +193,24 @@ struct nsjconf_t {
 	std::string proc_path;
 	bool is_proc_rw;
 	bool iface_lo;
+	bool net_none;
 	std::string iface_vs;
 	std::string iface_vs_ip;
 	std::string iface_vs_nm;
 	std::string iface_vs_gw;
+	std::string iface_vs_ip6;
+	unsigned int iface_vs_prefix6;
+	std::string iface_vs_gw6;
+	size_t macvlan_pool_size;
+	std::string veth_bridge;
+	std::string veth_cidr;
+	std::string veth_gw;
+	uint64_t net_egress_rate;
+	uint64_t net_egress_burst;
+	uint64_t net_ingress_rate;
+	uint64_t net_ingress_burst;
+	std::vector<std::string> port_forwards;
+	std::vector<listener_t> listeners;
 	std::string cgroup_mem_mount;
 	std::string cgroup_mem_parent;
 	size_t cgroup_mem_max;
@@ -142,10 +225,22 @@ struct nsjconf_t {
 	unsigned int cgroup_cpu_ms_per_sec;
 	std::string kafel_file_path;
 	std::string kafel_string;
+	std::string seccomp_cache_dir;
+	std::vector<seccomp_policy_t> seccomp_policies;
+	std::vector<uint32_t> seccomp_hot_syscalls;
+	std::vector<notify_t> seccomp_notify;
+	/* Kafel policy written from the syscalls the jails made, see unotify.cc */
+	std::string seccomp_profile_file;
 	struct sock_fprog seccomp_fprog;
+	/* With seccomp_notify: installed after the filter with the listener, see sandbox.cc */
+	struct sock_fprog seccomp_fprog_post;
 	long num_cpus;
 	uid_t orig_uid;
 	std::vector<mount_t> mountpts;
+	tmpfs_t tmpfs_root;
+	tmpfs_t tmpfs_scratch;
+	tmpfs_t tmpfs_mount;
+	bool skip_unused_scratch_tmpfs;
 	std::vector<pids_t> pids;
 	std::vector<idmap_t> uids;
 	std::vector<idmap_t> gids;
@@ -0,0 +1,326 @@
+/*
+
+   nsjail - pool of pre-created namespaces
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "nspool.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <net/if.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <vector>
+
+#include "logs.h"
+#include "macros.h"
+#include "net.h"
+#include "uts.h"
+
+namespace nspool {
+
+static struct {
+	const unsigned long nstype;
+	const char* const name;
+} const nsTypes[] = {
+    {CLONE_NEWNET, "net"},
+    {CLONE_NEWIPC, "ipc"},
+    {CLONE_NEWUTS, "uts"},
+};
+
+/* Namespaces of the supervisor, it returns to them after creating a jail */
+static int origFds[ARR_SZ(nsTypes)] = {-1, -1, -1};
+/* Ready to use namespaces, per type */
+static std::vector<int> freeFds[ARR_SZ(nsTypes)];
+/* Namespaces joined for the clone() which is in progress */
+static int curFds[ARR_SZ(nsTypes)] = {-1, -1, -1};
+/* Namespaces used by the running jails, indexed as nsTypes[] */
+static std::map<pid_t, std::vector<int>> usedFds;
+/* The empty net namespace shared by all jails with net_none */
+static int sharedNetFd = -1;
+static bool inSharedNet = false;
+
+bool isPooled(nsjconf_t* nsjconf, unsigned long nstype) {
+	switch (nstype) {
+	case CLONE_NEWNET:
+		return nsjconf->clone_newnet && (nsjconf->pool_newnet || nsjconf->net_none);
+	case CLONE_NEWIPC:
+		return nsjconf->clone_newipc && nsjconf->pool_newipc;
+	case CLONE_NEWUTS:
+		return nsjconf->clone_newuts && nsjconf->pool_newuts;
+	default:
+		return false;
+	}
+}
+
+static bool isSharedNet(nsjconf_t* nsjconf, size_t i) {
+	return nsTypes[i].nstype == CLONE_NEWNET && nsjconf->net_none;
+}
+
+static void restoreNs(size_t i) {
+	if (setns(origFds[i], nsTypes[i].nstype) == -1) {
+		PLOG_F("Couldn't return to the original %s namespace", nsTypes[i].name);
+	}
+}
+
+static int createNs(nsjconf_t* nsjconf, size_t i) {
+	if (unshare(nsTypes[i].nstype) == -1) {
+		PLOG_E("unshare(CLONE_NEW%s)", nsTypes[i].name);
+		return -1;
+	}
+
+	bool ret = true;
+	if (nsTypes[i].nstype == CLONE_NEWNET && !isSharedNet(nsjconf, i)) {
+		ret = net::initNsFromChild(nsjconf);
+	}
+	if (nsTypes[i].nstype == CLONE_NEWUTS) {
+		ret = uts::initNs(nsjconf);
+	}
+
+	int fd = -1;
+	if (ret) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "/proc/thread-self/ns/%s", nsTypes[i].name);
+		fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+		if (fd == -1) {
+			PLOG_E("open('%s', O_RDONLY|O_CLOEXEC)", path);
+		}
+	}
+	restoreNs(i);
+
+	LOG_D("Created a new %s namespace for the pool (fd=%d)", nsTypes[i].name, fd);
+	return fd;
+}
+
+/* Only 'lo' is present, so the jail didn't add or move in any interfaces */
+static bool isNetClean(int fd) {
+	if (setns(fd, CLONE_NEWNET) == -1) {
+		PLOG_W("setns(fd=%d, CLONE_NEWNET)", fd);
+		return false;
+	}
+
+	bool clean = false;
+	struct if_nameindex* ifs = if_nameindex();
+	if (ifs == NULL) {
+		PLOG_W("if_nameindex()");
+	} else {
+		clean = true;
+		for (struct if_nameindex* p = ifs; p->if_index != 0; p++) {
+			if (strcmp(p->if_name, "lo") != 0) {
+				clean = false;
+			}
+		}
+		if_freenameindex(ifs);
+	}
+
+	for (size_t i = 0; i < ARR_SZ(nsTypes); i++) {
+		if (nsTypes[i].nstype == CLONE_NEWNET) {
+			restoreNs(i);
+		}
+	}
+	return clean;
+}
+
+static bool isReusable(nsjconf_t* nsjconf, size_t i, int fd) {
+	/*
+	 * Pooled namespaces are owned by the supervisor's user namespace, so a jail running in its
+	 * own user namespace holds no capabilities over them. Without CLONE_NEWPID processes of
+	 * the previous jail might still live inside the namespace
+	 */
+	if (!nsjconf->clone_newuser || !nsjconf->clone_newpid) {
+		return false;
+	}
+	switch (nsTypes[i].nstype) {
+	case CLONE_NEWNET:
+		return isNetClean(fd);
+	case CLONE_NEWIPC:
+		/* SysV IPC objects and POSIX message queues outlive their creators */
+		return false;
+	case CLONE_NEWUTS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool init(nsjconf_t* nsjconf) {
+	bool pooled = false;
+	for (size_t i = 0; i < ARR_SZ(nsTypes); i++) {
+		pooled |= isPooled(nsjconf, nsTypes[i].nstype);
+	}
+	if (!pooled) {
+		return true;
+	}
+
+	if (nsjconf->mode == MODE_STANDALONE_EXECVE) {
+		LOG_E("Namespace pools are not supported in the MODE_STANDALONE_EXECVE mode");
+		return false;
+	}
+	if (isPooled(nsjconf, CLONE_NEWNET) &&
+	    (!nsjconf->iface_vs.empty() || !nsjconf->veth_bridge.empty())) {
+		LOG_E("Pooled net namespaces cannot be used together with MACVLAN or veth "
+		      "interfaces");
+		return false;
+	}
+	if (nsjconf->net_none && nsjconf->pool_newnet) {
+		LOG_E("net_none and pool_newnet cannot be used together");
+		return false;
+	}
+	if (isPooled(nsjconf, CLONE_NEWNET) && nsjconf->net_none && !nsjconf->clone_newuser) {
+		/* Otherwise a jail with capabilities could alter the namespace for all others */
+		LOG_E("net_none requires clone_newuser");
+		return false;
+	}
+	if (geteuid() != 0) {
+		LOG_E("Namespace pools require root privileges (setns() of pre-created "
+		      "namespaces)");
+		return false;
+	}
+
+	for (size_t i = 0; i < ARR_SZ(nsTypes); i++) {
+		if (!isPooled(nsjconf, nsTypes[i].nstype)) {
+			continue;
+		}
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "/proc/self/ns/%s", nsTypes[i].name);
+		origFds[i] = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+		if (origFds[i] == -1) {
+			PLOG_E("open('%s', O_RDONLY|O_CLOEXEC)", path);
+			return false;
+		}
+		if (isSharedNet(nsjconf, i)) {
+			sharedNetFd = createNs(nsjconf, i);
+			if (sharedNetFd == -1) {
+				return false;
+			}
+			LOG_D("Created the shared empty net namespace (fd=%d)", sharedNetFd);
+			continue;
+		}
+		for (size_t n = 0; n < nsjconf->ns_pool_size; n++) {
+			int fd = createNs(nsjconf, i);
+			if (fd == -1) {
+				return false;
+			}
+			freeFds[i].push_back(fd);
+		}
+		LOG_D("Pre-created %zu %s namespace(s)", freeFds[i].size(), nsTypes[i].name);
+	}
+	return true;
+}
+
+bool enter(nsjconf_t* nsjconf, unsigned long* flags) {
+	for (size_t i = 0; i < ARR_SZ(nsTypes); i++) {
+		if (!isPooled(nsjconf, nsTypes[i].nstype)) {
+			continue;
+		}
+		if (isSharedNet(nsjconf, i)) {
+			inSharedNet = true;
+			if (setns(sharedNetFd, CLONE_NEWNET) == -1) {
+				PLOG_E("setns(fd=%d, CLONE_NEWNET)", sharedNetFd);
+				leave(nsjconf, -1);
+				return false;
+			}
+			*flags &= ~(CLONE_NEWNET);
+			continue;
+		}
+
+		int fd;
+		if (freeFds[i].empty()) {
+			LOG_D("The pool of %s namespaces is empty, creating a new one",
+			    nsTypes[i].name);
+			fd = createNs(nsjconf, i);
+		} else {
+			fd = freeFds[i].back();
+			freeFds[i].pop_back();
+		}
+		if (fd == -1) {
+			leave(nsjconf, -1);
+			return false;
+		}
+		curFds[i] = fd;
+		if (setns(fd, nsTypes[i].nstype) == -1) {
+			PLOG_E("setns(fd=%d, CLONE_NEW%s)", fd, nsTypes[i].name);
+			leave(nsjconf, -1);
+			return false;
+		}
+		*flags &= ~(nsTypes[i].nstype);
+	}
+	return true;
+}
+
+void leave(nsjconf_t* nsjconf, pid_t pid) {
+	std::vector<int> fds(ARR_SZ(nsTypes), -1);
+	bool used = false;
+	for (size_t i = 0; i < ARR_SZ(nsTypes); i++) {
+		if (isSharedNet(nsjconf, i) && inSharedNet) {
+			restoreNs(i);
+			inSharedNet = false;
+			continue;
+		}
+		if (curFds[i] == -1) {
+			continue;
+		}
+		restoreNs(i);
+		if (pid == -1) {
+			/* Not used by any process, it's still clean */
+			freeFds[i].push_back(curFds[i]);
+		} else {
+			fds[i] = curFds[i];
+			used = true;
+		}
+		curFds[i] = -1;
+	}
+	if (used) {
+		usedFds[pid] = fds;
+	}
+}
+
+void release(nsjconf_t* nsjconf, pid_t pid) {
+	auto it = usedFds.find(pid);
+	if (it == usedFds.end()) {
+		return;
+	}
+	for (size_t i = 0; i < ARR_SZ(nsTypes); i++) {
+		int fd = it->second[i];
+		if (fd == -1) {
+			continue;
+		}
+		if (isReusable(nsjconf, i, fd)) {
+			LOG_D("Returning %s namespace (fd=%d) to the pool", nsTypes[i].name, fd);
+			freeFds[i].push_back(fd);
+			continue;
+		}
+		LOG_D("Discarding %s namespace (fd=%d) used by pid=%d", nsTypes[i].name, fd,
+		    (int)pid);
+		close(fd);
+		if (freeFds[i].size() < nsjconf->ns_pool_size) {
+			fd = createNs(nsjconf, i);
+			if (fd != -1) {
+				freeFds[i].push_back(fd);
+			}
+		}
+	}
+	usedFds.erase(it);
+}
+
+}  // namespace nspool
@@ -0,0 +1,40 @@
+/*
+
+   nsjail - pool of pre-created namespaces
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#ifndef NS_NSPOOL_H
+#define NS_NSPOOL_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "nsjail.h"
+
+namespace nspool {
+
+bool init(nsjconf_t* nsjconf);
+bool enter(nsjconf_t* nsjconf, unsigned long* flags);
+void leave(nsjconf_t* nsjconf, pid_t pid);
+void release(nsjconf_t* nsjconf, pid_t pid);
+bool isPooled(nsjconf_t* nsjconf, unsigned long nstype);
+
+}  // namespace nspool
+
+#endif /* NS_NSPOOL_H */
@@ -0,0 +1,392 @@
+/*
+
+   nsjail - forwarding of host ports into jails
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "portfwd.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/capability.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "caps.h"
+#include "logs.h"
+#include "macros.h"
+#include "net.h"
+#include "util.h"
+
+namespace portfwd {
+
+struct fwd_t {
+	int listenfd;
+	uint16_t host_port;
+	uint16_t jail_port;
+};
+
+static std::vector<fwd_t> fwds;
+
+/* Each forwarded connection takes a thread, two pipes and two sockets */
+static const size_t kMaxConns = 256;
+static pthread_mutex_t connsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t connsCond = PTHREAD_COND_INITIALIZER;
+static size_t connsCnt = 0;
+
+/*
+ * Net namespace of the jail which receives forwarded connections. The helper threads dup() it
+ * under the lock, so the jail can be reaped while connections to it are being set up
+ */
+static pthread_mutex_t jailMutex = PTHREAD_MUTEX_INITIALIZER;
+static int jailNsFd = -1;
+static pid_t jailPid = 0;
+
+static bool parseSpec(const std::string& spec, fwd_t* fwd) {
+	std::vector<std::string> parts = util::strSplit(spec, ':');
+	if (parts.size() != 2 || !util::isANumber(parts[0].c_str()) ||
+	    !util::isANumber(parts[1].c_str())) {
+		LOG_E("Port forwarding '%s' is not in the 'host_port:jail_port' format",
+		    spec.c_str());
+		return false;
+	}
+	unsigned long host_port = strtoul(parts[0].c_str(), NULL, 0);
+	unsigned long jail_port = strtoul(parts[1].c_str(), NULL, 0);
+	if (host_port < 1 || host_port > 65535 || jail_port < 1 || jail_port > 65535) {
+		LOG_E("Port forwarding '%s': ports must be within 1..65535", spec.c_str());
+		return false;
+	}
+	fwd->host_port = host_port;
+	fwd->jail_port = jail_port;
+	return true;
+}
+
+/* Opens a TCP connection to the jail's loopback interface, from within its net namespace */
+static int connectJail(uint16_t port) {
+	pthread_mutex_lock(&jailMutex);
+	int ns_fd = (jailNsFd == -1) ? -1 : fcntl(jailNsFd, F_DUPFD_CLOEXEC, 0);
+	pid_t pid = jailPid;
+	pthread_mutex_unlock(&jailMutex);
+	if (ns_fd == -1) {
+		LOG_W("No jail to forward the connection to (port %u)", (unsigned)port);
+		return -1;
+	}
+
+	/* Only this (short-lived) thread switches the namespace */
+	if (setns(ns_fd, CLONE_NEWNET) == -1) {
+		PLOG_E("setns(fd=%d, CLONE_NEWNET)", ns_fd);
+		close(ns_fd);
+		return -1;
+	}
+	close(ns_fd);
+
+	int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sock == -1) {
+		PLOG_E("socket(AF_INET, SOCK_STREAM)");
+		return -1;
+	}
+	struct sockaddr_in addr;
+	memset(&addr, '\0', sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (TEMP_FAILURE_RETRY(connect(sock, (struct sockaddr*)&addr, sizeof(addr))) == -1) {
+		PLOG_W("connect(127.0.0.1:%u) in the net namespace of PID: %d", (unsigned)port,
+		    pid);
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/* One direction of a forwarded connection: bytes wait in a pipe between the two sockets */
+struct half_t {
+	int from;
+	int to;
+	int pipefd[2];
+	/* Capacity of the pipe, F_GETPIPE_SZ */
+	size_t cap;
+	size_t buffered;
+	bool eof;
+};
+
+static bool halfRead(half_t* h) {
+	ssize_t sz = splice(h->from, NULL, h->pipefd[1], NULL, h->cap - h->buffered,
+	    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (sz == -1) {
+		return errno == EAGAIN || errno == EINTR;
+	}
+	if (sz == 0) {
+		h->eof = true;
+	}
+	h->buffered += sz;
+	return true;
+}
+
+static bool halfWrite(half_t* h) {
+	ssize_t sz = splice(h->pipefd[0], NULL, h->to, NULL, h->buffered,
+	    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (sz == -1) {
+		return errno == EAGAIN || errno == EINTR;
+	}
+	h->buffered -= sz;
+	return true;
+}
+
+/* Moves data in both directions with splice(), so it never gets copied to the user-space */
+static void relay(int fd1, int fd2) {
+	half_t halves[2] = {
+	    {fd1, fd2, {-1, -1}, 0, 0, false},
+	    {fd2, fd1, {-1, -1}, 0, 0, false},
+	};
+	for (auto& h : halves) {
+		if (pipe2(h.pipefd, O_CLOEXEC | O_NONBLOCK) == -1) {
+			PLOG_E("pipe2(O_CLOEXEC|O_NONBLOCK)");
+			goto out;
+		}
+		int cap = fcntl(h.pipefd[1], F_GETPIPE_SZ);
+		if (cap <= 0) {
+			PLOG_E("fcntl(fd=%d, F_GETPIPE_SZ)", h.pipefd[1]);
+			goto out;
+		}
+		h.cap = cap;
+	}
+	for (int fd : {fd1, fd2}) {
+		if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+			PLOG_E("fcntl(fd=%d, F_SETFL, O_NONBLOCK)", fd);
+			goto out;
+		}
+	}
+
+	for (;;) {
+		struct pollfd pfds[4];
+		nfds_t cnt = 0;
+		for (auto& h : halves) {
+			/* With the pipe full, splice() couldn't move anything out of 'from' */
+			if (!h.eof && h.buffered < h.cap) {
+				pfds[cnt++] = {h.from, POLLIN, 0};
+			}
+			if (h.buffered > 0) {
+				pfds[cnt++] = {h.to, POLLOUT, 0};
+			}
+		}
+		if (cnt == 0) {
+			break;
+		}
+		if (TEMP_FAILURE_RETRY(poll(pfds, cnt, -1)) == -1) {
+			PLOG_E("poll()");
+			break;
+		}
+		bool ok = true;
+		for (auto& h : halves) {
+			for (nfds_t i = 0; i < cnt; i++) {
+				if (pfds[i].revents == 0) {
+					continue;
+				}
+				if (pfds[i].fd == h.from && pfds[i].events == POLLIN) {
+					ok = ok && halfRead(&h);
+				}
+				if (pfds[i].fd == h.to && pfds[i].events == POLLOUT) {
+					ok = ok && halfWrite(&h);
+				}
+			}
+			if (h.eof && h.buffered == 0) {
+				shutdown(h.to, SHUT_WR);
+			}
+		}
+		if (!ok) {
+			PLOG_D("splice()");
+			break;
+		}
+	}
+out:
+	for (auto& h : halves) {
+		for (int fd : h.pipefd) {
+			if (fd != -1) {
+				close(fd);
+			}
+		}
+	}
+}
+
+struct conn_t {
+	int connfd;
+	uint16_t jail_port;
+};
+
+static void connDone(void) {
+	pthread_mutex_lock(&connsMutex);
+	connsCnt--;
+	pthread_cond_signal(&connsCond);
+	pthread_mutex_unlock(&connsMutex);
+}
+
+static void* connThread(void* arg) {
+	conn_t* conn = (conn_t*)arg;
+	int sock = connectJail(conn->jail_port);
+	if (sock != -1) {
+		relay(conn->connfd, sock);
+		close(sock);
+	}
+	close(conn->connfd);
+	delete conn;
+	connDone();
+	return NULL;
+}
+
+static void* acceptThread(void* arg) {
+	const fwd_t* fwd = (const fwd_t*)arg;
+	for (;;) {
+		/* New connections wait in the listen backlog until some of the current ones end */
+		pthread_mutex_lock(&connsMutex);
+		while (connsCnt >= kMaxConns) {
+			pthread_cond_wait(&connsCond, &connsMutex);
+		}
+		connsCnt++;
+		pthread_mutex_unlock(&connsMutex);
+
+		int connfd = net::acceptConn(fwd->listenfd);
+		if (connfd == -1) {
+			connDone();
+			/* E.g. out of file descriptors (EMFILE/ENFILE), don't spin on accept() */
+			usleep(100000);
+			continue;
+		}
+		conn_t* conn = new conn_t{connfd, fwd->jail_port};
+		pthread_t tid;
+		int err = pthread_create(&tid, NULL, connThread, conn);
+		if (err != 0) {
+			errno = err;
+			PLOG_E("pthread_create()");
+			close(connfd);
+			delete conn;
+			connDone();
+			continue;
+		}
+		pthread_detach(tid);
+	}
+	return NULL;
+}
+
+bool init(nsjconf_t* nsjconf) {
+	if (nsjconf->port_forwards.empty()) {
+		return true;
+	}
+	if (nsjconf->mode != MODE_STANDALONE_ONCE && nsjconf->mode != MODE_STANDALONE_RERUN) {
+		LOG_E("Port forwarding is supported in MODE_STANDALONE_ONCE and "
+		      "MODE_STANDALONE_RERUN only");
+		return false;
+	}
+	if (!nsjconf->clone_newnet) {
+		LOG_E("Port forwarding requires CLONE_NEWNET");
+		return false;
+	}
+	/*
+	 * setns(CLONE_NEWNET) into the jail needs CAP_SYS_ADMIN in the current user namespace, and
+	 * over the jail's one (which the creator of it has)
+	 */
+	if (!caps::haveEffective(CAP_SYS_ADMIN)) {
+		LOG_E("Port forwarding requires CAP_SYS_ADMIN, to enter the jail's net namespace");
+		return false;
+	}
+
+	fwds.resize(nsjconf->port_forwards.size());
+	for (size_t i = 0; i < fwds.size(); i++) {
+		if (!parseSpec(nsjconf->port_forwards[i], &fwds[i])) {
+			return false;
+		}
+		fwds[i].listenfd = net::getRecvSocket(nsjconf->bindhost.c_str(), fwds[i].host_port);
+		if (fwds[i].listenfd == -1) {
+			return false;
+		}
+		if (fcntl(fwds[i].listenfd, F_SETFD, FD_CLOEXEC) == -1) {
+			PLOG_E("fcntl(fd=%d, F_SETFD, FD_CLOEXEC)", fwds[i].listenfd);
+			return false;
+		}
+	}
+	/*
+	 * Signals must reach the main thread, which waits for them in pause(). With SIGPIPE
+	 * blocked, splice() into a closed connection fails with EPIPE instead
+	 */
+	sigset_t smask, orig_smask;
+	sigfillset(&smask);
+	pthread_sigmask(SIG_SETMASK, &smask, &orig_smask);
+	bool ret = true;
+	/* Started only when the vector won't be resized anymore */
+	for (auto& fwd : fwds) {
+		pthread_t tid;
+		int err = pthread_create(&tid, NULL, acceptThread, &fwd);
+		if (err != 0) {
+			errno = err;
+			PLOG_E("pthread_create()");
+			ret = false;
+			break;
+		}
+		pthread_detach(tid);
+		LOG_I("Forwarding port %u to port %u inside the jail", (unsigned)fwd.host_port,
+		    (unsigned)fwd.jail_port);
+	}
+	pthread_sigmask(SIG_SETMASK, &orig_smask, NULL);
+	return ret;
+}
+
+void attach(nsjconf_t* nsjconf, pid_t pid) {
+	if (fwds.empty()) {
+		return;
+	}
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "/proc/%d/ns/net", (int)pid);
+	int ns_fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+	if (ns_fd == -1) {
+		PLOG_E("open('%s', O_RDONLY|O_CLOEXEC)", path);
+		return;
+	}
+	pthread_mutex_lock(&jailMutex);
+	if (jailNsFd != -1) {
+		close(jailNsFd);
+	}
+	jailNsFd = ns_fd;
+	jailPid = pid;
+	pthread_mutex_unlock(&jailMutex);
+}
+
+void detach(nsjconf_t* nsjconf, pid_t pid) {
+	pthread_mutex_lock(&jailMutex);
+	if (jailPid == pid) {
+		close(jailNsFd);
+		jailNsFd = -1;
+		jailPid = 0;
+	}
+	pthread_mutex_unlock(&jailMutex);
+}
+
+}  // namespace portfwd
@@ -0,0 +1,219 @@
+/*
+
+   nsjail - reloading of the configuration
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+
+/*
+ * On SIGHUP the command-line (and with it the --config file) is parsed again, and the seccomp
+ * policy is compiled in a background thread. Once it's ready, the new configuration snapshot
+ * replaces the current one for new jails. Running jails keep a reference to the snapshot they
+ * were started with (pids_t::conf), so their time limits and cgroups don't change underneath them
+ */
+
+#include "reload.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "cmdline.h"
+#include "logs.h"
+#include "net.h"
+#include "sandbox.h"
+
+namespace reload {
+
+enum state_t {
+	STATE_IDLE = 0,
+	STATE_COMPILING,
+	STATE_DONE,
+};
+
+static std::vector<std::string> args;
+static std::shared_ptr<nsjconf_t> next;
+static bool nextOk;
+static pthread_t compileTid;
+static std::atomic<int> state(STATE_IDLE);
+
+void init(int argc, char** argv) {
+	for (int i = 0; i < argc; i++) {
+		args.push_back(argv[i]);
+	}
+}
+
+std::shared_ptr<nsjconf_t> makeSnapshot(std::unique_ptr<nsjconf_t> nsjconf) {
+	if (!nsjconf) {
+		return nullptr;
+	}
+	return std::shared_ptr<nsjconf_t>(nsjconf.release(), [](nsjconf_t* c) {
+		sandbox::closePolicy(c);
+		if (c->exec_fd != -1) {
+			close(c->exec_fd);
+		}
+		delete c;
+	});
+}
+
+/*
+ * Settings which are used when the supervisor starts (sockets, network interfaces, namespace
+ * pools) keep their current values
+ */
+#define KEEP_FIELD(field)                                                            \
+	if (next->field != cur->field) {                                             \
+		LOG_W("'%s' can't be changed without a restart, keeping the old value", \
+		    #field);                                                         \
+		next->field = cur->field;                                            \
+	}
+
+static void keepStartupParams(nsjconf_t* cur) {
+	KEEP_FIELD(mode);
+	KEEP_FIELD(port);
+	KEEP_FIELD(bindhost);
+	KEEP_FIELD(daemonize);
+	KEEP_FIELD(clone_newnet);
+	KEEP_FIELD(net_none);
+	KEEP_FIELD(iface_vs);
+	KEEP_FIELD(macvlan_pool_size);
+	KEEP_FIELD(veth_bridge);
+	KEEP_FIELD(veth_cidr);
+	KEEP_FIELD(veth_gw);
+	KEEP_FIELD(net_egress_rate);
+	KEEP_FIELD(net_egress_burst);
+	KEEP_FIELD(net_ingress_rate);
+	KEEP_FIELD(net_ingress_burst);
+	KEEP_FIELD(port_forwards);
+	KEEP_FIELD(pool_newnet);
+	KEEP_FIELD(pool_newipc);
+	KEEP_FIELD(pool_newuts);
+	KEEP_FIELD(ns_pool_size);
+	KEEP_FIELD(control_socket);
+}
+
+/*
+ * The listening sockets, inherited ones included, stay open. What the reloaded configuration says
+ * about them (command, seccomp policy) is used, matched by name and address
+ */
+static void keepListeners(nsjconf_t* cur) {
+	std::vector<listener_t> conf = net::configuredListeners(next.get());
+	std::vector<bool> used(conf.size(), false);
+	std::vector<listener_t> res;
+	for (const auto& l : cur->listeners) {
+		size_t i = 0;
+		while (i < conf.size() && (used[i] || !net::sameListener(cur, l, conf[i]))) {
+			i++;
+		}
+		if (i == conf.size()) {
+			/* Sockets passed in LISTEN_FDS only are not in the configuration */
+			if (l.port != 0 || !l.unix_path.empty()) {
+				LOG_W("Listener %s can't be removed or changed without a restart, "
+				      "keeping it",
+				    net::listenerText(cur, l).c_str());
+			}
+			res.push_back(l);
+			continue;
+		}
+		used[i] = true;
+		res.push_back(conf[i]);
+		res.back().fd = l.fd;
+	}
+	for (size_t i = 0; i < conf.size(); i++) {
+		if (!used[i]) {
+			LOG_W("Listener %s can't be added without a restart, ignoring it",
+			    net::listenerText(cur, conf[i]).c_str());
+		}
+	}
+	next->listeners = res;
+}
+
+static void* compileThread(void* arg) {
+	nsjconf_t* nsjconf = (nsjconf_t*)arg;
+	nextOk = sandbox::preparePolicy(nsjconf);
+	state = STATE_DONE;
+	return NULL;
+}
+
+void start(nsjconf_t* nsjconf) {
+	if (nsjconf->mode != MODE_LISTEN_TCP && nsjconf->mode != MODE_STANDALONE_RERUN) {
+		LOG_W("Configuration can be reloaded in the LISTEN and RERUN modes only");
+		return;
+	}
+	if (state != STATE_IDLE) {
+		LOG_W("Configuration reload already in progress");
+		return;
+	}
+	LOG_I("Reloading configuration");
+
+	std::vector<char*> argv;
+	for (auto& a : args) {
+		argv.push_back(&a[0]);
+	}
+	argv.push_back(NULL);
+	/* Full re-initialization of getopt_long() */
+	optind = 0;
+	next = makeSnapshot(cmdline::parseArgs(argv.size() - 1, argv.data()));
+	if (!next) {
+		LOG_E("Couldn't parse the new configuration, keeping the current one");
+		logs::initLog(nsjconf->logfile, nsjconf->loglevel);
+		return;
+	}
+	keepStartupParams(nsjconf);
+	keepListeners(nsjconf);
+
+	/* The seccomp policy might take a while to compile, new connections are served meanwhile */
+	sigset_t smask, orig_smask;
+	sigfillset(&smask);
+	pthread_sigmask(SIG_SETMASK, &smask, &orig_smask);
+	state = STATE_COMPILING;
+	int err = pthread_create(&compileTid, NULL, compileThread, next.get());
+	pthread_sigmask(SIG_SETMASK, &orig_smask, NULL);
+	if (err != 0) {
+		errno = err;
+		PLOG_E("pthread_create()");
+		state = STATE_IDLE;
+		next.reset();
+	}
+}
+
+std::shared_ptr<nsjconf_t> collect(nsjconf_t* nsjconf) {
+	if (state != STATE_DONE) {
+		return nullptr;
+	}
+	pthread_join(compileTid, NULL);
+	state = STATE_IDLE;
+
+	std::shared_ptr<nsjconf_t> ret;
+	ret.swap(next);
+	if (!nextOk) {
+		LOG_E("Couldn't prepare the new seccomp policy, keeping the current configuration");
+		logs::initLog(nsjconf->logfile, nsjconf->loglevel);
+		return nullptr;
+	}
+	ret->pids = std::move(nsjconf->pids);
+	nsjconf->pids.clear();
+	LOG_I("Configuration reloaded");
+	return ret;
+}
+
+}  // namespace reload
@@ -0,0 +1,40 @@
+/*
+
+   nsjail - reloading of the configuration
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#ifndef NS_RELOAD_H
+#define NS_RELOAD_H
+
+#include <stdbool.h>
+
+#include <memory>
+
+#include "nsjail.h"
+
+namespace reload {
+
+void init(int argc, char** argv);
+std::shared_ptr<nsjconf_t> makeSnapshot(std::unique_ptr<nsjconf_t> nsjconf);
+void start(nsjconf_t* nsjconf);
+std::shared_ptr<nsjconf_t> collect(nsjconf_t* nsjconf);
+
+}  // namespace reload
+
+#endif /* NS_RELOAD_H */
@@ -21,16 +21,32 @@
 
 #include "sandbox.h"
 
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <linux/filter.h>
 #include <linux/seccomp.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
 
 extern "C" {
 #include "kafel.h"
 }
 #include "logs.h"
+#include "util.h"
 
 namespace sandbox {
 
@@ -38,56 +54,141 @@ namespace sandbox {
 #define PR_SET_NO_NEW_PRIVS 38
 #endif /* PR_SET_NO_NEW_PRIVS */
 
-static bool prepareAndCommit(nsjconf_t* nsjconf) {
-	if (nsjconf->kafel_file_path.empty() && nsjconf->kafel_string.empty()) {
-		return true;
+/* The listener fd goes to the supervisor (unotify.cc) over the socketpair with the parent */
+static bool installListener(const struct sock_fprog* fprog, int notify_sock) {
+	if (notify_sock == -1) {
+		LOG_W("seccomp_notify/seccomp_profile need a supervisor to pass the listener to");
+		return false;
+	}
+	int fd = syscall(
+	    __NR_seccomp, SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_NEW_LISTENER, fprog);
+	if (fd == -1) {
+		PLOG_W("seccomp(SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_NEW_LISTENER) failed");
+		return false;
+	}
+	if (!util::sendFd(notify_sock, fd)) {
+		close(fd);
+		return false;
 	}
+	close(fd);
+	return true;
+}
 
-	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0)) {
-		PLOG_W("prctl(PR_SET_NO_NEW_PRIVS, 1) failed");
+static bool commitWithListener(nsjconf_t* nsjconf, int notify_sock) {
+	if (!installListener(&nsjconf->seccomp_fprog, notify_sock)) {
 		return false;
 	}
-	if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &nsjconf->seccomp_fprog, 0, 0)) {
-		PLOG_W("prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER) failed");
+	/*
+	 * Judged by the first filter already, which allows seccomp() (but not necessarily prctl(),
+	 * that one gets the policy's verdict)
+	 */
+	if (syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, 0, &nsjconf->seccomp_fprog_post) == -1) {
+		PLOG_W("seccomp(SECCOMP_SET_MODE_FILTER) failed");
 		return false;
 	}
 	return true;
 }
 
-bool applyPolicy(nsjconf_t* nsjconf) {
-	return prepareAndCommit(nsjconf);
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define ARG_LO(n) (offsetof(struct seccomp_data, args[n]))
+#define ARG_HI(n) (offsetof(struct seccomp_data, args[n]) + sizeof(uint32_t))
+#else
+#define ARG_LO(n) (offsetof(struct seccomp_data, args[n]) + sizeof(uint32_t))
+#define ARG_HI(n) (offsetof(struct seccomp_data, args[n]))
+#endif
+
+/*
+ * seccomp_profile: every syscall is a notification, except the sendmsg() passing the listener
+ * (it can't be answered before the supervisor has the listener). The rest of the jail's setup
+ * and execve() are the first ones recorded
+ */
+static bool commitProfiling(int notify_sock) {
+	struct sock_filter filter[] = {
+	    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+	    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_sendmsg, 0, 4),
+	    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ARG_LO(0)),
+	    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)notify_sock, 0, 2),
+	    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ARG_HI(0)),
+	    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0),
+	    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_USER_NOTIF),
+	    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+	};
+	struct sock_fprog fprog;
+	fprog.len = sizeof(filter) / sizeof(filter[0]);
+	fprog.filter = filter;
+	return installListener(&fprog, notify_sock);
+}
+
+static const seccomp_policy_t* findPolicy(nsjconf_t* nsjconf, const std::string& name) {
+	for (const auto& p : nsjconf->seccomp_policies) {
+		if (p.name == name) {
+			return &p;
+		}
+	}
+	return NULL;
+}
+
+bool hasPolicy(nsjconf_t* nsjconf, const std::string& name) {
+	return findPolicy(nsjconf, name) != NULL;
 }
 
-bool preparePolicy(nsjconf_t* nsjconf) {
-	if (nsjconf->kafel_file_path.empty() && nsjconf->kafel_string.empty()) {
+static bool prepareAndCommit(nsjconf_t* nsjconf, const std::string& name, int notify_sock) {
+	const struct sock_fprog* fprog = &nsjconf->seccomp_fprog;
+	if (!name.empty()) {
+		const seccomp_policy_t* p = findPolicy(nsjconf, name);
+		if (!p) {
+			LOG_W("Unknown seccomp policy '%s'", name.c_str());
+			return false;
+		}
+		fprog = &p->fprog;
+	} else if (nsjconf->kafel_file_path.empty() && nsjconf->kafel_string.empty() &&
+		   nsjconf->seccomp_profile_file.empty()) {
 		return true;
 	}
-	if (!nsjconf->kafel_file_path.empty() && !nsjconf->kafel_string.empty()) {
-		LOG_W(
-		    "You specified both kafel seccomp policy, and kafel seccomp file. Specify one "
-		    "only");
+
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0)) {
+		PLOG_W("prctl(PR_SET_NO_NEW_PRIVS, 1) failed");
+		return false;
+	}
+	if (!nsjconf->seccomp_profile_file.empty()) {
+		return commitProfiling(notify_sock);
+	}
+	if (!nsjconf->seccomp_notify.empty()) {
+		return commitWithListener(nsjconf, notify_sock);
+	}
+	if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, fprog, 0, 0)) {
+		PLOG_W("prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER) failed");
 		return false;
 	}
+	return true;
+}
+
+bool applyPolicy(nsjconf_t* nsjconf, const std::string& name, int notify_sock) {
+	return prepareAndCommit(nsjconf, name, notify_sock);
+}
 
+static bool compilePolicy(const std::string& file_path, const std::string& str,
+    const char* policy, struct sock_fprog* fprog) {
 	kafel_ctxt_t ctxt = kafel_ctxt_create();
 
-	if (!nsjconf->kafel_file_path.empty()) {
-		FILE* f = fopen(nsjconf->kafel_file_path.c_str(), "r");
+	if (policy) {
+		kafel_set_input_string(ctxt, policy);
+	} else if (!file_path.empty()) {
+		FILE* f = fopen(file_path.c_str(), "r");
 		if (!f) {
 			PLOG_W("Couldn't open the kafel seccomp policy file '%s'",
-			    nsjconf->kafel_file_path.c_str());
+			    file_path.c_str());
 			kafel_ctxt_destroy(&ctxt);
 			return false;
 		}
-		LOG_D("Compiling seccomp policy from file: '%s'", nsjconf->kafel_file_path.c_str());
+		LOG_D("Compiling seccomp policy from file: '%s'", file_path.c_str());
 		kafel_set_input_file(ctxt, f);
-	}
-	if (!nsjconf->kafel_string.empty()) {
-		LOG_D("Compiling seccomp policy from string: '%s'", nsjconf->kafel_string.c_str());
-		kafel_set_input_string(ctxt, nsjconf->kafel_string.c_str());
+	} else {
+		LOG_D("Compiling seccomp policy from string: '%s'", str.c_str());
+		kafel_set_input_string(ctxt, str.c_str());
 	}
 
-	if (kafel_compile(ctxt, &nsjconf->seccomp_fprog) != 0) {
+	if (kafel_compile(ctxt, fprog) != 0) {
 		LOG_W("Could not compile policy: %s", kafel_error_msg(ctxt));
 		kafel_ctxt_destroy(&ctxt);
 		return false;
@@ -96,13 +197,670 @@ bool preparePolicy(nsjconf_t* nsjconf) {
 	return true;
 }
 
-void closePolicy(nsjconf_t* nsjconf) {
-	if (!nsjconf->seccomp_fprog.filter) {
+/*
+ * Kafel compares the syscall number with one constant at a time, so the cost grows with the
+ * position of a syscall in the policy. The dispatch on the syscall number (the code following
+ * the first 'ld [nr]', made of conditional jumps on A with constant operands) is replaced with a
+ * binary search over the ranges of syscall numbers which lead to the same instruction. The
+ * original instructions are kept, so that the rest of the program (e.g. argument checks) doesn't
+ * change; only the jumps from the prefix over the inserted tree are adjusted
+ */
+static const size_t kOptMaxJmp = 255;
+
+/* Checked before the binary search, either returning 'action' or following the policy */
+struct optHead_t {
+	uint32_t nr;
+	bool ret;
+	uint32_t action;
+};
+
+struct optRange_t {
+	uint32_t start;
+	size_t exit; /* Index of the first instruction past the dispatch */
+};
+
+/* Follows the dispatch for the syscall 'nr', returns the index of the exit instruction */
+static size_t optWalk(const struct sock_filter* prog, size_t len, size_t pc, uint32_t nr,
+    size_t* steps) {
+	*steps = 0;
+	while (pc < len) {
+		const struct sock_filter& ins = prog[pc];
+		if (BPF_CLASS(ins.code) != BPF_JMP) {
+			return pc;
+		}
+		if (BPF_OP(ins.code) == BPF_JA) {
+			pc += 1 + ins.k;
+			(*steps)++;
+			continue;
+		}
+		if (BPF_SRC(ins.code) != BPF_K) {
+			return pc;
+		}
+		bool cond;
+		switch (BPF_OP(ins.code)) {
+		case BPF_JEQ:
+			cond = (nr == ins.k);
+			break;
+		case BPF_JGT:
+			cond = (nr > ins.k);
+			break;
+		case BPF_JGE:
+			cond = (nr >= ins.k);
+			break;
+		default:
+			return pc;
+		}
+		pc += 1 + (cond ? ins.jt : ins.jf);
+		(*steps)++;
+	}
+	return pc;
+}
+
+static bool optIsRet(const struct sock_filter& ins) {
+	return BPF_CLASS(ins.code) == BPF_RET;
+}
+
+/* A leaf returns directly if the exit is a 'ret', or jumps to the exit otherwise */
+static void optLeaf(const struct sock_filter* prog, size_t exit,
+    std::vector<struct sock_filter>* out, std::vector<std::pair<size_t, size_t>>* fixups) {
+	if (optIsRet(prog[exit])) {
+		out->push_back(prog[exit]);
 		return;
 	}
-	free(nsjconf->seccomp_fprog.filter);
-	nsjconf->seccomp_fprog.filter = nullptr;
-	nsjconf->seccomp_fprog.len = 0;
+	fixups->push_back({out->size(), exit});
+	out->push_back(BPF_STMT(BPF_JMP | BPF_JA, 0));
+}
+
+static void optTree(const struct sock_filter* prog, const std::vector<optRange_t>& ranges,
+    size_t lo, size_t hi, std::vector<struct sock_filter>* out,
+    std::vector<std::pair<size_t, size_t>>* fixups) {
+	if (hi - lo == 1) {
+		optLeaf(prog, ranges[lo].exit, out, fixups);
+		return;
+	}
+	size_t mid = lo + (hi - lo) / 2;
+	std::vector<struct sock_filter> left;
+	std::vector<std::pair<size_t, size_t>> left_fixups;
+	optTree(prog, ranges, lo, mid, &left, &left_fixups);
+
+	size_t base;
+	if (left.size() <= kOptMaxJmp) {
+		out->push_back(BPF_JUMP(
+		    BPF_JMP | BPF_JGE | BPF_K, ranges[mid].start, (uint8_t)left.size(), 0));
+		base = out->size();
+	} else {
+		out->push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, ranges[mid].start, 0, 1));
+		out->push_back(BPF_STMT(BPF_JMP | BPF_JA, (uint32_t)left.size()));
+		base = out->size();
+	}
+	for (const auto& f : left_fixups) {
+		fixups->push_back({base + f.first, f.second});
+	}
+	out->insert(out->end(), left.begin(), left.end());
+	optTree(prog, ranges, mid, hi, out, fixups);
+}
+
+/* Most of the original dispatch is unreachable now. Jumps only get shorter here */
+static std::vector<struct sock_filter> optDropDead(const std::vector<struct sock_filter>& prog) {
+	std::vector<bool> live(prog.size(), false);
+	live[0] = true;
+	for (size_t i = 0; i < prog.size(); i++) {
+		if (!live[i]) {
+			continue;
+		}
+		const struct sock_filter& ins = prog[i];
+		if (BPF_CLASS(ins.code) == BPF_RET) {
+			continue;
+		}
+		if (BPF_CLASS(ins.code) != BPF_JMP) {
+			live[i + 1] = true;
+		} else if (BPF_OP(ins.code) == BPF_JA) {
+			live[i + 1 + ins.k] = true;
+		} else {
+			live[i + 1 + ins.jt] = true;
+			live[i + 1 + ins.jf] = true;
+		}
+	}
+	std::vector<size_t> idx(prog.size());
+	for (size_t i = 0, n = 0; i < prog.size(); i++) {
+		idx[i] = n;
+		n += live[i] ? 1 : 0;
+	}
+	std::vector<struct sock_filter> out;
+	for (size_t i = 0; i < prog.size(); i++) {
+		if (!live[i]) {
+			continue;
+		}
+		struct sock_filter ins = prog[i];
+		if (BPF_CLASS(ins.code) == BPF_JMP && BPF_OP(ins.code) == BPF_JA) {
+			ins.k = idx[i + 1 + ins.k] - idx[i] - 1;
+		} else if (BPF_CLASS(ins.code) == BPF_JMP) {
+			ins.jt = idx[i + 1 + ins.jt] - idx[i] - 1;
+			ins.jf = idx[i + 1 + ins.jf] - idx[i] - 1;
+		}
+		out.push_back(ins);
+	}
+	return out;
+}
+
+static bool optimizePolicy(const struct sock_fprog* in, const std::vector<optHead_t>& heads,
+    bool verbose, struct sock_fprog* res) {
+	const struct sock_filter* prog = in->filter;
+	const size_t len = in->len;
+
+	size_t ld = 0;
+	for (; ld < len; ld++) {
+		if (prog[ld].code == (BPF_LD | BPF_W | BPF_ABS) &&
+		    prog[ld].k == offsetof(struct seccomp_data, nr)) {
+			break;
+		}
+	}
+	if (ld + 1 >= len) {
+		LOG_D("No syscall number dispatch found in the seccomp policy");
+		return false;
+	}
+	const size_t entry = ld + 1;
+
+	/* Syscall numbers where the outcome of some comparison changes */
+	std::vector<uint64_t> bounds = {0};
+	/* Syscalls named in the policy, for the statistics */
+	std::vector<uint32_t> named;
+	for (size_t i = entry; i < len; i++) {
+		if (BPF_CLASS(prog[i].code) != BPF_JMP || BPF_SRC(prog[i].code) != BPF_K) {
+			continue;
+		}
+		uint64_t k = prog[i].k;
+		switch (BPF_OP(prog[i].code)) {
+		case BPF_JEQ:
+			named.push_back(k);
+			bounds.push_back(k);
+			bounds.push_back(k + 1);
+			break;
+		case BPF_JGT:
+			bounds.push_back(k + 1);
+			break;
+		case BPF_JGE:
+			bounds.push_back(k);
+			break;
+		}
+	}
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+	while (bounds.back() > UINT32_MAX) {
+		bounds.pop_back();
+	}
+	std::sort(named.begin(), named.end());
+	named.erase(std::unique(named.begin(), named.end()), named.end());
+	if (named.empty()) {
+		named.assign(bounds.begin(), bounds.end());
+	}
+
+	/* Ranges [start, next start) with the same exit, neighbours with the same exit merged */
+	std::vector<optRange_t> ranges;
+	size_t steps;
+	for (const auto b : bounds) {
+		size_t exit = optWalk(prog, len, entry, b, &steps);
+		if (exit >= len) {
+			LOG_W("Malformed seccomp policy, not optimizing it");
+			return false;
+		}
+		if (ranges.empty() || ranges.back().exit != exit) {
+			ranges.push_back({(uint32_t)b, exit});
+		}
+	}
+
+	std::vector<struct sock_filter> tree;
+	std::vector<std::pair<size_t, size_t>> fixups;
+	for (const auto& h : heads) {
+		tree.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, h.nr, 0, 1));
+		if (h.ret) {
+			tree.push_back(BPF_STMT(BPF_RET | BPF_K, h.action));
+		} else {
+			optLeaf(prog, optWalk(prog, len, entry, h.nr, &steps), &tree, &fixups);
+		}
+	}
+	optTree(prog, ranges, 0, ranges.size(), &tree, &fixups);
+
+	const size_t added = tree.size();
+	std::vector<struct sock_filter> out(prog, prog + entry);
+	/* Jumps from the prefix over the new code */
+	for (size_t i = 0; i < entry; i++) {
+		struct sock_filter& ins = out[i];
+		if (BPF_CLASS(ins.code) != BPF_JMP) {
+			continue;
+		}
+		if (BPF_OP(ins.code) == BPF_JA) {
+			if (i + 1 + ins.k >= entry) {
+				ins.k += added;
+			}
+			continue;
+		}
+		for (uint8_t* off : {&ins.jt, &ins.jf}) {
+			if (i + 1 + *off < entry) {
+				continue;
+			}
+			if (*off + added > kOptMaxJmp) {
+				LOG_D("Jump at %zu can't be extended, not optimizing the seccomp "
+				      "policy",
+				    i);
+				return false;
+			}
+			*off += added;
+		}
+	}
+	for (const auto& f : fixups) {
+		tree[f.first].k = (uint32_t)(f.second + added - (entry + f.first + 1));
+	}
+	out.insert(out.end(), tree.begin(), tree.end());
+	out.insert(out.end(), prog + entry, prog + len);
+
+	/*
+	 * Every syscall number must end up at the same instruction as before. Both programs are
+	 * constant between the neighbouring bounds, so checking these (and the heads) is enough.
+	 * Heads with their own action are meant to differ
+	 */
+	std::vector<uint64_t> checks(bounds);
+	std::vector<uint32_t> overridden;
+	for (const auto& h : heads) {
+		checks.push_back(h.nr);
+		checks.push_back((uint64_t)h.nr + 1);
+		if (h.ret) {
+			overridden.push_back(h.nr);
+		}
+	}
+	for (const auto nr : checks) {
+		if (nr > UINT32_MAX ||
+		    std::find(overridden.begin(), overridden.end(), nr) != overridden.end()) {
+			continue;
+		}
+		size_t old_exit = optWalk(prog, len, entry, nr, &steps);
+		size_t new_exit = optWalk(out.data(), out.size(), entry, nr, &steps);
+		bool same;
+		if (new_exit >= entry + added) {
+			same = (new_exit - added == old_exit);
+		} else {
+			same = optIsRet(out[new_exit]) &&
+			       out[new_exit].code == prog[old_exit].code &&
+			       out[new_exit].k == prog[old_exit].k;
+		}
+		if (!same) {
+			LOG_W("Optimized seccomp policy differs for syscall %" PRIu64
+			      ", not using it",
+			    nr);
+			return false;
+		}
+	}
+
+	size_t old_sum = 0, old_max = 0, new_sum = 0, new_max = 0;
+	for (const auto nr : named) {
+		optWalk(prog, len, entry, nr, &steps);
+		old_sum += steps;
+		old_max = std::max(old_max, steps);
+		optWalk(out.data(), out.size(), entry, nr, &steps);
+		new_sum += steps;
+		new_max = std::max(new_max, steps);
+	}
+	out = optDropDead(out);
+	if (out.size() > BPF_MAXINSNS) {
+		LOG_W("Optimized seccomp policy is too long (%zu instructions), not using it",
+		    out.size());
+		return false;
+	}
+	/* Heads which return verdicts of their own change the policy, so they're always used */
+	bool rets = false;
+	for (const auto& h : heads) {
+		rets = rets || h.ret;
+	}
+	if (!rets && new_sum >= old_sum) {
+		LOG_D("The rewritten seccomp policy is not faster, keeping the original one");
+		return false;
+	}
+	if (verbose) {
+		LOG_I("Seccomp policy rewritten: %zu -> %zu instructions, syscall dispatch takes "
+		      "%.1f avg/%zu max jumps (%.1f avg/%zu max before)",
+		    len, out.size(), (double)new_sum / named.size(), new_max,
+		    (double)old_sum / named.size(), old_max);
+	}
+
+	res->filter = (struct sock_filter*)malloc(out.size() * sizeof(struct sock_filter));
+	memcpy(res->filter, out.data(), out.size() * sizeof(struct sock_filter));
+	res->len = out.size();
+	return true;
+}
+
+/*
+ * With seccomp_notify the jail gets two filters. The first one carries the listener: it makes
+ * the notified syscalls return SECCOMP_RET_USER_NOTIF, and allows what's needed to pass the
+ * listener to the supervisor (sendmsg, close, seccomp). The second one, installed right after,
+ * is the policy with the notified syscalls allowed. The kernel uses the most restrictive
+ * verdict of both, so everything else gets the policy's verdict
+ */
+static const uint32_t kNotifyPassSyscalls[] = {__NR_sendmsg, __NR_close, __NR_seccomp};
+
+static bool finishPolicy(nsjconf_t* nsjconf, struct sock_fprog* fprog) {
+	struct sock_fprog raw = *fprog;
+	std::vector<optHead_t> hot;
+	for (const auto nr : nsjconf->seccomp_hot_syscalls) {
+		hot.push_back({nr, false, 0});
+	}
+	if (nsjconf->seccomp_notify.empty()) {
+		struct sock_fprog opt;
+		if (optimizePolicy(&raw, hot, /* verbose= */ true, &opt)) {
+			free(raw.filter);
+			*fprog = opt;
+		}
+		return true;
+	}
+
+	std::vector<optHead_t> first, second;
+	for (const auto nr : kNotifyPassSyscalls) {
+		first.push_back({nr, true, SECCOMP_RET_ALLOW});
+	}
+	for (const auto& n : nsjconf->seccomp_notify) {
+		for (const auto& h : second) {
+			if (h.nr == n.nr) {
+				LOG_E("seccomp_notify: syscall %u specified more than once", n.nr);
+				return false;
+			}
+		}
+		for (const auto nr : kNotifyPassSyscalls) {
+			if (n.nr == nr) {
+				LOG_E("seccomp_notify: syscall %u is needed to set up the "
+				      "supervisor, it can't be notified",
+				    n.nr);
+				return false;
+			}
+		}
+		first.push_back({n.nr, true, SECCOMP_RET_USER_NOTIF});
+		second.push_back({n.nr, true, SECCOMP_RET_ALLOW});
+	}
+	first.insert(first.end(), hot.begin(), hot.end());
+	second.insert(second.end(), hot.begin(), hot.end());
+
+	struct sock_fprog with_listener, post;
+	if (!optimizePolicy(&raw, first, /* verbose= */ true, &with_listener)) {
+		LOG_E("seccomp_notify needs a seccomp policy which dispatches on the syscall "
+		      "number");
+		return false;
+	}
+	if (!optimizePolicy(&raw, second, /* verbose= */ false, &post)) {
+		LOG_E("seccomp_notify needs a seccomp policy which dispatches on the syscall "
+		      "number");
+		free(with_listener.filter);
+		return false;
+	}
+	free(raw.filter);
+	nsjconf->seccomp_fprog = with_listener;
+	nsjconf->seccomp_fprog_post = post;
+	return true;
+}
+
+/*
+ * Cache of compiled policies: <seccomp_cache_dir>/<hash>.bpf files, with a header, the BPF
+ * instructions, and the full policy text, which is compared on load (the hash only names the file)
+ */
+#ifndef KAFEL_REV
+#define KAFEL_REV ""
+#endif /* KAFEL_REV */
+
+#if defined(__x86_64__)
+static const char kCacheArch[] = "x86_64";
+#elif defined(__i386__)
+static const char kCacheArch[] = "i386";
+#elif defined(__aarch64__)
+static const char kCacheArch[] = "aarch64";
+#elif defined(__arm__)
+static const char kCacheArch[] = "arm";
+#else
+static const char kCacheArch[] = "other";
+#endif
+
+static const char kCacheMagic[8] = "NSJBPF2";
+
+struct cacheHdr_t {
+	char magic[8];
+	char arch[16];
+	char kafel_rev[48];
+	uint32_t filter_len;
+	uint32_t policy_len;
+};
+
+static bool readPolicy(
+    const std::string& file_path, const std::string& str, std::string* policy) {
+	if (file_path.empty()) {
+		*policy = str;
+		return true;
+	}
+	int fd = TEMP_FAILURE_RETRY(open(file_path.c_str(), O_RDONLY | O_CLOEXEC));
+	if (fd == -1) {
+		PLOG_W("Couldn't open the kafel seccomp policy file '%s'", file_path.c_str());
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		PLOG_W("fstat('%s')", file_path.c_str());
+		close(fd);
+		return false;
+	}
+	policy->resize(st.st_size);
+	ssize_t len = util::readFromFd(fd, &(*policy)[0], st.st_size);
+	close(fd);
+	if (len != st.st_size) {
+		LOG_W("Short read from '%s'", file_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* FNV-1a */
+static const std::string cachePath(nsjconf_t* nsjconf, const std::string& policy) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	const std::string key = std::string(kCacheArch) + '\0' + KAFEL_REV + '\0' + policy;
+	for (const char c : key) {
+		hash = (hash ^ (uint8_t)c) * 0x100000001b3ULL;
+	}
+	char fname[32];
+	snprintf(fname, sizeof(fname), "/%016" PRIx64 ".bpf", hash);
+	return nsjconf->seccomp_cache_dir + fname;
+}
+
+static bool cacheLoad(
+    const std::string& path, const std::string& policy, struct sock_fprog* fprog) {
+	int fd = TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW));
+	if (fd == -1) {
+		PLOG_D("No cached seccomp policy in '%s'", path.c_str());
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		PLOG_W("fstat('%s')", path.c_str());
+		close(fd);
+		return false;
+	}
+	/* It'll be the jails' seccomp policy, so only trust files nobody else could've written */
+	if ((st.st_uid != geteuid() && st.st_uid != 0) || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		LOG_W("Ignoring '%s', it's writable by other users", path.c_str());
+		close(fd);
+		return false;
+	}
+	if ((size_t)st.st_size < sizeof(cacheHdr_t)) {
+		LOG_W("Ignoring truncated '%s'", path.c_str());
+		close(fd);
+		return false;
+	}
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		PLOG_W("mmap('%s')", path.c_str());
+		return false;
+	}
+
+	const cacheHdr_t* hdr = (const cacheHdr_t*)map;
+	const struct sock_filter* filter = (const struct sock_filter*)(hdr + 1);
+	const char* text = (const char*)(filter + hdr->filter_len);
+	bool valid = memcmp(hdr->magic, kCacheMagic, sizeof(kCacheMagic)) == 0 &&
+		     strncmp(hdr->arch, kCacheArch, sizeof(hdr->arch)) == 0 &&
+		     strncmp(hdr->kafel_rev, KAFEL_REV, sizeof(hdr->kafel_rev)) == 0 &&
+		     hdr->filter_len > 0 && hdr->filter_len <= BPF_MAXINSNS &&
+		     (size_t)st.st_size == sizeof(cacheHdr_t) +
+					       hdr->filter_len * sizeof(struct sock_filter) +
+					       hdr->policy_len &&
+		     hdr->policy_len == policy.size() &&
+		     memcmp(text, policy.data(), policy.size()) == 0;
+	if (valid) {
+		size_t sz = hdr->filter_len * sizeof(struct sock_filter);
+		fprog->filter = (struct sock_filter*)malloc(sz);
+		memcpy(fprog->filter, filter, sz);
+		fprog->len = hdr->filter_len;
+		LOG_D("Using the cached seccomp policy from '%s' (%u instructions)", path.c_str(),
+		    (unsigned)hdr->filter_len);
+	} else {
+		LOG_W("Ignoring stale or corrupted '%s'", path.c_str());
+	}
+	munmap(map, st.st_size);
+	return valid;
+}
+
+/* Renamed into place, so concurrently started nsjails never see a partial file */
+static void cacheStore(
+    const std::string& path, const std::string& policy, const struct sock_fprog* fprog) {
+	cacheHdr_t hdr;
+	memset(&hdr, '\0', sizeof(hdr));
+	memcpy(hdr.magic, kCacheMagic, sizeof(kCacheMagic));
+	snprintf(hdr.arch, sizeof(hdr.arch), "%s", kCacheArch);
+	snprintf(hdr.kafel_rev, sizeof(hdr.kafel_rev), "%s", KAFEL_REV);
+	hdr.filter_len = fprog->len;
+	hdr.policy_len = policy.size();
+
+	std::string tmp = path + ".XXXXXX";
+	int fd = mkostemp(&tmp[0], O_CLOEXEC);
+	if (fd == -1) {
+		PLOG_W("Couldn't cache the seccomp policy, mkostemp('%s')", tmp.c_str());
+		return;
+	}
+	if (fchmod(fd, 0644) == -1 || !util::writeToFd(fd, &hdr, sizeof(hdr)) ||
+	    !util::writeToFd(fd, fprog->filter,
+		hdr.filter_len * sizeof(struct sock_filter)) ||
+	    !util::writeToFd(fd, policy.data(), policy.size()) ||
+	    rename(tmp.c_str(), path.c_str()) == -1) {
+		PLOG_W("Couldn't cache the seccomp policy in '%s'", path.c_str());
+		unlink(tmp.c_str());
+	} else {
+		LOG_D("Cached the seccomp policy in '%s'", path.c_str());
+	}
+	close(fd);
+}
+
+/* Kafel's output, from the cache if possible */
+static bool loadPolicy(nsjconf_t* nsjconf, const std::string& file_path, const std::string& str,
+    struct sock_fprog* fprog) {
+	if (nsjconf->seccomp_cache_dir.empty()) {
+		return compilePolicy(file_path, str, NULL, fprog);
+	}
+	std::string policy;
+	if (!readPolicy(file_path, str, &policy)) {
+		return false;
+	}
+	/* The cache keeps Kafel's output, the rest depends on the jail's settings */
+	const std::string path = cachePath(nsjconf, policy);
+	if (!cacheLoad(path, policy, fprog)) {
+		if (!compilePolicy(file_path, str, policy.c_str(), fprog)) {
+			return false;
+		}
+		cacheStore(path, policy, fprog);
+	}
+	return true;
+}
+
+/* Compiled once, the jails (forked from this process) share them */
+static bool prepareNamedPolicies(nsjconf_t* nsjconf) {
+	if (!nsjconf->seccomp_policies.empty() && !nsjconf->seccomp_notify.empty()) {
+		LOG_E("seccomp_notify can't be combined with seccomp_named_policy");
+		return false;
+	}
+	for (size_t i = 0; i < nsjconf->seccomp_policies.size(); i++) {
+		seccomp_policy_t& p = nsjconf->seccomp_policies[i];
+		if (p.name.empty() || findPolicy(nsjconf, p.name) != &p) {
+			LOG_E("seccomp_named_policy #%zu: the name is empty or not unique", i);
+			return false;
+		}
+		if (p.kafel_file_path.empty() == p.kafel_string.empty()) {
+			LOG_E("seccomp_named_policy '%s': specify either a policy file or a string",
+			    p.name.c_str());
+			return false;
+		}
+		if (!loadPolicy(nsjconf, p.kafel_file_path, p.kafel_string, &p.fprog)) {
+			LOG_E("Couldn't prepare the seccomp policy '%s'", p.name.c_str());
+			return false;
+		}
+		if (!finishPolicy(nsjconf, &p.fprog)) {
+			return false;
+		}
+	}
+	for (const auto& l : nsjconf->listeners) {
+		if (!l.seccomp_policy.empty() && !findPolicy(nsjconf, l.seccomp_policy)) {
+			LOG_E("A listener uses the unknown seccomp policy '%s'",
+			    l.seccomp_policy.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+bool preparePolicy(nsjconf_t* nsjconf) {
+	if (!nsjconf->seccomp_profile_file.empty()) {
+		if (!nsjconf->kafel_file_path.empty() || !nsjconf->kafel_string.empty() ||
+		    !nsjconf->seccomp_policies.empty() || !nsjconf->seccomp_notify.empty()) {
+			LOG_E("seccomp_profile can't be combined with a seccomp policy or "
+			      "seccomp_notify, the jails must run without one to be profiled");
+			return false;
+		}
+		if (nsjconf->mode == MODE_STANDALONE_EXECVE) {
+			LOG_E("seccomp_profile is not supported in MODE_STANDALONE_EXECVE, "
+			      "there's no supervisor");
+			return false;
+		}
+		return true;
+	}
+	if (!prepareNamedPolicies(nsjconf)) {
+		return false;
+	}
+	if (nsjconf->kafel_file_path.empty() && nsjconf->kafel_string.empty()) {
+		if (!nsjconf->seccomp_notify.empty()) {
+			LOG_E("seccomp_notify needs a seccomp policy");
+			return false;
+		}
+		return true;
+	}
+	if (!nsjconf->seccomp_notify.empty() && nsjconf->mode == MODE_STANDALONE_EXECVE) {
+		LOG_E("seccomp_notify is not supported in MODE_STANDALONE_EXECVE, there's no "
+		      "supervisor");
+		return false;
+	}
+	if (!nsjconf->kafel_file_path.empty() && !nsjconf->kafel_string.empty()) {
+		LOG_W(
+		    "You specified both kafel seccomp policy, and kafel seccomp file. Specify one "
+		    "only");
+		return false;
+	}
+	if (!loadPolicy(nsjconf, nsjconf->kafel_file_path, nsjconf->kafel_string,
+		&nsjconf->seccomp_fprog)) {
+		return false;
+	}
+	return finishPolicy(nsjconf, &nsjconf->seccomp_fprog);
+}
+
+void closePolicy(nsjconf_t* nsjconf) {
+	std::vector<struct sock_fprog*> fprogs = {
+	    &nsjconf->seccomp_fprog, &nsjconf->seccomp_fprog_post};
+	for (auto& p : nsjconf->seccomp_policies) {
+		fprogs.push_back(&p.fprog);
+	}
+	for (struct sock_fprog* fprog : fprogs) {
+		free(fprog->filter);
+		fprog->filter = nullptr;
+		fprog->len = 0;
+	}
 }
 
 }  // namespace sandbox
@@ -24,11 +24,16 @@
 
 #include <stdbool.h>
 
+#include <string>
+
 #include "nsjail.h"
 
 namespace sandbox {
 
-bool applyPolicy(nsjconf_t* nsjconf);
+/* 'name' selects one of seccomp_policies, the main policy is used if it's empty */
+bool applyPolicy(nsjconf_t* nsjconf, const std::string& name, int notify_sock);
+/* One of seccomp_policies is called 'name' */
+bool hasPolicy(nsjconf_t* nsjconf, const std::string& name);
 bool preparePolicy(nsjconf_t* nsjconf);
 void closePolicy(nsjconf_t* nsjconf);
 
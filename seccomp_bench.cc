@@ -0,0 +1,195 @@
+/*
+
+   nsjail - seccomp-bpf overhead benchmark
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+
+/*
+ * Measures the per-syscall cost of a Kafel policy, compiled exactly as for the jails (with the
+ * same optimizations, see sandbox::preparePolicy()). Each loop runs first without, and then with
+ * the policy installed; the policy must allow the benchmarked syscalls, and write/exit_group.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "logs.h"
+#include "nsjail.h"
+#include "sandbox.h"
+
+namespace bench {
+
+static int zeroFd = -1;
+static uint32_t futexWord = 0;
+
+static void doGetpid(void) {
+	syscall(__NR_getpid);
+}
+
+static void doRead(void) {
+	char c;
+	if (read(zeroFd, &c, sizeof(c)) != sizeof(c)) {
+		PLOG_F("read('/dev/zero')");
+	}
+}
+
+static void doFutex(void) {
+	syscall(__NR_futex, &futexWord, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void doMmap(void) {
+	void* p = mmap(NULL, 4096, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		PLOG_F("mmap()");
+	}
+	munmap(p, 4096);
+}
+
+/* Not through the vDSO, which doesn't enter the kernel */
+static void doClockGettime(void) {
+	struct timespec ts;
+	syscall(__NR_clock_gettime, CLOCK_MONOTONIC, &ts);
+}
+
+struct test_t {
+	const char* name;
+	void (*fn)(void);
+	unsigned syscalls; /* per call of fn */
+	double ns[2];
+};
+
+static test_t tests[] = {
+    {"getpid", doGetpid, 1, {0, 0}},
+    {"read(/dev/zero)", doRead, 1, {0, 0}},
+    {"futex(WAKE)", doFutex, 1, {0, 0}},
+    {"mmap+munmap", doMmap, 2, {0, 0}},
+    {"clock_gettime", doClockGettime, 1, {0, 0}},
+};
+
+static uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void runAll(size_t iters, int idx) {
+	for (auto& t : tests) {
+		/* Warm-up */
+		for (size_t i = 0; i < iters / 10; i++) {
+			t.fn();
+		}
+		uint64_t start = nowNs();
+		for (size_t i = 0; i < iters; i++) {
+			t.fn();
+		}
+		t.ns[idx] = (double)(nowNs() - start) / ((double)iters * t.syscalls);
+	}
+}
+
+static void usage(const char* argv0) {
+	printf(
+	    "Usage: %s [-P policy_file | -s policy_string] [-n iterations] [-H hot_syscall]...\n"
+	    " -P, --seccomp_policy VALUE\tPath to file containing seccomp-bpf policy\n"
+	    " -s, --seccomp_string VALUE\tString with kafel seccomp-bpf policy\n"
+	    " -n, --iterations VALUE\t\tIterations of each loop (default: 1000000)\n"
+	    " -H, --seccomp_hot_syscall VALUE\tSyscall checked first by the policy, as in nsjail\n",
+	    argv0);
+}
+
+}  // namespace bench
+
+int main(int argc, char* argv[]) {
+	std::unique_ptr<nsjconf_t> nsjconf(new nsjconf_t());
+	nsjconf->seccomp_fprog.filter = NULL;
+	nsjconf->seccomp_fprog.len = 0;
+	nsjconf->seccomp_fprog_post.filter = NULL;
+	nsjconf->seccomp_fprog_post.len = 0;
+	size_t iters = 1000000;
+
+	static const struct option opts[] = {
+	    {"seccomp_policy", required_argument, NULL, 'P'},
+	    {"seccomp_string", required_argument, NULL, 's'},
+	    {"iterations", required_argument, NULL, 'n'},
+	    {"seccomp_hot_syscall", required_argument, NULL, 'H'},
+	    {"help", no_argument, NULL, 'h'},
+	    {NULL, 0, NULL, 0},
+	};
+	for (;;) {
+		int c = getopt_long(argc, argv, "P:s:n:H:h", opts, NULL);
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+		case 'P':
+			nsjconf->kafel_file_path = optarg;
+			break;
+		case 's':
+			nsjconf->kafel_string = optarg;
+			break;
+		case 'n':
+			iters = strtoull(optarg, NULL, 0);
+			break;
+		case 'H':
+			nsjconf->seccomp_hot_syscalls.push_back(strtoul(optarg, NULL, 0));
+			break;
+		default:
+			bench::usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (nsjconf->kafel_file_path.empty() && nsjconf->kafel_string.empty()) {
+		bench::usage(argv[0]);
+		return 1;
+	}
+	if (iters == 0) {
+		LOG_F("The number of iterations must be > 0");
+	}
+
+	if (!sandbox::preparePolicy(nsjconf.get())) {
+		LOG_F("Couldn't prepare the seccomp policy");
+	}
+	if ((bench::zeroFd = open("/dev/zero", O_RDONLY | O_CLOEXEC)) == -1) {
+		PLOG_F("open('/dev/zero')");
+	}
+
+	bench::runAll(iters, 0);
+	if (!sandbox::applyPolicy(nsjconf.get(), "", /* notify_sock= */ -1)) {
+		LOG_F("Couldn't install the seccomp policy");
+	}
+	bench::runAll(iters, 1);
+
+	printf("Policy: %u BPF instructions, %zu iterations per test\n",
+	    (unsigned)nsjconf->seccomp_fprog.len, iters);
+	printf("%-18s %14s %14s %14s\n", "syscall", "ns (no filter)", "ns (filter)", "overhead ns");
+	for (const auto& t : bench::tests) {
+		printf("%-18s %14.1f %14.1f %14.1f\n", t.name, t.ns[0], t.ns[1], t.ns[1] - t.ns[0]);
+	}
+	sandbox::closePolicy(nsjconf.get());
+	return 0;
+}
@@ -23,6 +23,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <linux/sched.h>
 #include <sched.h>
@@ -34,6 +35,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -41,15 +43,22 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "cgroup.h"
 #include "contain.h"
+#include "events.h"
 #include "logs.h"
 #include "macros.h"
+#include "mnt.h"
 #include "net.h"
+#include "nspool.h"
+#include "portfwd.h"
 #include "sandbox.h"
+#include "syscalls.h"
+#include "unotify.h"
 #include "user.h"
 #include "util.h"
 
@@ -130,7 +139,8 @@ static bool resetEnv(void) {
 
 static const char kSubprocDoneChar = 'D';
 
-static int subprocNewProc(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err, int pipefd) {
+static int subprocNewProc(nsjconf_t* nsjconf, const listener_t* listener, int fd_in, int fd_out,
+    int fd_err, int pipefd) {
 	if (!contain::setupFD(nsjconf, fd_in, fd_out, fd_err)) {
 		_exit(0xff);
 	}
@@ -148,6 +158,9 @@ static int subprocNewProc(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err,
 			_exit(0xff);
 		}
 	} else {
+		if (!mnt::recvIdmapFds(nsjconf, pipefd)) {
+			_exit(0xff);
+		}
 		char doneChar;
 		if (util::readFromFd(pipefd, &doneChar, sizeof(doneChar)) != sizeof(doneChar)) {
 			_exit(0xff);
@@ -166,22 +179,26 @@ static int subprocNewProc(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err,
 		putenv(const_cast<char*>(env.c_str()));
 	}
 
+	/* Listeners can have their own binaries to execute */
+	bool own_exec = (listener != NULL && !listener->argv.empty());
+	const std::string& exec_file = own_exec ? listener->exec_file : nsjconf->exec_file;
 	auto connstr = net::connToText(fd_in, /* remote= */ true, NULL);
-	LOG_I("Executing '%s' for '%s'", nsjconf->exec_file.c_str(), connstr.c_str());
+	LOG_I("Executing '%s' for '%s'", exec_file.c_str(), connstr.c_str());
 
 	std::vector<const char*> argv;
-	for (const auto& s : nsjconf->argv) {
+	for (const auto& s : own_exec ? listener->argv : nsjconf->argv) {
 		argv.push_back(s.c_str());
 		LOG_D(" Arg: '%s'", s.c_str());
 	}
 	argv.push_back(nullptr);
 
 	/* Should be the last one in the sequence */
-	if (!sandbox::applyPolicy(nsjconf)) {
+	if (!sandbox::applyPolicy(
+		nsjconf, listener != NULL ? listener->seccomp_policy : "", pipefd)) {
 		exit(0xff);
 	}
 
-	if (nsjconf->use_execveat) {
+	if (nsjconf->use_execveat && !own_exec) {
 #if defined(__NR_execveat)
 		syscall(__NR_execveat, (uintptr_t)nsjconf->exec_fd, "", (char* const*)argv.data(),
 		    environ, (uintptr_t)AT_EMPTY_PATH);
@@ -189,24 +206,17 @@ static int subprocNewProc(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err,
 		LOG_F("Your system doesn't support execveat() syscall");
 #endif /* defined(__NR_execveat) */
 	} else {
-		execv(nsjconf->exec_file.c_str(), (char* const*)argv.data());
+		execv(exec_file.c_str(), (char* const*)argv.data());
 	}
 
-	PLOG_E("execve('%s') failed", nsjconf->exec_file.c_str());
+	PLOG_E("execve('%s') failed", exec_file.c_str());
 
 	_exit(0xff);
 }
 
-static void addProc(nsjconf_t* nsjconf, pid_t pid, int sock) {
-	pids_t p;
-
-	p.pid = pid;
-	p.start = time(NULL);
-	p.remote_txt = net::connToText(sock, /* remote= */ true, &p.remote_addr);
-
-	char fname[PATH_MAX];
-	snprintf(fname, sizeof(fname), "/proc/%d/syscall", (int)pid);
-	p.pid_syscall_fd = TEMP_FAILURE_RETRY(open(fname, O_RDONLY | O_CLOEXEC));
+/* Also used for jails started by the previous nsjail binary, see upgrade.cc */
+void adoptProc(nsjconf_t* nsjconf, pids_t p) {
+	p.conf = nsjconf->shared_from_this();
 
 	nsjconf->pids.push_back(p);
 
@@ -214,13 +224,29 @@ static void addProc(nsjconf_t* nsjconf, pid_t pid, int sock) {
 	    (unsigned int)p.start, p.remote_txt.c_str());
 }
 
+static void addProc(nsjconf_t* nsjconf, pid_t pid, int sock, uint64_t spawn_us) {
+	pids_t p;
+
+	p.pid = pid;
+	p.start = time(NULL);
+	p.remote_txt = net::connToText(sock, /* remote= */ true, &p.remote_addr);
+	p.start_us = events::nowUs();
+	p.clone_us = p.start_us - spawn_us;
+	p.setup_us = 0;
+	adoptProc(nsjconf, p);
+	events::spawn(nsjconf->pids.back());
+}
+
 static void removeProc(nsjconf_t* nsjconf, pid_t pid) {
 	for (auto p = nsjconf->pids.begin(); p != nsjconf->pids.end(); ++p) {
 		if (p->pid == pid) {
 			LOG_D("Removing pid '%d' from the queue (IP:'%s', start time:'%s')", p->pid,
 			    p->remote_txt.c_str(), util::timeToStr(p->start).c_str());
-			close(p->pid_syscall_fd);
 			nsjconf->pids.erase(p);
+			portfwd::detach(nsjconf, pid);
+			unotify::detach(nsjconf, pid);
+			net::releaseNs(nsjconf, pid);
+			nspool::release(nsjconf, pid);
 			return;
 		}
 	}
@@ -236,9 +262,10 @@ void displayProc(nsjconf_t* nsjconf) {
 	time_t now = time(NULL);
 	for (const auto& pid : nsjconf->pids) {
 		time_t diff = now - pid.start;
-		time_t left = nsjconf->tlimit ? nsjconf->tlimit - diff : 0;
-		LOG_I("PID: %d, Remote host: %s, Run time: %ld sec. (time left: %ld sec.)", pid.pid,
-		    pid.remote_txt.c_str(), (long)diff, (long)left);
+		time_t left = pid.conf->tlimit ? pid.conf->tlimit - diff : 0;
+		LOG_I("PID: %d, Remote host: %s, Run time: %ld sec. (time left: %ld sec.)%s",
+		    pid.pid, pid.remote_txt.c_str(), (long)diff, (long)left,
+		    net::statsToText(nsjconf, pid.pid).c_str());
 	}
 }
 
@@ -251,6 +278,41 @@ static const pids_t* getPidElem(nsjconf_t* nsjconf, pid_t pid) {
 	return NULL;
 }
 
+/*
+ * '<nr> <args...> <sp> <pc>', or '<nr> <sp> <pc>' if the registers aren't known (nr is -1 then,
+ * e.g. for zombies)
+ */
+static bool readSyscall(pid_t pid, syscalls::call_t* call) {
+	char fname[PATH_MAX];
+	snprintf(fname, sizeof(fname), "/proc/%d/syscall", (int)pid);
+	char buf[4096];
+	ssize_t rdsize = util::readFromFile(fname, buf, sizeof(buf) - 1);
+	if (rdsize < 1) {
+		return false;
+	}
+	buf[rdsize] = '\0';
+
+	*call = {};
+	call->pid = pid;
+	uint64_t* a = call->args;
+	int ret = sscanf(buf,
+	    "%ld %" SCNx64 " %" SCNx64 " %" SCNx64 " %" SCNx64 " %" SCNx64 " %" SCNx64 " %" SCNx64
+	    " %" SCNx64,
+	    &call->nr, &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &call->sp, &call->pc);
+	if (ret == 9) {
+		call->has_args = true;
+		return true;
+	}
+	if (ret == 3) {
+		call->sp = a[0];
+		call->pc = a[1];
+		a[0] = a[1] = 0;
+		return true;
+	}
+	LOG_D("PID: %d, unexpected syscall info: '%s'", (int)pid, buf);
+	return false;
+}
+
 static void seccompViolation(nsjconf_t* nsjconf, siginfo_t* si) {
 	LOG_W("PID: %d commited a syscall/seccomp violation and exited with SIGSYS", si->si_pid);
 
@@ -262,35 +324,26 @@ static void seccompViolation(nsjconf_t* nsjconf, siginfo_t* si) {
 		return;
 	}
 
-	char buf[4096];
-	ssize_t rdsize = util::readFromFd(p->pid_syscall_fd, buf, sizeof(buf) - 1);
-	if (rdsize < 1) {
+	/* Read only now, the file is rarely needed */
+	syscalls::call_t call;
+	if (readSyscall(si->si_pid, &call)) {
+		LOG_W("PID: %d, seccomp violation: remote='%s' %s", (int)si->si_pid,
+		    p->remote_txt.c_str(), syscalls::callToStr(call).c_str());
+	} else {
 		LOG_W("PID: %d, SiSyscall: %d, SiCode: %d, SiErrno: %d", (int)si->si_pid,
 		    si->si_syscall, si->si_code, si->si_errno);
-		return;
-	}
-	buf[rdsize - 1] = '\0';
-
-	uintptr_t arg1, arg2, arg3, arg4, arg5, arg6, sp, pc;
-	ptrdiff_t sc;
-	int ret = sscanf(buf, "%td %tx %tx %tx %tx %tx %tx %tx %tx", &sc, &arg1, &arg2, &arg3,
-	    &arg4, &arg5, &arg6, &sp, &pc);
-	if (ret == 9) {
-		LOG_W(
-		    "PID: %d, Syscall number: %td, Arguments: %#tx, %#tx, %#tx, %#tx, %#tx, %#tx, "
-		    "SP: %#tx, PC: %#tx, si_syscall: %d, si_errno: %#x",
-		    (int)si->si_pid, sc, arg1, arg2, arg3, arg4, arg5, arg6, sp, pc, si->si_syscall,
-		    si->si_errno);
-	} else if (ret == 3) {
-		LOG_W("PID: %d, SiSyscall: %d, SiCode: %d, SiErrno: %d, SP: %#tx, PC: %#tx",
-		    (int)si->si_pid, si->si_syscall, si->si_code, si->si_errno, arg1, arg2);
-	} else {
-		LOG_W("PID: %d, SiSyscall: %d, SiCode: %d, SiErrno: %d, Syscall string '%s'",
-		    (int)si->si_pid, si->si_syscall, si->si_code, si->si_errno, buf);
+		call = {};
+		call.pid = si->si_pid;
+		call.nr = -1;
 	}
+	events::seccompViolation(*p, call);
 }
 
 int reapProc(nsjconf_t* nsjconf) {
+	return reapProc(nsjconf, NULL);
+}
+
+int reapProc(nsjconf_t* nsjconf, std::vector<reaped_t>* reaped) {
 	int status;
 	int rv = 0;
 	siginfo_t si;
@@ -307,19 +360,31 @@ int reapProc(nsjconf_t* nsjconf) {
 			seccompViolation(nsjconf, &si);
 		}
 
-		if (wait4(si.si_pid, &status, WNOHANG, NULL) == si.si_pid) {
-			cgroup::finishFromParent(nsjconf, si.si_pid);
-
+		struct rusage ru;
+		if (wait4(si.si_pid, &status, WNOHANG, &ru) == si.si_pid) {
 			std::string remote_txt = "[UNKNOWN]";
+			uint64_t run_us = 0;
 			const pids_t* elem = getPidElem(nsjconf, si.si_pid);
 			if (elem) {
 				remote_txt = elem->remote_txt;
+				if (elem->start_us != 0) {
+					run_us = events::nowUs() - elem->start_us;
+				}
+				if (cgroup::oomKilled(elem->conf.get(), si.si_pid)) {
+					events::oom(*elem);
+				}
+				events::exited(*elem, status, ru);
 			}
+			/* With the cgroup paths the jail was started with */
+			cgroup::finishFromParent(elem ? elem->conf.get() : nsjconf, si.si_pid);
+
+			/* Must be read before the jail's network interface is released */
+			const std::string traffic = net::statsToText(nsjconf, si.si_pid);
 
 			if (WIFEXITED(status)) {
-				LOG_I("PID: %d (%s) exited with status: %d, (PIDs left: %d)",
+				LOG_I("PID: %d (%s) exited with status: %d, (PIDs left: %d)%s",
 				    si.si_pid, remote_txt.c_str(), WEXITSTATUS(status),
-				    countProc(nsjconf) - 1);
+				    countProc(nsjconf) - 1, traffic.c_str());
 				removeProc(nsjconf, si.si_pid);
 				rv = WEXITSTATUS(status) % 100;
 				if (rv == 0 && WEXITSTATUS(status) != 0) {
@@ -327,27 +392,31 @@ int reapProc(nsjconf_t* nsjconf) {
 				}
 			}
 			if (WIFSIGNALED(status)) {
-				LOG_I(
-				    "PID: %d (%s) terminated with signal: %s (%d), (PIDs left: %d)",
+				LOG_I("PID: %d (%s) terminated with signal: %s (%d), (PIDs left: "
+				      "%d)%s",
 				    si.si_pid, remote_txt.c_str(),
 				    util::sigName(WTERMSIG(status)).c_str(), WTERMSIG(status),
-				    countProc(nsjconf) - 1);
+				    countProc(nsjconf) - 1, traffic.c_str());
 				removeProc(nsjconf, si.si_pid);
 				rv = 100 + WTERMSIG(status);
 			}
+			if (reaped) {
+				reaped->push_back({si.si_pid, status, ru, run_us});
+			}
 		}
 	}
 
 	time_t now = time(NULL);
 	for (const auto& p : nsjconf->pids) {
-		if (nsjconf->tlimit == 0) {
+		if (p.conf->tlimit == 0) {
 			continue;
 		}
 		pid_t pid = p.pid;
 		time_t diff = now - p.start;
-		if (diff >= nsjconf->tlimit) {
+		if (diff >= p.conf->tlimit) {
 			LOG_I("PID: %d run time >= time limit (%ld >= %ld) (%s). Killing it", pid,
-			    (long)diff, (long)nsjconf->tlimit, p.remote_txt.c_str());
+			    (long)diff, (long)p.conf->tlimit, p.remote_txt.c_str());
+			events::timeLimit(p, diff);
 			/*
 			 * Probably a kernel bug - some processes cannot be killed with KILL if
 			 * they're namespaced, and in a stopped state
@@ -358,6 +427,7 @@ int reapProc(nsjconf_t* nsjconf) {
 			PLOG_D("Sent SIGKILL to PID: %d", pid);
 		}
 	}
+	events::flush();
 	return rv;
 }
 
@@ -380,6 +450,10 @@ static bool initParent(nsjconf_t* nsjconf, pid_t pid, int pipefd) {
 		LOG_E("Couldn't initialize user namespaces for pid %d", pid);
 		return false;
 	}
+	if (!mnt::initNsFromParent(nsjconf, pid, pipefd)) {
+		LOG_E("Couldn't create ID-mapped mounts for pid %d", pid);
+		return false;
+	}
 	if (util::writeToFd(pipefd, &kSubprocDoneChar, sizeof(kSubprocDoneChar)) !=
 	    sizeof(kSubprocDoneChar)) {
 		LOG_E("Couldn't signal the new process via a socketpair");
@@ -388,9 +462,11 @@ static bool initParent(nsjconf_t* nsjconf, pid_t pid, int pipefd) {
 	return true;
 }
 
-void runChild(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err) {
+pid_t runChild(
+    nsjconf_t* nsjconf, const listener_t* listener, int fd_in, int fd_out, int fd_err) {
+	uint64_t spawn_us = events::nowUs();
 	if (!net::limitConns(nsjconf, fd_in)) {
-		return;
+		return -1;
 	}
 	unsigned long flags = 0UL;
 	flags |= (nsjconf->clone_newnet ? CLONE_NEWNET : 0);
@@ -407,7 +483,7 @@ void runChild(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err) {
 			PLOG_E("unshare(%s)", cloneFlagsToStr(flags).c_str());
 			_exit(0xff);
 		}
-		subprocNewProc(nsjconf, fd_in, fd_out, fd_err, -1);
+		subprocNewProc(nsjconf, listener, fd_in, fd_out, fd_err, -1);
 	}
 
 	flags |= SIGCHLD;
@@ -416,16 +492,22 @@ void runChild(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err) {
 	int sv[2];
 	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
 		PLOG_E("socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC) failed");
-		return;
+		return -1;
 	}
 	int child_fd = sv[0];
 	int parent_fd = sv[1];
 
+	if (!nspool::enter(nsjconf, &flags)) {
+		close(child_fd);
+		close(parent_fd);
+		return -1;
+	}
 	pid_t pid = cloneProc(flags);
 	if (pid == 0) {
 		close(parent_fd);
-		subprocNewProc(nsjconf, fd_in, fd_out, fd_err, child_fd);
+		subprocNewProc(nsjconf, listener, fd_in, fd_out, fd_err, child_fd);
 	}
+	nspool::leave(nsjconf, pid);
 	close(child_fd);
 	if (pid == -1) {
 		if (flags & CLONE_NEWCGROUP) {
@@ -440,16 +522,45 @@ void runChild(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err) {
 		    "kernel.unprivileged_userns_clone sysctl",
 		    cloneFlagsToStr(flags).c_str());
 		close(parent_fd);
-		return;
+		return -1;
 	}
-	addProc(nsjconf, pid, fd_in);
+	addProc(nsjconf, pid, fd_in, spawn_us);
 
 	if (!initParent(nsjconf, pid, parent_fd)) {
 		close(parent_fd);
-		return;
+		/* The child exits without the done byte, and is reaped as any other jail */
+		return pid;
 	}
+	/* The child goes on to execve() now */
+	for (auto& p : nsjconf->pids) {
+		if (p.pid == pid) {
+			p.setup_us = events::nowUs() - p.start_us;
+			events::exec(p);
+		}
+	}
+	portfwd::attach(nsjconf, pid);
+	unotify::attach(nsjconf, pid, parent_fd);
 
 	close(parent_fd);
+	return pid;
+}
+
+std::shared_ptr<nsjconf_t> copyConf(nsjconf_t* nsjconf) {
+	/* Not with reload::makeSnapshot()'s deleter: the seccomp programs and exec_fd are shared */
+	std::shared_ptr<nsjconf_t> copy = std::make_shared<nsjconf_t>(*nsjconf);
+	copy->pids.clear();
+	return copy;
+}
+
+pid_t runChildWithConf(nsjconf_t* nsjconf, std::shared_ptr<nsjconf_t> jailconf,
+    const listener_t* listener, int fd_in, int fd_out, int fd_err) {
+	pid_t pid = runChild(jailconf.get(), listener, fd_in, fd_out, fd_err);
+	/* pids_t::conf keeps jailconf around until the jail is reaped */
+	for (auto& p : jailconf->pids) {
+		nsjconf->pids.push_back(std::move(p));
+	}
+	jailconf->pids.clear();
+	return pid;
 }
 
 /*
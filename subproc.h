@@ -24,8 +24,10 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -33,12 +35,33 @@
 
 namespace subproc {
 
-void runChild(nsjconf_t* nsjconf, int fd_in, int fd_out, int fd_err);
+/* A jail collected by reapProc() */
+struct reaped_t {
+	pid_t pid;
+	int status;
+	struct rusage ru;
+	uint64_t run_us;
+};
+
+/* Returns the jail's pid, or -1 if it couldn't be started */
+pid_t runChild(
+    nsjconf_t* nsjconf, const listener_t* listener, int fd_in, int fd_out, int fd_err);
+/*
+ * A copy of the prepared configuration, for a jail with its own limits. The compiled seccomp
+ * programs, the mount list, the namespace pools etc. are shared with 'nsjconf'
+ */
+std::shared_ptr<nsjconf_t> copyConf(nsjconf_t* nsjconf);
+/* runChild() with such a copy, the jail is tracked (and reaped) with the ones of 'nsjconf' */
+pid_t runChildWithConf(nsjconf_t* nsjconf, std::shared_ptr<nsjconf_t> jailconf,
+    const listener_t* listener, int fd_in, int fd_out, int fd_err);
 int countProc(nsjconf_t* nsjconf);
 void displayProc(nsjconf_t* nsjconf);
 void killAll(nsjconf_t* nsjconf);
+void adoptProc(nsjconf_t* nsjconf, pids_t p);
 /* Returns the exit code of the first failing subprocess, or 0 if none fail */
 int reapProc(nsjconf_t* nsjconf);
+/* The same, and appends the exit status of each collected jail to 'reaped' */
+int reapProc(nsjconf_t* nsjconf, std::vector<reaped_t>* reaped);
 int systemExe(const std::vector<std::string>& args, char** env);
 pid_t cloneProc(uintptr_t flags);
 
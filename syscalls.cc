@@ -0,0 +1,1669 @@
+/*
+
+   nsjail - syscall names and arguments
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "syscalls.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <string>
+
+#include "macros.h"
+#include "util.h"
+
+namespace syscalls {
+
+/*
+ * Argument kinds: 'd' - decimal, 'x' - hex, 'p' - pointer, 'f' - fd, 'o' - mode (octal),
+ * 'O' - open flags, 'P' - mmap protection, 'M' - mmap flags, 'C' - clone flags, 'S' - signal,
+ * 'A' - address family, 'T' - socket type. NULL: arguments unknown, all six are printed
+ */
+struct syscall_t {
+	const long nr;
+	const char* const name;
+	const char* const args;
+};
+
+static const syscall_t syscallTable[] = {
+#if defined(__NR__llseek)
+    {__NR__llseek, "_llseek", NULL},
+#endif
+#if defined(__NR__newselect)
+    {__NR__newselect, "_newselect", NULL},
+#endif
+#if defined(__NR__sysctl)
+    {__NR__sysctl, "_sysctl", NULL},
+#endif
+#if defined(__NR_accept)
+    {__NR_accept, "accept", "fpp"},
+#endif
+#if defined(__NR_accept4)
+    {__NR_accept4, "accept4", "fppT"},
+#endif
+#if defined(__NR_access)
+    {__NR_access, "access", "po"},
+#endif
+#if defined(__NR_acct)
+    {__NR_acct, "acct", "p"},
+#endif
+#if defined(__NR_add_key)
+    {__NR_add_key, "add_key", "pppdd"},
+#endif
+#if defined(__NR_adjtimex)
+    {__NR_adjtimex, "adjtimex", "p"},
+#endif
+#if defined(__NR_afs_syscall)
+    {__NR_afs_syscall, "afs_syscall", NULL},
+#endif
+#if defined(__NR_alarm)
+    {__NR_alarm, "alarm", NULL},
+#endif
+#if defined(__NR_arch_prctl)
+    {__NR_arch_prctl, "arch_prctl", "xp"},
+#endif
+#if defined(__NR_bdflush)
+    {__NR_bdflush, "bdflush", NULL},
+#endif
+#if defined(__NR_bind)
+    {__NR_bind, "bind", "fpd"},
+#endif
+#if defined(__NR_bpf)
+    {__NR_bpf, "bpf", "dpd"},
+#endif
+#if defined(__NR_break)
+    {__NR_break, "break", NULL},
+#endif
+#if defined(__NR_brk)
+    {__NR_brk, "brk", "p"},
+#endif
+#if defined(__NR_capget)
+    {__NR_capget, "capget", NULL},
+#endif
+#if defined(__NR_capset)
+    {__NR_capset, "capset", NULL},
+#endif
+#if defined(__NR_chdir)
+    {__NR_chdir, "chdir", "p"},
+#endif
+#if defined(__NR_chmod)
+    {__NR_chmod, "chmod", "po"},
+#endif
+#if defined(__NR_chown)
+    {__NR_chown, "chown", "pdd"},
+#endif
+#if defined(__NR_chown32)
+    {__NR_chown32, "chown32", NULL},
+#endif
+#if defined(__NR_chroot)
+    {__NR_chroot, "chroot", "p"},
+#endif
+#if defined(__NR_clock_adjtime)
+    {__NR_clock_adjtime, "clock_adjtime", NULL},
+#endif
+#if defined(__NR_clock_adjtime64)
+    {__NR_clock_adjtime64, "clock_adjtime64", NULL},
+#endif
+#if defined(__NR_clock_getres)
+    {__NR_clock_getres, "clock_getres", NULL},
+#endif
+#if defined(__NR_clock_getres_time64)
+    {__NR_clock_getres_time64, "clock_getres_time64", NULL},
+#endif
+#if defined(__NR_clock_gettime)
+    {__NR_clock_gettime, "clock_gettime", "dp"},
+#endif
+#if defined(__NR_clock_gettime64)
+    {__NR_clock_gettime64, "clock_gettime64", NULL},
+#endif
+#if defined(__NR_clock_nanosleep)
+    {__NR_clock_nanosleep, "clock_nanosleep", "dxpp"},
+#endif
+#if defined(__NR_clock_nanosleep_time64)
+    {__NR_clock_nanosleep_time64, "clock_nanosleep_time64", NULL},
+#endif
+#if defined(__NR_clock_settime)
+    {__NR_clock_settime, "clock_settime", "dp"},
+#endif
+#if defined(__NR_clock_settime64)
+    {__NR_clock_settime64, "clock_settime64", NULL},
+#endif
+#if defined(__NR_clone)
+    {__NR_clone, "clone", "Cp"},
+#endif
+#if defined(__NR_clone3)
+    {__NR_clone3, "clone3", "pd"},
+#endif
+#if defined(__NR_close)
+    {__NR_close, "close", "f"},
+#endif
+#if defined(__NR_close_range)
+    {__NR_close_range, "close_range", NULL},
+#endif
+#if defined(__NR_connect)
+    {__NR_connect, "connect", "fpd"},
+#endif
+#if defined(__NR_copy_file_range)
+    {__NR_copy_file_range, "copy_file_range", NULL},
+#endif
+#if defined(__NR_creat)
+    {__NR_creat, "creat", "po"},
+#endif
+#if defined(__NR_create_module)
+    {__NR_create_module, "create_module", NULL},
+#endif
+#if defined(__NR_delete_module)
+    {__NR_delete_module, "delete_module", "px"},
+#endif
+#if defined(__NR_dup)
+    {__NR_dup, "dup", "f"},
+#endif
+#if defined(__NR_dup2)
+    {__NR_dup2, "dup2", "ff"},
+#endif
+#if defined(__NR_dup3)
+    {__NR_dup3, "dup3", "ffO"},
+#endif
+#if defined(__NR_epoll_create)
+    {__NR_epoll_create, "epoll_create", NULL},
+#endif
+#if defined(__NR_epoll_create1)
+    {__NR_epoll_create1, "epoll_create1", "x"},
+#endif
+#if defined(__NR_epoll_ctl)
+    {__NR_epoll_ctl, "epoll_ctl", "fdfp"},
+#endif
+#if defined(__NR_epoll_ctl_old)
+    {__NR_epoll_ctl_old, "epoll_ctl_old", NULL},
+#endif
+#if defined(__NR_epoll_pwait)
+    {__NR_epoll_pwait, "epoll_pwait", "fpddpd"},
+#endif
+#if defined(__NR_epoll_pwait2)
+    {__NR_epoll_pwait2, "epoll_pwait2", NULL},
+#endif
+#if defined(__NR_epoll_wait)
+    {__NR_epoll_wait, "epoll_wait", "fpdd"},
+#endif
+#if defined(__NR_epoll_wait_old)
+    {__NR_epoll_wait_old, "epoll_wait_old", NULL},
+#endif
+#if defined(__NR_eventfd)
+    {__NR_eventfd, "eventfd", NULL},
+#endif
+#if defined(__NR_eventfd2)
+    {__NR_eventfd2, "eventfd2", "dx"},
+#endif
+#if defined(__NR_execve)
+    {__NR_execve, "execve", "ppp"},
+#endif
+#if defined(__NR_execveat)
+    {__NR_execveat, "execveat", "fppx"},
+#endif
+#if defined(__NR_exit)
+    {__NR_exit, "exit", "d"},
+#endif
+#if defined(__NR_exit_group)
+    {__NR_exit_group, "exit_group", "d"},
+#endif
+#if defined(__NR_faccessat)
+    {__NR_faccessat, "faccessat", "fpo"},
+#endif
+#if defined(__NR_faccessat2)
+    {__NR_faccessat2, "faccessat2", "fpox"},
+#endif
+#if defined(__NR_fadvise64)
+    {__NR_fadvise64, "fadvise64", NULL},
+#endif
+#if defined(__NR_fadvise64_64)
+    {__NR_fadvise64_64, "fadvise64_64", NULL},
+#endif
+#if defined(__NR_fallocate)
+    {__NR_fallocate, "fallocate", NULL},
+#endif
+#if defined(__NR_fanotify_init)
+    {__NR_fanotify_init, "fanotify_init", NULL},
+#endif
+#if defined(__NR_fanotify_mark)
+    {__NR_fanotify_mark, "fanotify_mark", NULL},
+#endif
+#if defined(__NR_fchdir)
+    {__NR_fchdir, "fchdir", "f"},
+#endif
+#if defined(__NR_fchmod)
+    {__NR_fchmod, "fchmod", "fo"},
+#endif
+#if defined(__NR_fchmodat)
+    {__NR_fchmodat, "fchmodat", "fpo"},
+#endif
+#if defined(__NR_fchown)
+    {__NR_fchown, "fchown", "fdd"},
+#endif
+#if defined(__NR_fchown32)
+    {__NR_fchown32, "fchown32", NULL},
+#endif
+#if defined(__NR_fchownat)
+    {__NR_fchownat, "fchownat", "fpddx"},
+#endif
+#if defined(__NR_fcntl)
+    {__NR_fcntl, "fcntl", "fdx"},
+#endif
+#if defined(__NR_fcntl64)
+    {__NR_fcntl64, "fcntl64", NULL},
+#endif
+#if defined(__NR_fdatasync)
+    {__NR_fdatasync, "fdatasync", "f"},
+#endif
+#if defined(__NR_fgetxattr)
+    {__NR_fgetxattr, "fgetxattr", NULL},
+#endif
+#if defined(__NR_finit_module)
+    {__NR_finit_module, "finit_module", "fpx"},
+#endif
+#if defined(__NR_flistxattr)
+    {__NR_flistxattr, "flistxattr", NULL},
+#endif
+#if defined(__NR_flock)
+    {__NR_flock, "flock", "fx"},
+#endif
+#if defined(__NR_fork)
+    {__NR_fork, "fork", ""},
+#endif
+#if defined(__NR_fremovexattr)
+    {__NR_fremovexattr, "fremovexattr", NULL},
+#endif
+#if defined(__NR_fsconfig)
+    {__NR_fsconfig, "fsconfig", NULL},
+#endif
+#if defined(__NR_fsetxattr)
+    {__NR_fsetxattr, "fsetxattr", NULL},
+#endif
+#if defined(__NR_fsmount)
+    {__NR_fsmount, "fsmount", "fxx"},
+#endif
+#if defined(__NR_fsopen)
+    {__NR_fsopen, "fsopen", "px"},
+#endif
+#if defined(__NR_fspick)
+    {__NR_fspick, "fspick", "fpx"},
+#endif
+#if defined(__NR_fstat)
+    {__NR_fstat, "fstat", "fp"},
+#endif
+#if defined(__NR_fstat64)
+    {__NR_fstat64, "fstat64", NULL},
+#endif
+#if defined(__NR_fstatat64)
+    {__NR_fstatat64, "fstatat64", NULL},
+#endif
+#if defined(__NR_fstatfs)
+    {__NR_fstatfs, "fstatfs", NULL},
+#endif
+#if defined(__NR_fstatfs64)
+    {__NR_fstatfs64, "fstatfs64", NULL},
+#endif
+#if defined(__NR_fsync)
+    {__NR_fsync, "fsync", "f"},
+#endif
+#if defined(__NR_ftime)
+    {__NR_ftime, "ftime", NULL},
+#endif
+#if defined(__NR_ftruncate)
+    {__NR_ftruncate, "ftruncate", "fd"},
+#endif
+#if defined(__NR_ftruncate64)
+    {__NR_ftruncate64, "ftruncate64", NULL},
+#endif
+#if defined(__NR_futex)
+    {__NR_futex, "futex", "pxdppd"},
+#endif
+#if defined(__NR_futex_time64)
+    {__NR_futex_time64, "futex_time64", NULL},
+#endif
+#if defined(__NR_futex_waitv)
+    {__NR_futex_waitv, "futex_waitv", NULL},
+#endif
+#if defined(__NR_futimesat)
+    {__NR_futimesat, "futimesat", NULL},
+#endif
+#if defined(__NR_get_kernel_syms)
+    {__NR_get_kernel_syms, "get_kernel_syms", NULL},
+#endif
+#if defined(__NR_get_mempolicy)
+    {__NR_get_mempolicy, "get_mempolicy", NULL},
+#endif
+#if defined(__NR_get_robust_list)
+    {__NR_get_robust_list, "get_robust_list", NULL},
+#endif
+#if defined(__NR_get_thread_area)
+    {__NR_get_thread_area, "get_thread_area", NULL},
+#endif
+#if defined(__NR_getcpu)
+    {__NR_getcpu, "getcpu", NULL},
+#endif
+#if defined(__NR_getcwd)
+    {__NR_getcwd, "getcwd", "pd"},
+#endif
+#if defined(__NR_getdents)
+    {__NR_getdents, "getdents", NULL},
+#endif
+#if defined(__NR_getdents64)
+    {__NR_getdents64, "getdents64", "fpd"},
+#endif
+#if defined(__NR_getegid)
+    {__NR_getegid, "getegid", ""},
+#endif
+#if defined(__NR_getegid32)
+    {__NR_getegid32, "getegid32", NULL},
+#endif
+#if defined(__NR_geteuid)
+    {__NR_geteuid, "geteuid", ""},
+#endif
+#if defined(__NR_geteuid32)
+    {__NR_geteuid32, "geteuid32", NULL},
+#endif
+#if defined(__NR_getgid)
+    {__NR_getgid, "getgid", ""},
+#endif
+#if defined(__NR_getgid32)
+    {__NR_getgid32, "getgid32", NULL},
+#endif
+#if defined(__NR_getgroups)
+    {__NR_getgroups, "getgroups", NULL},
+#endif
+#if defined(__NR_getgroups32)
+    {__NR_getgroups32, "getgroups32", NULL},
+#endif
+#if defined(__NR_getitimer)
+    {__NR_getitimer, "getitimer", NULL},
+#endif
+#if defined(__NR_getpeername)
+    {__NR_getpeername, "getpeername", "fpp"},
+#endif
+#if defined(__NR_getpgid)
+    {__NR_getpgid, "getpgid", NULL},
+#endif
+#if defined(__NR_getpgrp)
+    {__NR_getpgrp, "getpgrp", ""},
+#endif
+#if defined(__NR_getpid)
+    {__NR_getpid, "getpid", ""},
+#endif
+#if defined(__NR_getpmsg)
+    {__NR_getpmsg, "getpmsg", NULL},
+#endif
+#if defined(__NR_getppid)
+    {__NR_getppid, "getppid", ""},
+#endif
+#if defined(__NR_getpriority)
+    {__NR_getpriority, "getpriority", NULL},
+#endif
+#if defined(__NR_getrandom)
+    {__NR_getrandom, "getrandom", "pdx"},
+#endif
+#if defined(__NR_getresgid)
+    {__NR_getresgid, "getresgid", NULL},
+#endif
+#if defined(__NR_getresgid32)
+    {__NR_getresgid32, "getresgid32", NULL},
+#endif
+#if defined(__NR_getresuid)
+    {__NR_getresuid, "getresuid", NULL},
+#endif
+#if defined(__NR_getresuid32)
+    {__NR_getresuid32, "getresuid32", NULL},
+#endif
+#if defined(__NR_getrlimit)
+    {__NR_getrlimit, "getrlimit", "dp"},
+#endif
+#if defined(__NR_getrusage)
+    {__NR_getrusage, "getrusage", "dp"},
+#endif
+#if defined(__NR_getsid)
+    {__NR_getsid, "getsid", NULL},
+#endif
+#if defined(__NR_getsockname)
+    {__NR_getsockname, "getsockname", "fpp"},
+#endif
+#if defined(__NR_getsockopt)
+    {__NR_getsockopt, "getsockopt", "fddpp"},
+#endif
+#if defined(__NR_gettid)
+    {__NR_gettid, "gettid", ""},
+#endif
+#if defined(__NR_gettimeofday)
+    {__NR_gettimeofday, "gettimeofday", "pp"},
+#endif
+#if defined(__NR_getuid)
+    {__NR_getuid, "getuid", ""},
+#endif
+#if defined(__NR_getuid32)
+    {__NR_getuid32, "getuid32", NULL},
+#endif
+#if defined(__NR_getxattr)
+    {__NR_getxattr, "getxattr", NULL},
+#endif
+#if defined(__NR_gtty)
+    {__NR_gtty, "gtty", NULL},
+#endif
+#if defined(__NR_idle)
+    {__NR_idle, "idle", NULL},
+#endif
+#if defined(__NR_init_module)
+    {__NR_init_module, "init_module", "pdp"},
+#endif
+#if defined(__NR_inotify_add_watch)
+    {__NR_inotify_add_watch, "inotify_add_watch", NULL},
+#endif
+#if defined(__NR_inotify_init)
+    {__NR_inotify_init, "inotify_init", ""},
+#endif
+#if defined(__NR_inotify_init1)
+    {__NR_inotify_init1, "inotify_init1", "x"},
+#endif
+#if defined(__NR_inotify_rm_watch)
+    {__NR_inotify_rm_watch, "inotify_rm_watch", NULL},
+#endif
+#if defined(__NR_io_cancel)
+    {__NR_io_cancel, "io_cancel", NULL},
+#endif
+#if defined(__NR_io_destroy)
+    {__NR_io_destroy, "io_destroy", NULL},
+#endif
+#if defined(__NR_io_getevents)
+    {__NR_io_getevents, "io_getevents", NULL},
+#endif
+#if defined(__NR_io_pgetevents)
+    {__NR_io_pgetevents, "io_pgetevents", NULL},
+#endif
+#if defined(__NR_io_pgetevents_time64)
+    {__NR_io_pgetevents_time64, "io_pgetevents_time64", NULL},
+#endif
+#if defined(__NR_io_setup)
+    {__NR_io_setup, "io_setup", NULL},
+#endif
+#if defined(__NR_io_submit)
+    {__NR_io_submit, "io_submit", NULL},
+#endif
+#if defined(__NR_io_uring_enter)
+    {__NR_io_uring_enter, "io_uring_enter", NULL},
+#endif
+#if defined(__NR_io_uring_register)
+    {__NR_io_uring_register, "io_uring_register", NULL},
+#endif
+#if defined(__NR_io_uring_setup)
+    {__NR_io_uring_setup, "io_uring_setup", "dp"},
+#endif
+#if defined(__NR_ioctl)
+    {__NR_ioctl, "ioctl", "fxp"},
+#endif
+#if defined(__NR_ioperm)
+    {__NR_ioperm, "ioperm", "xdd"},
+#endif
+#if defined(__NR_iopl)
+    {__NR_iopl, "iopl", "d"},
+#endif
+#if defined(__NR_ioprio_get)
+    {__NR_ioprio_get, "ioprio_get", NULL},
+#endif
+#if defined(__NR_ioprio_set)
+    {__NR_ioprio_set, "ioprio_set", NULL},
+#endif
+#if defined(__NR_ipc)
+    {__NR_ipc, "ipc", NULL},
+#endif
+#if defined(__NR_kcmp)
+    {__NR_kcmp, "kcmp", "ddddd"},
+#endif
+#if defined(__NR_kexec_file_load)
+    {__NR_kexec_file_load, "kexec_file_load", "ffdpx"},
+#endif
+#if defined(__NR_kexec_load)
+    {__NR_kexec_load, "kexec_load", "xdpx"},
+#endif
+#if defined(__NR_keyctl)
+    {__NR_keyctl, "keyctl", "dxxxx"},
+#endif
+#if defined(__NR_kill)
+    {__NR_kill, "kill", "dS"},
+#endif
+#if defined(__NR_landlock_add_rule)
+    {__NR_landlock_add_rule, "landlock_add_rule", NULL},
+#endif
+#if defined(__NR_landlock_create_ruleset)
+    {__NR_landlock_create_ruleset, "landlock_create_ruleset", NULL},
+#endif
+#if defined(__NR_landlock_restrict_self)
+    {__NR_landlock_restrict_self, "landlock_restrict_self", NULL},
+#endif
+#if defined(__NR_lchown)
+    {__NR_lchown, "lchown", "pdd"},
+#endif
+#if defined(__NR_lchown32)
+    {__NR_lchown32, "lchown32", NULL},
+#endif
+#if defined(__NR_lgetxattr)
+    {__NR_lgetxattr, "lgetxattr", NULL},
+#endif
+#if defined(__NR_link)
+    {__NR_link, "link", "pp"},
+#endif
+#if defined(__NR_linkat)
+    {__NR_linkat, "linkat", "fpfpx"},
+#endif
+#if defined(__NR_listen)
+    {__NR_listen, "listen", "fd"},
+#endif
+#if defined(__NR_listxattr)
+    {__NR_listxattr, "listxattr", NULL},
+#endif
+#if defined(__NR_llistxattr)
+    {__NR_llistxattr, "llistxattr", NULL},
+#endif
+#if defined(__NR_llseek)
+    {__NR_llseek, "llseek", NULL},
+#endif
+#if defined(__NR_lock)
+    {__NR_lock, "lock", NULL},
+#endif
+#if defined(__NR_lookup_dcookie)
+    {__NR_lookup_dcookie, "lookup_dcookie", "xpd"},
+#endif
+#if defined(__NR_lremovexattr)
+    {__NR_lremovexattr, "lremovexattr", NULL},
+#endif
+#if defined(__NR_lseek)
+    {__NR_lseek, "lseek", "fdd"},
+#endif
+#if defined(__NR_lsetxattr)
+    {__NR_lsetxattr, "lsetxattr", NULL},
+#endif
+#if defined(__NR_lstat)
+    {__NR_lstat, "lstat", "pp"},
+#endif
+#if defined(__NR_lstat64)
+    {__NR_lstat64, "lstat64", NULL},
+#endif
+#if defined(__NR_madvise)
+    {__NR_madvise, "madvise", "pdd"},
+#endif
+#if defined(__NR_mbind)
+    {__NR_mbind, "mbind", NULL},
+#endif
+#if defined(__NR_membarrier)
+    {__NR_membarrier, "membarrier", NULL},
+#endif
+#if defined(__NR_memfd_create)
+    {__NR_memfd_create, "memfd_create", "px"},
+#endif
+#if defined(__NR_memfd_secret)
+    {__NR_memfd_secret, "memfd_secret", NULL},
+#endif
+#if defined(__NR_migrate_pages)
+    {__NR_migrate_pages, "migrate_pages", NULL},
+#endif
+#if defined(__NR_mincore)
+    {__NR_mincore, "mincore", NULL},
+#endif
+#if defined(__NR_mkdir)
+    {__NR_mkdir, "mkdir", "po"},
+#endif
+#if defined(__NR_mkdirat)
+    {__NR_mkdirat, "mkdirat", "fpo"},
+#endif
+#if defined(__NR_mknod)
+    {__NR_mknod, "mknod", "pox"},
+#endif
+#if defined(__NR_mknodat)
+    {__NR_mknodat, "mknodat", "fpox"},
+#endif
+#if defined(__NR_mlock)
+    {__NR_mlock, "mlock", NULL},
+#endif
+#if defined(__NR_mlock2)
+    {__NR_mlock2, "mlock2", NULL},
+#endif
+#if defined(__NR_mlockall)
+    {__NR_mlockall, "mlockall", NULL},
+#endif
+#if defined(__NR_mmap)
+    {__NR_mmap, "mmap", "pdPMfx"},
+#endif
+#if defined(__NR_mmap2)
+    {__NR_mmap2, "mmap2", "pdPMfx"},
+#endif
+#if defined(__NR_modify_ldt)
+    {__NR_modify_ldt, "modify_ldt", NULL},
+#endif
+#if defined(__NR_mount)
+    {__NR_mount, "mount", "pppxp"},
+#endif
+#if defined(__NR_mount_setattr)
+    {__NR_mount_setattr, "mount_setattr", "fpxpd"},
+#endif
+#if defined(__NR_move_mount)
+    {__NR_move_mount, "move_mount", "fpfpx"},
+#endif
+#if defined(__NR_move_pages)
+    {__NR_move_pages, "move_pages", NULL},
+#endif
+#if defined(__NR_mprotect)
+    {__NR_mprotect, "mprotect", "pdP"},
+#endif
+#if defined(__NR_mpx)
+    {__NR_mpx, "mpx", NULL},
+#endif
+#if defined(__NR_mq_getsetattr)
+    {__NR_mq_getsetattr, "mq_getsetattr", NULL},
+#endif
+#if defined(__NR_mq_notify)
+    {__NR_mq_notify, "mq_notify", NULL},
+#endif
+#if defined(__NR_mq_open)
+    {__NR_mq_open, "mq_open", NULL},
+#endif
+#if defined(__NR_mq_timedreceive)
+    {__NR_mq_timedreceive, "mq_timedreceive", NULL},
+#endif
+#if defined(__NR_mq_timedreceive_time64)
+    {__NR_mq_timedreceive_time64, "mq_timedreceive_time64", NULL},
+#endif
+#if defined(__NR_mq_timedsend)
+    {__NR_mq_timedsend, "mq_timedsend", NULL},
+#endif
+#if defined(__NR_mq_timedsend_time64)
+    {__NR_mq_timedsend_time64, "mq_timedsend_time64", NULL},
+#endif
+#if defined(__NR_mq_unlink)
+    {__NR_mq_unlink, "mq_unlink", NULL},
+#endif
+#if defined(__NR_mremap)
+    {__NR_mremap, "mremap", "pddxp"},
+#endif
+#if defined(__NR_msgctl)
+    {__NR_msgctl, "msgctl", NULL},
+#endif
+#if defined(__NR_msgget)
+    {__NR_msgget, "msgget", NULL},
+#endif
+#if defined(__NR_msgrcv)
+    {__NR_msgrcv, "msgrcv", NULL},
+#endif
+#if defined(__NR_msgsnd)
+    {__NR_msgsnd, "msgsnd", NULL},
+#endif
+#if defined(__NR_msync)
+    {__NR_msync, "msync", NULL},
+#endif
+#if defined(__NR_munlock)
+    {__NR_munlock, "munlock", NULL},
+#endif
+#if defined(__NR_munlockall)
+    {__NR_munlockall, "munlockall", NULL},
+#endif
+#if defined(__NR_munmap)
+    {__NR_munmap, "munmap", "pd"},
+#endif
+#if defined(__NR_name_to_handle_at)
+    {__NR_name_to_handle_at, "name_to_handle_at", "fpppx"},
+#endif
+#if defined(__NR_nanosleep)
+    {__NR_nanosleep, "nanosleep", "pp"},
+#endif
+#if defined(__NR_newfstatat)
+    {__NR_newfstatat, "newfstatat", "fppx"},
+#endif
+#if defined(__NR_nfsservctl)
+    {__NR_nfsservctl, "nfsservctl", NULL},
+#endif
+#if defined(__NR_nice)
+    {__NR_nice, "nice", NULL},
+#endif
+#if defined(__NR_oldfstat)
+    {__NR_oldfstat, "oldfstat", NULL},
+#endif
+#if defined(__NR_oldlstat)
+    {__NR_oldlstat, "oldlstat", NULL},
+#endif
+#if defined(__NR_oldolduname)
+    {__NR_oldolduname, "oldolduname", NULL},
+#endif
+#if defined(__NR_oldstat)
+    {__NR_oldstat, "oldstat", NULL},
+#endif
+#if defined(__NR_olduname)
+    {__NR_olduname, "olduname", NULL},
+#endif
+#if defined(__NR_open)
+    {__NR_open, "open", "pOo"},
+#endif
+#if defined(__NR_open_by_handle_at)
+    {__NR_open_by_handle_at, "open_by_handle_at", "fpO"},
+#endif
+#if defined(__NR_open_tree)
+    {__NR_open_tree, "open_tree", "fpx"},
+#endif
+#if defined(__NR_openat)
+    {__NR_openat, "openat", "fpOo"},
+#endif
+#if defined(__NR_openat2)
+    {__NR_openat2, "openat2", "fppd"},
+#endif
+#if defined(__NR_pause)
+    {__NR_pause, "pause", ""},
+#endif
+#if defined(__NR_perf_event_open)
+    {__NR_perf_event_open, "perf_event_open", "pddfx"},
+#endif
+#if defined(__NR_personality)
+    {__NR_personality, "personality", "x"},
+#endif
+#if defined(__NR_pidfd_getfd)
+    {__NR_pidfd_getfd, "pidfd_getfd", "ffx"},
+#endif
+#if defined(__NR_pidfd_open)
+    {__NR_pidfd_open, "pidfd_open", "dx"},
+#endif
+#if defined(__NR_pidfd_send_signal)
+    {__NR_pidfd_send_signal, "pidfd_send_signal", "fSpx"},
+#endif
+#if defined(__NR_pipe)
+    {__NR_pipe, "pipe", "p"},
+#endif
+#if defined(__NR_pipe2)
+    {__NR_pipe2, "pipe2", "pO"},
+#endif
+#if defined(__NR_pivot_root)
+    {__NR_pivot_root, "pivot_root", "pp"},
+#endif
+#if defined(__NR_pkey_alloc)
+    {__NR_pkey_alloc, "pkey_alloc", NULL},
+#endif
+#if defined(__NR_pkey_free)
+    {__NR_pkey_free, "pkey_free", NULL},
+#endif
+#if defined(__NR_pkey_mprotect)
+    {__NR_pkey_mprotect, "pkey_mprotect", NULL},
+#endif
+#if defined(__NR_poll)
+    {__NR_poll, "poll", "pdd"},
+#endif
+#if defined(__NR_ppoll)
+    {__NR_ppoll, "ppoll", "pdppd"},
+#endif
+#if defined(__NR_ppoll_time64)
+    {__NR_ppoll_time64, "ppoll_time64", NULL},
+#endif
+#if defined(__NR_prctl)
+    {__NR_prctl, "prctl", "dxxxx"},
+#endif
+#if defined(__NR_pread64)
+    {__NR_pread64, "pread64", "fpdd"},
+#endif
+#if defined(__NR_preadv)
+    {__NR_preadv, "preadv", NULL},
+#endif
+#if defined(__NR_preadv2)
+    {__NR_preadv2, "preadv2", NULL},
+#endif
+#if defined(__NR_prlimit64)
+    {__NR_prlimit64, "prlimit64", "ddpp"},
+#endif
+#if defined(__NR_process_madvise)
+    {__NR_process_madvise, "process_madvise", NULL},
+#endif
+#if defined(__NR_process_mrelease)
+    {__NR_process_mrelease, "process_mrelease", NULL},
+#endif
+#if defined(__NR_process_vm_readv)
+    {__NR_process_vm_readv, "process_vm_readv", "dpdpdx"},
+#endif
+#if defined(__NR_process_vm_writev)
+    {__NR_process_vm_writev, "process_vm_writev", "dpdpdx"},
+#endif
+#if defined(__NR_prof)
+    {__NR_prof, "prof", NULL},
+#endif
+#if defined(__NR_profil)
+    {__NR_profil, "profil", NULL},
+#endif
+#if defined(__NR_pselect6)
+    {__NR_pselect6, "pselect6", NULL},
+#endif
+#if defined(__NR_pselect6_time64)
+    {__NR_pselect6_time64, "pselect6_time64", NULL},
+#endif
+#if defined(__NR_ptrace)
+    {__NR_ptrace, "ptrace", "ddpp"},
+#endif
+#if defined(__NR_putpmsg)
+    {__NR_putpmsg, "putpmsg", NULL},
+#endif
+#if defined(__NR_pwrite64)
+    {__NR_pwrite64, "pwrite64", "fpdd"},
+#endif
+#if defined(__NR_pwritev)
+    {__NR_pwritev, "pwritev", NULL},
+#endif
+#if defined(__NR_pwritev2)
+    {__NR_pwritev2, "pwritev2", NULL},
+#endif
+#if defined(__NR_query_module)
+    {__NR_query_module, "query_module", NULL},
+#endif
+#if defined(__NR_quotactl)
+    {__NR_quotactl, "quotactl", "xpdp"},
+#endif
+#if defined(__NR_quotactl_fd)
+    {__NR_quotactl_fd, "quotactl_fd", NULL},
+#endif
+#if defined(__NR_read)
+    {__NR_read, "read", "fpd"},
+#endif
+#if defined(__NR_readahead)
+    {__NR_readahead, "readahead", NULL},
+#endif
+#if defined(__NR_readdir)
+    {__NR_readdir, "readdir", NULL},
+#endif
+#if defined(__NR_readlink)
+    {__NR_readlink, "readlink", "ppd"},
+#endif
+#if defined(__NR_readlinkat)
+    {__NR_readlinkat, "readlinkat", "fppd"},
+#endif
+#if defined(__NR_readv)
+    {__NR_readv, "readv", "fpd"},
+#endif
+#if defined(__NR_reboot)
+    {__NR_reboot, "reboot", "xxxp"},
+#endif
+#if defined(__NR_recvfrom)
+    {__NR_recvfrom, "recvfrom", "fpdxpp"},
+#endif
+#if defined(__NR_recvmmsg)
+    {__NR_recvmmsg, "recvmmsg", NULL},
+#endif
+#if defined(__NR_recvmmsg_time64)
+    {__NR_recvmmsg_time64, "recvmmsg_time64", NULL},
+#endif
+#if defined(__NR_recvmsg)
+    {__NR_recvmsg, "recvmsg", "fpx"},
+#endif
+#if defined(__NR_remap_file_pages)
+    {__NR_remap_file_pages, "remap_file_pages", NULL},
+#endif
+#if defined(__NR_removexattr)
+    {__NR_removexattr, "removexattr", NULL},
+#endif
+#if defined(__NR_rename)
+    {__NR_rename, "rename", "pp"},
+#endif
+#if defined(__NR_renameat)
+    {__NR_renameat, "renameat", "fpfp"},
+#endif
+#if defined(__NR_renameat2)
+    {__NR_renameat2, "renameat2", "fpfpx"},
+#endif
+#if defined(__NR_request_key)
+    {__NR_request_key, "request_key", "pppd"},
+#endif
+#if defined(__NR_restart_syscall)
+    {__NR_restart_syscall, "restart_syscall", ""},
+#endif
+#if defined(__NR_rmdir)
+    {__NR_rmdir, "rmdir", "p"},
+#endif
+#if defined(__NR_rseq)
+    {__NR_rseq, "rseq", NULL},
+#endif
+#if defined(__NR_rt_sigaction)
+    {__NR_rt_sigaction, "rt_sigaction", "Sppd"},
+#endif
+#if defined(__NR_rt_sigpending)
+    {__NR_rt_sigpending, "rt_sigpending", NULL},
+#endif
+#if defined(__NR_rt_sigprocmask)
+    {__NR_rt_sigprocmask, "rt_sigprocmask", "dppd"},
+#endif
+#if defined(__NR_rt_sigqueueinfo)
+    {__NR_rt_sigqueueinfo, "rt_sigqueueinfo", NULL},
+#endif
+#if defined(__NR_rt_sigreturn)
+    {__NR_rt_sigreturn, "rt_sigreturn", ""},
+#endif
+#if defined(__NR_rt_sigsuspend)
+    {__NR_rt_sigsuspend, "rt_sigsuspend", NULL},
+#endif
+#if defined(__NR_rt_sigtimedwait)
+    {__NR_rt_sigtimedwait, "rt_sigtimedwait", NULL},
+#endif
+#if defined(__NR_rt_sigtimedwait_time64)
+    {__NR_rt_sigtimedwait_time64, "rt_sigtimedwait_time64", NULL},
+#endif
+#if defined(__NR_rt_tgsigqueueinfo)
+    {__NR_rt_tgsigqueueinfo, "rt_tgsigqueueinfo", NULL},
+#endif
+#if defined(__NR_sched_get_priority_max)
+    {__NR_sched_get_priority_max, "sched_get_priority_max", NULL},
+#endif
+#if defined(__NR_sched_get_priority_min)
+    {__NR_sched_get_priority_min, "sched_get_priority_min", NULL},
+#endif
+#if defined(__NR_sched_getaffinity)
+    {__NR_sched_getaffinity, "sched_getaffinity", NULL},
+#endif
+#if defined(__NR_sched_getattr)
+    {__NR_sched_getattr, "sched_getattr", NULL},
+#endif
+#if defined(__NR_sched_getparam)
+    {__NR_sched_getparam, "sched_getparam", NULL},
+#endif
+#if defined(__NR_sched_getscheduler)
+    {__NR_sched_getscheduler, "sched_getscheduler", NULL},
+#endif
+#if defined(__NR_sched_rr_get_interval)
+    {__NR_sched_rr_get_interval, "sched_rr_get_interval", NULL},
+#endif
+#if defined(__NR_sched_rr_get_interval_time64)
+    {__NR_sched_rr_get_interval_time64, "sched_rr_get_interval_time64", NULL},
+#endif
+#if defined(__NR_sched_setaffinity)
+    {__NR_sched_setaffinity, "sched_setaffinity", NULL},
+#endif
+#if defined(__NR_sched_setattr)
+    {__NR_sched_setattr, "sched_setattr", NULL},
+#endif
+#if defined(__NR_sched_setparam)
+    {__NR_sched_setparam, "sched_setparam", NULL},
+#endif
+#if defined(__NR_sched_setscheduler)
+    {__NR_sched_setscheduler, "sched_setscheduler", NULL},
+#endif
+#if defined(__NR_sched_yield)
+    {__NR_sched_yield, "sched_yield", ""},
+#endif
+#if defined(__NR_seccomp)
+    {__NR_seccomp, "seccomp", "dxp"},
+#endif
+#if defined(__NR_security)
+    {__NR_security, "security", NULL},
+#endif
+#if defined(__NR_select)
+    {__NR_select, "select", NULL},
+#endif
+#if defined(__NR_semctl)
+    {__NR_semctl, "semctl", NULL},
+#endif
+#if defined(__NR_semget)
+    {__NR_semget, "semget", NULL},
+#endif
+#if defined(__NR_semop)
+    {__NR_semop, "semop", NULL},
+#endif
+#if defined(__NR_semtimedop)
+    {__NR_semtimedop, "semtimedop", NULL},
+#endif
+#if defined(__NR_semtimedop_time64)
+    {__NR_semtimedop_time64, "semtimedop_time64", NULL},
+#endif
+#if defined(__NR_sendfile)
+    {__NR_sendfile, "sendfile", NULL},
+#endif
+#if defined(__NR_sendfile64)
+    {__NR_sendfile64, "sendfile64", NULL},
+#endif
+#if defined(__NR_sendmmsg)
+    {__NR_sendmmsg, "sendmmsg", NULL},
+#endif
+#if defined(__NR_sendmsg)
+    {__NR_sendmsg, "sendmsg", "fpx"},
+#endif
+#if defined(__NR_sendto)
+    {__NR_sendto, "sendto", "fpdxpd"},
+#endif
+#if defined(__NR_set_mempolicy)
+    {__NR_set_mempolicy, "set_mempolicy", NULL},
+#endif
+#if defined(__NR_set_mempolicy_home_node)
+    {__NR_set_mempolicy_home_node, "set_mempolicy_home_node", NULL},
+#endif
+#if defined(__NR_set_robust_list)
+    {__NR_set_robust_list, "set_robust_list", "pd"},
+#endif
+#if defined(__NR_set_thread_area)
+    {__NR_set_thread_area, "set_thread_area", NULL},
+#endif
+#if defined(__NR_set_tid_address)
+    {__NR_set_tid_address, "set_tid_address", "p"},
+#endif
+#if defined(__NR_setdomainname)
+    {__NR_setdomainname, "setdomainname", "pd"},
+#endif
+#if defined(__NR_setfsgid)
+    {__NR_setfsgid, "setfsgid", NULL},
+#endif
+#if defined(__NR_setfsgid32)
+    {__NR_setfsgid32, "setfsgid32", NULL},
+#endif
+#if defined(__NR_setfsuid)
+    {__NR_setfsuid, "setfsuid", NULL},
+#endif
+#if defined(__NR_setfsuid32)
+    {__NR_setfsuid32, "setfsuid32", NULL},
+#endif
+#if defined(__NR_setgid)
+    {__NR_setgid, "setgid", "d"},
+#endif
+#if defined(__NR_setgid32)
+    {__NR_setgid32, "setgid32", NULL},
+#endif
+#if defined(__NR_setgroups)
+    {__NR_setgroups, "setgroups", NULL},
+#endif
+#if defined(__NR_setgroups32)
+    {__NR_setgroups32, "setgroups32", NULL},
+#endif
+#if defined(__NR_sethostname)
+    {__NR_sethostname, "sethostname", "pd"},
+#endif
+#if defined(__NR_setitimer)
+    {__NR_setitimer, "setitimer", NULL},
+#endif
+#if defined(__NR_setns)
+    {__NR_setns, "setns", "fC"},
+#endif
+#if defined(__NR_setpgid)
+    {__NR_setpgid, "setpgid", NULL},
+#endif
+#if defined(__NR_setpriority)
+    {__NR_setpriority, "setpriority", NULL},
+#endif
+#if defined(__NR_setregid)
+    {__NR_setregid, "setregid", "dd"},
+#endif
+#if defined(__NR_setregid32)
+    {__NR_setregid32, "setregid32", NULL},
+#endif
+#if defined(__NR_setresgid)
+    {__NR_setresgid, "setresgid", "ddd"},
+#endif
+#if defined(__NR_setresgid32)
+    {__NR_setresgid32, "setresgid32", NULL},
+#endif
+#if defined(__NR_setresuid)
+    {__NR_setresuid, "setresuid", "ddd"},
+#endif
+#if defined(__NR_setresuid32)
+    {__NR_setresuid32, "setresuid32", NULL},
+#endif
+#if defined(__NR_setreuid)
+    {__NR_setreuid, "setreuid", "dd"},
+#endif
+#if defined(__NR_setreuid32)
+    {__NR_setreuid32, "setreuid32", NULL},
+#endif
+#if defined(__NR_setrlimit)
+    {__NR_setrlimit, "setrlimit", "dp"},
+#endif
+#if defined(__NR_setsid)
+    {__NR_setsid, "setsid", ""},
+#endif
+#if defined(__NR_setsockopt)
+    {__NR_setsockopt, "setsockopt", "fddpd"},
+#endif
+#if defined(__NR_settimeofday)
+    {__NR_settimeofday, "settimeofday", "pp"},
+#endif
+#if defined(__NR_setuid)
+    {__NR_setuid, "setuid", "d"},
+#endif
+#if defined(__NR_setuid32)
+    {__NR_setuid32, "setuid32", NULL},
+#endif
+#if defined(__NR_setxattr)
+    {__NR_setxattr, "setxattr", NULL},
+#endif
+#if defined(__NR_sgetmask)
+    {__NR_sgetmask, "sgetmask", NULL},
+#endif
+#if defined(__NR_shmat)
+    {__NR_shmat, "shmat", NULL},
+#endif
+#if defined(__NR_shmctl)
+    {__NR_shmctl, "shmctl", NULL},
+#endif
+#if defined(__NR_shmdt)
+    {__NR_shmdt, "shmdt", NULL},
+#endif
+#if defined(__NR_shmget)
+    {__NR_shmget, "shmget", NULL},
+#endif
+#if defined(__NR_shutdown)
+    {__NR_shutdown, "shutdown", "fd"},
+#endif
+#if defined(__NR_sigaction)
+    {__NR_sigaction, "sigaction", NULL},
+#endif
+#if defined(__NR_sigaltstack)
+    {__NR_sigaltstack, "sigaltstack", NULL},
+#endif
+#if defined(__NR_signal)
+    {__NR_signal, "signal", NULL},
+#endif
+#if defined(__NR_signalfd)
+    {__NR_signalfd, "signalfd", NULL},
+#endif
+#if defined(__NR_signalfd4)
+    {__NR_signalfd4, "signalfd4", "fpdx"},
+#endif
+#if defined(__NR_sigpending)
+    {__NR_sigpending, "sigpending", NULL},
+#endif
+#if defined(__NR_sigprocmask)
+    {__NR_sigprocmask, "sigprocmask", NULL},
+#endif
+#if defined(__NR_sigreturn)
+    {__NR_sigreturn, "sigreturn", NULL},
+#endif
+#if defined(__NR_sigsuspend)
+    {__NR_sigsuspend, "sigsuspend", NULL},
+#endif
+#if defined(__NR_socket)
+    {__NR_socket, "socket", "ATd"},
+#endif
+#if defined(__NR_socketcall)
+    {__NR_socketcall, "socketcall", "dp"},
+#endif
+#if defined(__NR_socketpair)
+    {__NR_socketpair, "socketpair", "ATdp"},
+#endif
+#if defined(__NR_splice)
+    {__NR_splice, "splice", NULL},
+#endif
+#if defined(__NR_ssetmask)
+    {__NR_ssetmask, "ssetmask", NULL},
+#endif
+#if defined(__NR_stat)
+    {__NR_stat, "stat", "pp"},
+#endif
+#if defined(__NR_stat64)
+    {__NR_stat64, "stat64", NULL},
+#endif
+#if defined(__NR_statfs)
+    {__NR_statfs, "statfs", NULL},
+#endif
+#if defined(__NR_statfs64)
+    {__NR_statfs64, "statfs64", NULL},
+#endif
+#if defined(__NR_statx)
+    {__NR_statx, "statx", "fpxxp"},
+#endif
+#if defined(__NR_stime)
+    {__NR_stime, "stime", NULL},
+#endif
+#if defined(__NR_stty)
+    {__NR_stty, "stty", NULL},
+#endif
+#if defined(__NR_swapoff)
+    {__NR_swapoff, "swapoff", "p"},
+#endif
+#if defined(__NR_swapon)
+    {__NR_swapon, "swapon", "px"},
+#endif
+#if defined(__NR_symlink)
+    {__NR_symlink, "symlink", "pp"},
+#endif
+#if defined(__NR_symlinkat)
+    {__NR_symlinkat, "symlinkat", "pfp"},
+#endif
+#if defined(__NR_sync)
+    {__NR_sync, "sync", ""},
+#endif
+#if defined(__NR_sync_file_range)
+    {__NR_sync_file_range, "sync_file_range", NULL},
+#endif
+#if defined(__NR_sync_file_range2)
+    {__NR_sync_file_range2, "sync_file_range2", NULL},
+#endif
+#if defined(__NR_syncfs)
+    {__NR_syncfs, "syncfs", NULL},
+#endif
+#if defined(__NR_sysfs)
+    {__NR_sysfs, "sysfs", NULL},
+#endif
+#if defined(__NR_sysinfo)
+    {__NR_sysinfo, "sysinfo", "p"},
+#endif
+#if defined(__NR_syslog)
+    {__NR_syslog, "syslog", "dpd"},
+#endif
+#if defined(__NR_tee)
+    {__NR_tee, "tee", NULL},
+#endif
+#if defined(__NR_tgkill)
+    {__NR_tgkill, "tgkill", "ddS"},
+#endif
+#if defined(__NR_time)
+    {__NR_time, "time", "p"},
+#endif
+#if defined(__NR_timer_create)
+    {__NR_timer_create, "timer_create", NULL},
+#endif
+#if defined(__NR_timer_delete)
+    {__NR_timer_delete, "timer_delete", NULL},
+#endif
+#if defined(__NR_timer_getoverrun)
+    {__NR_timer_getoverrun, "timer_getoverrun", NULL},
+#endif
+#if defined(__NR_timer_gettime)
+    {__NR_timer_gettime, "timer_gettime", NULL},
+#endif
+#if defined(__NR_timer_gettime64)
+    {__NR_timer_gettime64, "timer_gettime64", NULL},
+#endif
+#if defined(__NR_timer_settime)
+    {__NR_timer_settime, "timer_settime", NULL},
+#endif
+#if defined(__NR_timer_settime64)
+    {__NR_timer_settime64, "timer_settime64", NULL},
+#endif
+#if defined(__NR_timerfd_create)
+    {__NR_timerfd_create, "timerfd_create", "dx"},
+#endif
+#if defined(__NR_timerfd_gettime)
+    {__NR_timerfd_gettime, "timerfd_gettime", NULL},
+#endif
+#if defined(__NR_timerfd_gettime64)
+    {__NR_timerfd_gettime64, "timerfd_gettime64", NULL},
+#endif
+#if defined(__NR_timerfd_settime)
+    {__NR_timerfd_settime, "timerfd_settime", NULL},
+#endif
+#if defined(__NR_timerfd_settime64)
+    {__NR_timerfd_settime64, "timerfd_settime64", NULL},
+#endif
+#if defined(__NR_times)
+    {__NR_times, "times", "p"},
+#endif
+#if defined(__NR_tkill)
+    {__NR_tkill, "tkill", "dS"},
+#endif
+#if defined(__NR_truncate)
+    {__NR_truncate, "truncate", "pd"},
+#endif
+#if defined(__NR_truncate64)
+    {__NR_truncate64, "truncate64", NULL},
+#endif
+#if defined(__NR_tuxcall)
+    {__NR_tuxcall, "tuxcall", NULL},
+#endif
+#if defined(__NR_ugetrlimit)
+    {__NR_ugetrlimit, "ugetrlimit", NULL},
+#endif
+#if defined(__NR_ulimit)
+    {__NR_ulimit, "ulimit", NULL},
+#endif
+#if defined(__NR_umask)
+    {__NR_umask, "umask", "o"},
+#endif
+#if defined(__NR_umount)
+    {__NR_umount, "umount", NULL},
+#endif
+#if defined(__NR_umount2)
+    {__NR_umount2, "umount2", "px"},
+#endif
+#if defined(__NR_uname)
+    {__NR_uname, "uname", "p"},
+#endif
+#if defined(__NR_unlink)
+    {__NR_unlink, "unlink", "p"},
+#endif
+#if defined(__NR_unlinkat)
+    {__NR_unlinkat, "unlinkat", "fpx"},
+#endif
+#if defined(__NR_unshare)
+    {__NR_unshare, "unshare", "C"},
+#endif
+#if defined(__NR_uselib)
+    {__NR_uselib, "uselib", NULL},
+#endif
+#if defined(__NR_userfaultfd)
+    {__NR_userfaultfd, "userfaultfd", "x"},
+#endif
+#if defined(__NR_ustat)
+    {__NR_ustat, "ustat", NULL},
+#endif
+#if defined(__NR_utime)
+    {__NR_utime, "utime", NULL},
+#endif
+#if defined(__NR_utimensat)
+    {__NR_utimensat, "utimensat", NULL},
+#endif
+#if defined(__NR_utimensat_time64)
+    {__NR_utimensat_time64, "utimensat_time64", NULL},
+#endif
+#if defined(__NR_utimes)
+    {__NR_utimes, "utimes", NULL},
+#endif
+#if defined(__NR_vfork)
+    {__NR_vfork, "vfork", ""},
+#endif
+#if defined(__NR_vhangup)
+    {__NR_vhangup, "vhangup", ""},
+#endif
+#if defined(__NR_vm86)
+    {__NR_vm86, "vm86", NULL},
+#endif
+#if defined(__NR_vm86old)
+    {__NR_vm86old, "vm86old", NULL},
+#endif
+#if defined(__NR_vmsplice)
+    {__NR_vmsplice, "vmsplice", NULL},
+#endif
+#if defined(__NR_vserver)
+    {__NR_vserver, "vserver", NULL},
+#endif
+#if defined(__NR_wait4)
+    {__NR_wait4, "wait4", "dpxp"},
+#endif
+#if defined(__NR_waitid)
+    {__NR_waitid, "waitid", "ddpxp"},
+#endif
+#if defined(__NR_waitpid)
+    {__NR_waitpid, "waitpid", NULL},
+#endif
+#if defined(__NR_write)
+    {__NR_write, "write", "fpd"},
+#endif
+#if defined(__NR_writev)
+    {__NR_writev, "writev", "fpd"},
+#endif
+};
+
+struct flag_t {
+	const uint64_t flag;
+	const char* const name;
+};
+
+/* Flags made of several bits go first */
+static const flag_t openFlags[] = {
+#if defined(O_TMPFILE)
+    NS_VALSTR_STRUCT(O_TMPFILE),
+#endif
+    NS_VALSTR_STRUCT(O_SYNC),
+    NS_VALSTR_STRUCT(O_DSYNC),
+    NS_VALSTR_STRUCT(O_CREAT),
+    NS_VALSTR_STRUCT(O_EXCL),
+    NS_VALSTR_STRUCT(O_NOCTTY),
+    NS_VALSTR_STRUCT(O_TRUNC),
+    NS_VALSTR_STRUCT(O_APPEND),
+    NS_VALSTR_STRUCT(O_NONBLOCK),
+    NS_VALSTR_STRUCT(O_DIRECT),
+    NS_VALSTR_STRUCT(O_LARGEFILE),
+    NS_VALSTR_STRUCT(O_DIRECTORY),
+    NS_VALSTR_STRUCT(O_NOFOLLOW),
+    NS_VALSTR_STRUCT(O_NOATIME),
+    NS_VALSTR_STRUCT(O_CLOEXEC),
+    NS_VALSTR_STRUCT(O_PATH),
+};
+
+static const flag_t protFlags[] = {
+    NS_VALSTR_STRUCT(PROT_READ),
+    NS_VALSTR_STRUCT(PROT_WRITE),
+    NS_VALSTR_STRUCT(PROT_EXEC),
+    NS_VALSTR_STRUCT(PROT_GROWSDOWN),
+    NS_VALSTR_STRUCT(PROT_GROWSUP),
+};
+
+static const flag_t mmapFlags[] = {
+#if defined(MAP_SHARED_VALIDATE)
+    NS_VALSTR_STRUCT(MAP_SHARED_VALIDATE),
+#endif
+    NS_VALSTR_STRUCT(MAP_SHARED),
+    NS_VALSTR_STRUCT(MAP_PRIVATE),
+    NS_VALSTR_STRUCT(MAP_FIXED),
+    NS_VALSTR_STRUCT(MAP_ANONYMOUS),
+#if defined(MAP_32BIT)
+    NS_VALSTR_STRUCT(MAP_32BIT),
+#endif
+    NS_VALSTR_STRUCT(MAP_GROWSDOWN),
+    NS_VALSTR_STRUCT(MAP_DENYWRITE),
+    NS_VALSTR_STRUCT(MAP_EXECUTABLE),
+    NS_VALSTR_STRUCT(MAP_LOCKED),
+    NS_VALSTR_STRUCT(MAP_NORESERVE),
+    NS_VALSTR_STRUCT(MAP_POPULATE),
+    NS_VALSTR_STRUCT(MAP_NONBLOCK),
+    NS_VALSTR_STRUCT(MAP_STACK),
+    NS_VALSTR_STRUCT(MAP_HUGETLB),
+#if defined(MAP_FIXED_NOREPLACE)
+    NS_VALSTR_STRUCT(MAP_FIXED_NOREPLACE),
+#endif
+};
+
+static const flag_t cloneFlags[] = {
+    NS_VALSTR_STRUCT(CLONE_VM),
+    NS_VALSTR_STRUCT(CLONE_FS),
+    NS_VALSTR_STRUCT(CLONE_FILES),
+    NS_VALSTR_STRUCT(CLONE_SIGHAND),
+#if defined(CLONE_PIDFD)
+    NS_VALSTR_STRUCT(CLONE_PIDFD),
+#endif
+    NS_VALSTR_STRUCT(CLONE_PTRACE),
+    NS_VALSTR_STRUCT(CLONE_VFORK),
+    NS_VALSTR_STRUCT(CLONE_PARENT),
+    NS_VALSTR_STRUCT(CLONE_THREAD),
+    NS_VALSTR_STRUCT(CLONE_NEWNS),
+    NS_VALSTR_STRUCT(CLONE_SYSVSEM),
+    NS_VALSTR_STRUCT(CLONE_SETTLS),
+    NS_VALSTR_STRUCT(CLONE_PARENT_SETTID),
+    NS_VALSTR_STRUCT(CLONE_CHILD_CLEARTID),
+    NS_VALSTR_STRUCT(CLONE_DETACHED),
+    NS_VALSTR_STRUCT(CLONE_UNTRACED),
+    NS_VALSTR_STRUCT(CLONE_CHILD_SETTID),
+    NS_VALSTR_STRUCT(CLONE_NEWCGROUP),
+    NS_VALSTR_STRUCT(CLONE_NEWUTS),
+    NS_VALSTR_STRUCT(CLONE_NEWIPC),
+    NS_VALSTR_STRUCT(CLONE_NEWUSER),
+    NS_VALSTR_STRUCT(CLONE_NEWPID),
+    NS_VALSTR_STRUCT(CLONE_NEWNET),
+    NS_VALSTR_STRUCT(CLONE_IO),
+};
+
+static const flag_t sockFlags[] = {
+    NS_VALSTR_STRUCT(SOCK_NONBLOCK),
+    NS_VALSTR_STRUCT(SOCK_CLOEXEC),
+};
+
+/* Values, not flags */
+static const flag_t addrFamilies[] = {
+    NS_VALSTR_STRUCT(AF_UNSPEC),
+    NS_VALSTR_STRUCT(AF_UNIX),
+    NS_VALSTR_STRUCT(AF_INET),
+    NS_VALSTR_STRUCT(AF_INET6),
+    NS_VALSTR_STRUCT(AF_NETLINK),
+    NS_VALSTR_STRUCT(AF_PACKET),
+    NS_VALSTR_STRUCT(AF_KEY),
+    NS_VALSTR_STRUCT(AF_BLUETOOTH),
+    NS_VALSTR_STRUCT(AF_ALG),
+    NS_VALSTR_STRUCT(AF_VSOCK),
+};
+
+static const flag_t sockTypes[] = {
+    NS_VALSTR_STRUCT(SOCK_STREAM),
+    NS_VALSTR_STRUCT(SOCK_DGRAM),
+    NS_VALSTR_STRUCT(SOCK_RAW),
+    NS_VALSTR_STRUCT(SOCK_RDM),
+    NS_VALSTR_STRUCT(SOCK_SEQPACKET),
+    NS_VALSTR_STRUCT(SOCK_PACKET),
+};
+
+static const syscall_t* findSyscall(long nr) {
+	for (size_t i = 0; i < ARR_SZ(syscallTable); i++) {
+		if (syscallTable[i].nr == nr) {
+			return &syscallTable[i];
+		}
+	}
+	return NULL;
+}
+
+const std::string name(long nr) {
+	const syscall_t* sc = findSyscall(nr);
+	if (sc) {
+		return sc->name;
+	}
+	return "syscall_" + std::to_string(nr);
+}
+
+static void appendHex(std::string* res, uint64_t val) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%#" PRIx64, val);
+	res->append(buf);
+}
+
+/* Known flags joined with '|', the unknown bits in hex */
+static void appendFlags(std::string* res, uint64_t val, const flag_t* flags, size_t cnt) {
+	std::string out;
+	for (size_t i = 0; i < cnt; i++) {
+		if (flags[i].flag != 0 && (val & flags[i].flag) == flags[i].flag) {
+			out.append(flags[i].name);
+			out.append("|");
+			val &= ~flags[i].flag;
+		}
+	}
+	if (val != 0 || out.empty()) {
+		appendHex(&out, val);
+	} else {
+		out.pop_back();
+	}
+	res->append(out);
+}
+
+static void appendValue(std::string* res, uint64_t val, const flag_t* values, size_t cnt) {
+	for (size_t i = 0; i < cnt; i++) {
+		if (values[i].flag == val) {
+			res->append(values[i].name);
+			return;
+		}
+	}
+	res->append(std::to_string(val));
+}
+
+static void appendArg(std::string* res, char kind, uint64_t val) {
+	char buf[32];
+	switch (kind) {
+	case 'd':
+		res->append(std::to_string((int64_t)val));
+		break;
+	case 'f':
+		if ((int)val == AT_FDCWD) {
+			res->append("AT_FDCWD");
+		} else {
+			res->append(std::to_string((int)val));
+		}
+		break;
+	case 'o':
+		snprintf(buf, sizeof(buf), "0%" PRIo64, val);
+		res->append(buf);
+		break;
+	case 'O': {
+		static const char* const accModes[] = {"O_RDONLY", "O_WRONLY", "O_RDWR", "0x3"};
+		res->append(accModes[val & O_ACCMODE]);
+		val &= ~(uint64_t)O_ACCMODE;
+		if (val != 0) {
+			res->append("|");
+			appendFlags(res, val, openFlags, ARR_SZ(openFlags));
+		}
+		break;
+	}
+	case 'P':
+		if (val == PROT_NONE) {
+			res->append("PROT_NONE");
+		} else {
+			appendFlags(res, val, protFlags, ARR_SZ(protFlags));
+		}
+		break;
+	case 'M':
+		appendFlags(res, val, mmapFlags, ARR_SZ(mmapFlags));
+		break;
+	case 'C':
+		appendFlags(res, val & ~(uint64_t)CSIGNAL, cloneFlags, ARR_SZ(cloneFlags));
+		if (val & CSIGNAL) {
+			res->append("|" + util::sigName(val & CSIGNAL));
+		}
+		break;
+	case 'S':
+		res->append(util::sigName((int)val));
+		break;
+	case 'A':
+		appendValue(res, val, addrFamilies, ARR_SZ(addrFamilies));
+		break;
+	case 'T':
+		appendValue(res, val & 0xf, sockTypes, ARR_SZ(sockTypes));
+		if (val & ~(uint64_t)0xf) {
+			res->append("|");
+			appendFlags(res, val & ~(uint64_t)0xf, sockFlags, ARR_SZ(sockFlags));
+		}
+		break;
+	default:
+		appendHex(res, val);
+		break;
+	}
+}
+
+const std::string toStr(long nr, const uint64_t args[6]) {
+	const syscall_t* sc = findSyscall(nr);
+	const char* kinds = sc ? sc->args : NULL;
+	std::string res = name(nr) + "(";
+	size_t cnt = kinds ? strlen(kinds) : 6;
+	for (size_t i = 0; i < cnt; i++) {
+		if (i > 0) {
+			res.append(", ");
+		}
+		appendArg(&res, kinds ? kinds[i] : 'x', args[i]);
+	}
+	res.append(")");
+	return res;
+}
+
+const std::string callToStr(const call_t& call) {
+	char buf[128];
+	std::string res;
+	if (call.nr == -1) {
+		res = "syscall=[UNKNOWN]";
+	} else {
+		snprintf(buf, sizeof(buf), "syscall=%s nr=%ld", name(call.nr).c_str(), call.nr);
+		res = buf;
+	}
+	if (call.has_args) {
+		res.append(" call='" + toStr(call.nr, call.args) + "'");
+	}
+	snprintf(buf, sizeof(buf), " sp=%#" PRIx64 " pc=%#" PRIx64, call.sp, call.pc);
+	res.append(buf);
+	return res;
+}
+
+}  // namespace syscalls
@@ -0,0 +1,53 @@
+/*
+
+   nsjail - syscall names and arguments
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#ifndef NS_SYSCALLS_H
+#define NS_SYSCALLS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+namespace syscalls {
+
+/* A syscall made in a jail, e.g. the one which violated the seccomp policy */
+struct call_t {
+	pid_t pid;
+	/* -1 if the kernel doesn't know it anymore (e.g. the process is a zombie) */
+	long nr;
+	bool has_args;
+	uint64_t args[6];
+	uint64_t sp;
+	uint64_t pc;
+};
+
+/* Names are those of the architecture nsjail is compiled for */
+const std::string name(long nr);
+/* 'openat(AT_FDCWD, 0x7ffc7e8a3e70, O_RDONLY|O_CLOEXEC, 0)' */
+const std::string toStr(long nr, const uint64_t args[6]);
+/* 'syscall=openat nr=257 args=(...) sp=... pc=...', for the logs */
+const std::string callToStr(const call_t& call);
+
+}  // namespace syscalls
+
+#endif /* NS_SYSCALLS_H */
@@ -0,0 +1,380 @@
+/*
+
+   nsjail - seccomp user-notification supervisor
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "unotify.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/seccomp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "logs.h"
+#include "syscalls.h"
+#include "util.h"
+
+namespace unotify {
+
+/*
+ * A jail whose seccomp filter notifies the supervisor. Until the child sends the listener over
+ * the socketpair (right before execve) only 'sock' is set, afterwards only 'fd'
+ */
+struct jail_t {
+	pid_t pid;
+	int sock;
+	int fd;
+	std::shared_ptr<nsjconf_t> conf;
+};
+
+/*
+ * The jails are handled by a single thread; a syscall stays blocked until the supervisor
+ * answers, so it must not wait for the main loop. The wake pipe makes it poll a changed list
+ */
+static pthread_mutex_t jailsMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<jail_t> jails;
+static int wakePipe[2] = {-1, -1};
+
+/*
+ * seccomp_profile: the syscalls seen in the jails, per profile file. Argument values are kept
+ * while there are only a few different ones, which is what makes them worth writing down
+ */
+static const size_t kProfileMaxValues = 4;
+
+struct profSyscall_t {
+	uint64_t count;
+	std::vector<uint64_t> values[6];
+	bool varied[6];
+};
+
+struct profile_t {
+	uint32_t arch;
+	uint64_t foreign;
+	bool dirty;
+	std::map<uint32_t, profSyscall_t> syscalls;
+};
+
+/* Guarded by jailsMutex */
+static std::map<std::string, profile_t> profiles;
+
+static void profileRecord(const std::string& path, const struct seccomp_data& data) {
+	profile_t& prof = profiles[path];
+	prof.dirty = true;
+	/* The first syscall is one of nsjail's own, made with the native ABI */
+	if (prof.syscalls.empty() && prof.foreign == 0) {
+		prof.arch = data.arch;
+	}
+	if (data.arch != prof.arch) {
+		prof.foreign++;
+		return;
+	}
+	profSyscall_t& sc = prof.syscalls[data.nr];
+	sc.count++;
+	for (size_t i = 0; i < 6; i++) {
+		std::vector<uint64_t>& v = sc.values[i];
+		if (sc.varied[i] || std::find(v.begin(), v.end(), data.args[i]) != v.end()) {
+			continue;
+		}
+		if (v.size() == kProfileMaxValues) {
+			sc.varied[i] = true;
+			v.clear();
+		} else {
+			v.push_back(data.args[i]);
+		}
+	}
+}
+
+/*
+ * Kafel refers to syscalls by name or with SYSCALL[nr]; the numbers are used, so that the
+ * policy is exactly what was seen on this architecture. Argument values seen repeatedly are
+ * only comments, pointers and fds would make the policy fail on the next run otherwise
+ */
+static const std::string profileToKafel(const profile_t& prof) {
+	std::vector<std::pair<uint32_t, const profSyscall_t*>> order;
+	uint64_t total = 0;
+	for (const auto& sc : prof.syscalls) {
+		order.push_back({sc.first, &sc.second});
+		total += sc.second.count;
+	}
+	std::stable_sort(order.begin(), order.end(),
+	    [](const std::pair<uint32_t, const profSyscall_t*>& a,
+		const std::pair<uint32_t, const profSyscall_t*>& b) {
+		    return a.second->count > b.second->count;
+	    });
+
+	char buf[256];
+	std::string out = "/*\n * Generated by nsjail (--seccomp_profile) on " +
+			  util::timeToStr(time(NULL)) + "\n";
+	snprintf(buf, sizeof(buf),
+	    " * %zu different syscalls, %" PRIu64 " calls, ordered by the number of calls\n",
+	    order.size(), total);
+	out += buf;
+	if (prof.foreign > 0) {
+		snprintf(buf, sizeof(buf),
+		    " * %" PRIu64 " calls made with another syscall ABI (arch %#x) are missing\n",
+		    prof.foreign, prof.arch);
+		out += buf;
+	}
+	out += " * Candidates for seccomp_hot_syscall:";
+	for (size_t i = 0; i < order.size() && i < 4; i++) {
+		out += " " + std::to_string(order[i].first);
+	}
+	out += "\n */\n\nPOLICY nsjail_profile {\n  ALLOW {\n";
+	for (size_t i = 0; i < order.size(); i++) {
+		const profSyscall_t& sc = *order[i].second;
+		snprintf(buf, sizeof(buf), "    SYSCALL[%u]%s // %s, %" PRIu64 " calls",
+		    order[i].first, i + 1 < order.size() ? "," : "",
+		    syscalls::name(order[i].first).c_str(), sc.count);
+		out += buf;
+		for (size_t a = 0; a < 6; a++) {
+			/* Unused arguments are leftover register values, these rarely repeat */
+			if (sc.varied[a] || sc.values[a].size() * 2 > sc.count) {
+				continue;
+			}
+			snprintf(buf, sizeof(buf), ", arg%zu:", a);
+			out += buf;
+			for (const auto v : sc.values[a]) {
+				snprintf(buf, sizeof(buf), " %#" PRIx64, v);
+				out += buf;
+			}
+		}
+		out += "\n";
+	}
+	out += "  }\n}\n\nUSE nsjail_profile DEFAULT KILL\n";
+	return out;
+}
+
+/* Renamed into place, so the file is complete whenever it's there */
+static void profileWrite(const std::string& path, const profile_t& prof) {
+	const std::string policy = profileToKafel(prof);
+	const std::string tmp = path + ".tmp";
+	if (!util::writeBufToFile(tmp.c_str(), policy.data(), policy.size(),
+		O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC) ||
+	    rename(tmp.c_str(), path.c_str()) == -1) {
+		PLOG_W("Couldn't write the seccomp profile to '%s'", path.c_str());
+		unlink(tmp.c_str());
+		return;
+	}
+	LOG_I("Wrote the seccomp profile (%zu syscalls) to '%s'", prof.syscalls.size(),
+	    path.c_str());
+}
+
+static const notify_t* findRule(nsjconf_t* nsjconf, uint32_t nr) {
+	for (const auto& n : nsjconf->seccomp_notify) {
+		if (n.nr == nr) {
+			return &n;
+		}
+	}
+	return NULL;
+}
+
+static void handleNotif(const jail_t& j) {
+	struct seccomp_notif req;
+	memset(&req, '\0', sizeof(req));
+	if (ioctl(j.fd, SECCOMP_IOCTL_NOTIF_RECV, &req) == -1) {
+		/* ENOENT: the calling thread was killed in the meantime */
+		PLOG_D("ioctl(fd=%d, SECCOMP_IOCTL_NOTIF_RECV)", j.fd);
+		return;
+	}
+
+	struct seccomp_notif_resp resp;
+	memset(&resp, '\0', sizeof(resp));
+	resp.id = req.id;
+	const notify_t* rule = findRule(j.conf.get(), req.data.nr);
+	if (!j.conf->seccomp_profile_file.empty()) {
+		profileRecord(j.conf->seccomp_profile_file, req.data);
+		resp.flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+	} else if (!rule) {
+		/* E.g. a USER_NOTIF action in the Kafel policy itself */
+		LOG_W("PID: %d, no handler for the notified syscall %s in pid %u", (int)j.pid,
+		    syscalls::name(req.data.nr).c_str(), req.pid);
+		resp.error = -ENOSYS;
+	} else if (rule->action == NOTIFY_LOG) {
+		uint64_t args[6];
+		std::copy(std::begin(req.data.args), std::end(req.data.args), args);
+		LOG_I("PID: %d, syscall %s in pid %u", (int)j.pid,
+		    syscalls::toStr(req.data.nr, args).c_str(), req.pid);
+		resp.flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+	} else if (rule->action == NOTIFY_ALLOW &&
+		   (rule->arg_index < 0 || req.data.args[rule->arg_index] == rule->arg_value)) {
+		LOG_D("PID: %d, allowing syscall %s in pid %u", (int)j.pid,
+		    syscalls::name(req.data.nr).c_str(), req.pid);
+		resp.flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+	} else {
+		LOG_I("PID: %d, denying syscall %s in pid %u with errno %d", (int)j.pid,
+		    syscalls::name(req.data.nr).c_str(), req.pid, rule->deny_errno);
+		resp.error = -rule->deny_errno;
+	}
+
+	if (ioctl(j.fd, SECCOMP_IOCTL_NOTIF_SEND, &resp) == -1) {
+		PLOG_D("ioctl(fd=%d, SECCOMP_IOCTL_NOTIF_SEND)", j.fd);
+	}
+}
+
+/* Called with jailsMutex held. Returns false if the jail is gone */
+static bool handleJail(jail_t* j, short revents) {
+	if (j->fd == -1) {
+		/* The child closes its end without the listener if it fails before execve() */
+		j->fd = (revents & POLLIN) ? util::recvFd(j->sock) : -1;
+		close(j->sock);
+		j->sock = -1;
+		return j->fd != -1;
+	}
+	if (revents & POLLIN) {
+		handleNotif(*j);
+		return true;
+	}
+	/* POLLHUP: no task uses the filter anymore */
+	close(j->fd);
+	j->fd = -1;
+	return false;
+}
+
+static void* supervisorThread(void* arg) {
+	for (;;) {
+		std::vector<struct pollfd> pfds = {{wakePipe[0], POLLIN, 0}};
+		std::vector<pid_t> pids;
+		pthread_mutex_lock(&jailsMutex);
+		for (const auto& j : jails) {
+			pfds.push_back({j.fd != -1 ? j.fd : j.sock, POLLIN, 0});
+			pids.push_back(j.pid);
+		}
+		pthread_mutex_unlock(&jailsMutex);
+
+		if (poll(pfds.data(), pfds.size(), -1) == -1) {
+			if (errno != EINTR) {
+				PLOG_E("poll()");
+			}
+			continue;
+		}
+		if (pfds[0].revents) {
+			char buf[64];
+			while (read(wakePipe[0], buf, sizeof(buf)) > 0) {
+			}
+		}
+
+		pthread_mutex_lock(&jailsMutex);
+		for (size_t i = 1; i < pfds.size(); i++) {
+			if (!pfds[i].revents) {
+				continue;
+			}
+			/* Detached in the meantime, or the fd was replaced */
+			for (auto j = jails.begin(); j != jails.end(); ++j) {
+				if (j->pid == pids[i - 1] &&
+				    (j->fd == pfds[i].fd || j->sock == pfds[i].fd)) {
+					if (!handleJail(&*j, pfds[i].revents)) {
+						jails.erase(j);
+					}
+					break;
+				}
+			}
+		}
+		pthread_mutex_unlock(&jailsMutex);
+	}
+	return NULL;
+}
+
+static void wake(void) {
+	char c = 'W';
+	if (write(wakePipe[1], &c, sizeof(c)) == -1 && errno != EAGAIN) {
+		PLOG_W("write(wakePipe)");
+	}
+}
+
+static bool start(void) {
+	if (pipe2(wakePipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+		PLOG_E("pipe2()");
+		return false;
+	}
+	/* Signals must reach the main thread */
+	sigset_t smask, orig_smask;
+	sigfillset(&smask);
+	pthread_sigmask(SIG_SETMASK, &smask, &orig_smask);
+	pthread_t tid;
+	int err = pthread_create(&tid, NULL, supervisorThread, NULL);
+	pthread_sigmask(SIG_SETMASK, &orig_smask, NULL);
+	if (err != 0) {
+		errno = err;
+		PLOG_E("pthread_create()");
+		close(wakePipe[0]);
+		close(wakePipe[1]);
+		wakePipe[0] = wakePipe[1] = -1;
+		return false;
+	}
+	pthread_detach(tid);
+	return true;
+}
+
+void attach(nsjconf_t* nsjconf, pid_t pid, int sock) {
+	if (nsjconf->seccomp_notify.empty() && nsjconf->seccomp_profile_file.empty()) {
+		return;
+	}
+	if (wakePipe[0] == -1 && !start()) {
+		return;
+	}
+	int fd = fcntl(sock, F_DUPFD_CLOEXEC, 0);
+	if (fd == -1) {
+		PLOG_E("fcntl(fd=%d, F_DUPFD_CLOEXEC)", sock);
+		return;
+	}
+	pthread_mutex_lock(&jailsMutex);
+	jails.push_back({pid, fd, -1, nsjconf->shared_from_this()});
+	pthread_mutex_unlock(&jailsMutex);
+	wake();
+}
+
+void detach(nsjconf_t* nsjconf, pid_t pid) {
+	if (wakePipe[0] == -1) {
+		return;
+	}
+	pthread_mutex_lock(&jailsMutex);
+	for (auto j = jails.begin(); j != jails.end(); ++j) {
+		if (j->pid == pid) {
+			close(j->fd != -1 ? j->fd : j->sock);
+			jails.erase(j);
+			break;
+		}
+	}
+	/* The jail's syscalls have all been answered, it's gone */
+	for (auto& p : profiles) {
+		if (p.second.dirty && !p.second.syscalls.empty()) {
+			profileWrite(p.first, p.second);
+			p.second.dirty = false;
+		}
+	}
+	pthread_mutex_unlock(&jailsMutex);
+	wake();
+}
+
+}  // namespace unotify
@@ -0,0 +1,323 @@
+/*
+
+   nsjail - in-place upgrades of the supervisor
+   -----------------------------------------
+
+   Copyright 2014 Google Inc. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+/*
+ * On SIGUSR2 (MODE_LISTEN_TCP only) the supervisor execve()s the current version of its own
+ * binary, with the original command-line. The PID doesn't change, so the running jails stay its
+ * children, and the listening sockets are simply left open across execve(). Their numbers are
+ * passed in net::kListenFdsEnv, and the list of running jails in a memfd (kJailsFdEnv)
+ */
+
+#include "upgrade.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "cmdline.h"
+#include "control.h"
+#include "logs.h"
+#include "macros.h"
+#include "net.h"
+#include "reload.h"
+#include "subproc.h"
+#include "util.h"
+
+namespace upgrade {
+
+static const char kJailsFdEnv[] = "NSJAIL_UPGRADE_FD";
+
+static std::string exePath;
+static std::vector<std::string> origArgv;
+
+void init(int argc, char** argv) {
+	/* Follows the symlink now: a package upgrade replaces the file under the same path */
+	char path[PATH_MAX];
+	if (realpath("/proc/self/exe", path) != NULL) {
+		exePath = path;
+	} else {
+		PLOG_W("realpath('/proc/self/exe')");
+		exePath = argv[0];
+	}
+	for (int i = 0; i < argc; i++) {
+		origArgv.push_back(argv[i]);
+	}
+}
+
+bool isResumed(void) {
+	return getenv(kJailsFdEnv) != NULL;
+}
+
+/* State which is kept only in memory, and which the new process would not know about */
+static bool canUpgrade(nsjconf_t* nsjconf) {
+	if (nsjconf->mode != MODE_LISTEN_TCP) {
+		LOG_W("In-place upgrades are supported in the LISTEN mode only");
+		return false;
+	}
+	if (nsjconf->macvlan_pool_size > 0 || !nsjconf->veth_bridge.empty()) {
+		LOG_W("In-place upgrades are not supported with macvlan_pool_size or veth_bridge, "
+		      "as the jails' IP addresses would be handed out again");
+		return false;
+	}
+	if (!nsjconf->seccomp_notify.empty() || !nsjconf->seccomp_profile_file.empty()) {
+		LOG_W("In-place upgrades are not supported with seccomp_notify or "
+		      "seccomp_profile, the jails' seccomp listeners can't be handed over");
+		return false;
+	}
+	/*
+	 * Their per-jail settings (time limit, cgroups) and the clients waiting for them live in
+	 * this process only
+	 */
+	if (control::busy()) {
+		LOG_W("In-place upgrades are not possible while jails launched over the "
+		      "control_socket are running");
+		return false;
+	}
+	/* The new process adopts all jails with the configuration it parses itself */
+	for (const auto& p : nsjconf->pids) {
+		if (p.conf.get() != nsjconf) {
+			LOG_W("In-place upgrades are not possible while jails started before "
+			      "the last configuration reload are running (e.g. PID: %d)",
+			    p.pid);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * The new process adopts the passed sockets by name, unnamed ones by their position in its own
+ * list of listeners (see net::listenerName()). Each must end up with a listener of the same
+ * address, or with none if it wasn't configured (LISTEN_FDS only), otherwise it would serve the
+ * command and the seccomp policy of another one
+ */
+static bool checkListeners(nsjconf_t* nsjconf, nsjconf_t* parsed) {
+	std::vector<listener_t> conf = net::configuredListeners(parsed);
+	for (auto& c : conf) {
+		if (c.bindhost.empty()) {
+			c.bindhost = parsed->bindhost;
+		}
+	}
+	for (size_t i = 0; i < nsjconf->listeners.size(); i++) {
+		const listener_t& l = nsjconf->listeners[i];
+		const listener_t* match = NULL;
+		for (size_t j = 0; j < conf.size() && match == NULL; j++) {
+			if (l.name.empty() ? (j == i && conf[j].name.empty())
+					   : (conf[j].name == l.name)) {
+				match = &conf[j];
+			}
+		}
+		/* Gone from the configuration: fine if it has never been in it */
+		bool ok = l.port == 0 && l.unix_path.empty() && l.exec_file.empty() &&
+			  l.seccomp_policy.empty();
+		if (match != NULL) {
+			ok = net::sameListener(nsjconf, l, *match);
+		}
+		if (!ok) {
+			LOG_E("Listener %s was removed, moved or reordered in the configuration, "
+			      "not upgrading",
+			    net::listenerText(nsjconf, l).c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * The new process parses the command-line again, and a configuration it can't parse (e.g. the
+ * --config file was edited meanwhile) would make it exit, leaving the jails without a supervisor
+ */
+static bool checkConfig(nsjconf_t* nsjconf) {
+	std::vector<std::string> args = origArgv;
+	std::vector<char*> argv;
+	for (auto& a : args) {
+		argv.push_back(&a[0]);
+	}
+	argv.push_back(NULL);
+	/* Full re-initialization of getopt_long() */
+	optind = 0;
+	std::shared_ptr<nsjconf_t> parsed =
+	    reload::makeSnapshot(cmdline::parseArgs(argv.size() - 1, argv.data()));
+	/* Parsing sets up logging according to the parsed configuration */
+	logs::initLog(nsjconf->logfile, nsjconf->loglevel);
+	if (!parsed) {
+		LOG_E("Couldn't parse the configuration, not upgrading");
+		return false;
+	}
+	return checkListeners(nsjconf, parsed.get());
+}
+
+static bool setCloexec(const std::vector<listener_t>& listeners, bool cloexec) {
+	for (const auto& l : listeners) {
+		if (TEMP_FAILURE_RETRY(fcntl(l.fd, F_SETFD, cloexec ? FD_CLOEXEC : 0)) == -1) {
+			PLOG_E("fcntl(fd=%d, F_SETFD)", l.fd);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* One line per jail: 'pid start_time remote_ip remote_port remote_txt' */
+static int saveJails(nsjconf_t* nsjconf) {
+	/* No MFD_CLOEXEC, it's read by the new process */
+	int fd = memfd_create("nsjail-upgrade", 0);
+	if (fd == -1) {
+		PLOG_E("memfd_create()");
+		return -1;
+	}
+	std::string buf;
+	for (const auto& p : nsjconf->pids) {
+		char ip[INET6_ADDRSTRLEN] = "-";
+		if (p.remote_addr.sin6_family == AF_INET6) {
+			inet_ntop(AF_INET6, &p.remote_addr.sin6_addr, ip, sizeof(ip));
+		}
+		buf.append(std::to_string(p.pid) + " " + std::to_string(p.start) + " " + ip + " " +
+			   std::to_string(ntohs(p.remote_addr.sin6_port)) + " " + p.remote_txt +
+			   "\n");
+	}
+	if (!util::writeToFd(fd, buf.data(), buf.size()) ||
+	    lseek(fd, 0, SEEK_SET) == -1) {
+		PLOG_E("Couldn't save the list of jails");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void exec(nsjconf_t* nsjconf) {
+	if (!canUpgrade(nsjconf) || !checkConfig(nsjconf)) {
+		return;
+	}
+	LOG_I("Upgrading in place to '%s', %zu jail(s) running", exePath.c_str(),
+	    nsjconf->pids.size());
+
+	int jails_fd = saveJails(nsjconf);
+	if (jails_fd == -1) {
+		return;
+	}
+	std::string fds_str;
+	for (size_t i = 0; i < nsjconf->listeners.size(); i++) {
+		if (i > 0) {
+			fds_str.append(":");
+		}
+		fds_str.append(std::to_string(nsjconf->listeners[i].fd) + "=" +
+			       net::listenerName(nsjconf, i));
+	}
+	if (!setCloexec(nsjconf->listeners, false)) {
+		setCloexec(nsjconf->listeners, true);
+		close(jails_fd);
+		return;
+	}
+	setenv(net::kListenFdsEnv, fds_str.c_str(), 1);
+	setenv(kJailsFdEnv, std::to_string(jails_fd).c_str(), 1);
+
+	/*
+	 * The new image starts with default signal dispositions, so SIGALRM (the timer) or
+	 * SIGUSR1 would kill it before it installs its handlers. The signal mask survives execve(),
+	 * and is cleared in restoreJails()
+	 */
+	const struct itimerval zero = {};
+	struct itimerval it;
+	setitimer(ITIMER_REAL, &zero, &it);
+	sigset_t all, orig;
+	sigfillset(&all);
+	sigprocmask(SIG_SETMASK, &all, &orig);
+
+	std::vector<const char*> argv;
+	for (const auto& a : origArgv) {
+		argv.push_back(a.c_str());
+	}
+	argv.push_back(NULL);
+	execv(exePath.c_str(), (char* const*)argv.data());
+
+	PLOG_E("execv('%s'), continuing with the current binary", exePath.c_str());
+	sigprocmask(SIG_SETMASK, &orig, NULL);
+	setitimer(ITIMER_REAL, &it, NULL);
+	unsetenv(net::kListenFdsEnv);
+	unsetenv(kJailsFdEnv);
+	setCloexec(nsjconf->listeners, true);
+	close(jails_fd);
+}
+
+bool restoreJails(nsjconf_t* nsjconf) {
+	const char* fd_str = getenv(kJailsFdEnv);
+	if (fd_str == NULL) {
+		return true;
+	}
+	unsetenv(kJailsFdEnv);
+
+	FILE* f = fdopen(atoi(fd_str), "r");
+	if (f == NULL) {
+		PLOG_E("fdopen(fd=%s)", fd_str);
+		return false;
+	}
+	char* line = NULL;
+	size_t len = 0;
+	size_t cnt = 0;
+	while (getline(&line, &len, f) != -1) {
+		int pid, port, off = 0;
+		long start;
+		char ip[INET6_ADDRSTRLEN];
+		if (sscanf(line, "%d %ld %45s %d %n", &pid, &start, ip, &port, &off) != 4 ||
+		    off == 0) {
+			LOG_W("Invalid entry in the list of jails: '%s'", line);
+			continue;
+		}
+		pids_t p = {};
+		p.pid = pid;
+		p.start = start;
+		p.remote_txt = line + off;
+		if (!p.remote_txt.empty() && p.remote_txt.back() == '\n') {
+			p.remote_txt.pop_back();
+		}
+		if (inet_pton(AF_INET6, ip, &p.remote_addr.sin6_addr) == 1) {
+			p.remote_addr.sin6_family = AF_INET6;
+			p.remote_addr.sin6_port = htons(port);
+		}
+		subproc::adoptProc(nsjconf, p);
+		cnt++;
+	}
+	free(line);
+	fclose(f);
+	LOG_I("Resumed after an in-place upgrade, %zu jail(s) running", cnt);
+
+	sigset_t empty;
+	sigemptyset(&empty);
+	if (sigprocmask(SIG_SETMASK, &empty, NULL) == -1) {
+		PLOG_E("sigprocmask(SIG_SETMASK)");
+		return false;
+	}
+	return true;
+}
+
+}  // namespace upgrade
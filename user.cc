@@ -235,11 +235,12 @@ bool initNsFromParent(nsjconf_t* nsjconf, pid_t pid) {
 
 bool initNsFromChild(nsjconf_t* nsjconf) {
 	/*
-	 * Best effort because of /proc/self/setgroups
+	 * Best effort because of /proc/self/setgroups. It's a raw syscall like setres[ug]id, as
+	 * glibc would wait for the supervisor's helper threads to apply it too, and these don't
+	 * exist in this process
 	 */
 	LOG_D("setgroups(0, NULL)");
-	gid_t* group_list = NULL;
-	if (setgroups(0, group_list) == -1) {
+	if (syscall(__NR_setgroups, 0, NULL) == -1) {
 		PLOG_D("setgroups(NULL) failed");
 	}
 
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
@@ -283,6 +284,93 @@ const std::string timeToStr(time_t t) {
 	return timestr;
 }
 
+const std::string jsonStr(const std::string& str) {
+	std::string ret = "\"";
+	for (const unsigned char c : str) {
+		if (c == '"' || c == '\\') {
+			ret += '\\';
+			ret += c;
+		} else if (c < 0x20) {
+			char esc[8];
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			ret += esc;
+		} else {
+			ret += c;
+		}
+	}
+	ret += '"';
+	return ret;
+}
+
+bool sendFd(int sock, int fd) {
+	char buf = 'F';
+	struct iovec iov = {
+	    .iov_base = &buf,
+	    .iov_len = sizeof(buf),
+	};
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} cmsgbuf;
+	memset(&cmsgbuf, '\0', sizeof(cmsgbuf));
+
+	struct msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	if (TEMP_FAILURE_RETRY(sendmsg(sock, &msg, MSG_NOSIGNAL)) != sizeof(buf)) {
+		PLOG_W("sendmsg(fd=%d, SCM_RIGHTS)", sock);
+		return false;
+	}
+	return true;
+}
+
+int recvFd(int sock) {
+	char buf;
+	struct iovec iov = {
+	    .iov_base = &buf,
+	    .iov_len = sizeof(buf),
+	};
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} cmsgbuf;
+
+	struct msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+	ssize_t ret = TEMP_FAILURE_RETRY(recvmsg(sock, &msg, MSG_CMSG_CLOEXEC));
+	if (ret == -1) {
+		PLOG_W("recvmsg(fd=%d, SCM_RIGHTS)", sock);
+		return -1;
+	}
+	if (ret != sizeof(buf)) {
+		LOG_W("recvmsg(fd=%d) returned %zd bytes, expected a file descriptor", sock, ret);
+		return -1;
+	}
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+		LOG_W("No file descriptor received over fd=%d", sock);
+		return -1;
+	}
+	int fd;
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	return fd;
+}
+
 std::vector<std::string> strSplit(const std::string str, char delim) {
 	std::vector<std::string> vec;
 	std::istringstream stream(str);
@@ -43,7 +43,11 @@ bool isANumber(const char* s);
 uint64_t rnd64(void);
 const std::string sigName(int signo);
 const std::string timeToStr(time_t t);
+/* Quoted and escaped as a JSON string */
+const std::string jsonStr(const std::string& str);
 std::vector<std::string> strSplit(const std::string str, char delim);
+bool sendFd(int sock, int fd);
+int recvFd(int sock);
 
 }  // namespace util
 